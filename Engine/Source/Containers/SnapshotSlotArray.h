@@ -0,0 +1,249 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "SpinLock.h"
+#include "Containers/DArray.h"
+#include <atomic>
+#include <memory>
+
+/**
+ * Dense slot array addressed by stable 64-bit handles.
+ * Lower 32 bits of a handle store slot index + 1 (so 0 is never a valid handle), upper 32 bits store the slot
+ * generation, which is bumped on removal so stale handles can't remove a slot that has since been reused.
+ *
+ * Readers never take the lock writers share. Every modification publishes a new immutable, compact snapshot of
+ * occupied values (read-copy-update), so values can be added or removed from any thread while other threads iterate an
+ * older snapshot. Modifications are expected to be rare compared to reads.
+ *
+ * Snapshots can be read in two ways. GetSnapshot hands out shared ownership, which is safe anywhere but not free:
+ * std::atomic<std::shared_ptr> is not lock-free in common standard libraries (MSVC guards it with an internal lock)
+ * and every copy touches a reference count shared by all readers. GetCurrentSnapshot is a single atomic pointer load,
+ * the snapshots it returns are kept alive until the owner calls ReclaimRetiredSnapshots at a point where no such
+ * reader can be running, e.g. between frames.
+ */
+template <typename T>
+class SnapshotSlotArray
+{
+public:
+    using Snapshot = DArray<T>;
+    using SnapshotPtr = std::shared_ptr<const Snapshot>;
+
+public:
+    SnapshotSlotArray() : _snapshot(std::make_shared<const Snapshot>())
+    {
+        _currentSnapshot.store(_snapshot.load().get());
+    }
+
+    SnapshotSlotArray(const SnapshotSlotArray& other) : SnapshotSlotArray()
+    {
+        CopyFrom(other);
+    }
+
+    SnapshotSlotArray(SnapshotSlotArray&&) = delete;
+
+    SnapshotSlotArray& operator=(const SnapshotSlotArray& other)
+    {
+        if (this != &other)
+        {
+            CopyFrom(other);
+        }
+
+        return *this;
+    }
+
+    SnapshotSlotArray& operator=(SnapshotSlotArray&&) = delete;
+
+    ~SnapshotSlotArray() = default;
+
+    [[nodiscard]] uint64 Add(T&& value)
+    {
+        SpinLockGuard guard(_lock);
+
+        uint32 index;
+        if (!_freeIndices.IsEmpty())
+        {
+            index = _freeIndices.Back();
+            _freeIndices.PopBack();
+        }
+        else
+        {
+            index = static_cast<uint32>(_slots.Count());
+            _slots.AddDefault();
+        }
+
+        Slot& slot = _slots[index];
+        slot.Value = std::move(value);
+        slot.IsOccupied = true;
+
+        Publish();
+
+        return MakeHandle(index, slot.Generation);
+    }
+
+    bool Remove(uint64 handle)
+    {
+        SpinLockGuard guard(_lock);
+
+        const uint32 index = GetIndex(handle);
+        if (index >= _slots.Count())
+        {
+            return false;
+        }
+
+        Slot& slot = _slots[index];
+        if (!slot.IsOccupied || slot.Generation != GetGeneration(handle))
+        {
+            return false;
+        }
+
+        slot.Value = T();
+        slot.IsOccupied = false;
+        ++slot.Generation;
+
+        _freeIndices.Add(index);
+
+        Publish();
+
+        return true;
+    }
+
+    void Clear()
+    {
+        SpinLockGuard guard(_lock);
+
+        for (uint32 i = 0; i < _slots.Count(); ++i)
+        {
+            Slot& slot = _slots[i];
+            if (!slot.IsOccupied)
+            {
+                continue;
+            }
+
+            slot.Value = T();
+            slot.IsOccupied = false;
+            ++slot.Generation;
+
+            _freeIndices.Add(i);
+        }
+
+        Publish();
+    }
+
+    /**
+     * Returns the latest published snapshot. The snapshot stays valid for as long as the caller holds on to it,
+     * regardless of concurrent modifications.
+     */
+    [[nodiscard]] SnapshotPtr GetSnapshot() const
+    {
+        return _snapshot.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Returns the latest published snapshot without taking ownership of it. The snapshot stays valid until the next
+     * ReclaimRetiredSnapshots call.
+     */
+    [[nodiscard]] const Snapshot& GetCurrentSnapshot() const
+    {
+        return *_currentSnapshot.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Frees snapshots replaced since the last call. Must not run concurrently with readers of GetCurrentSnapshot,
+     * owners that only read through GetSnapshot may call it at any time.
+     */
+    void ReclaimRetiredSnapshots()
+    {
+        SpinLockGuard guard(_lock);
+        _retiredSnapshots.Clear();
+    }
+
+    /**
+     * Number of values in the latest published snapshot, a single atomic load.
+     */
+    [[nodiscard]] uint32 GetCount() const
+    {
+        return _count.load(std::memory_order_acquire);
+    }
+
+    [[nodiscard]] bool IsEmpty() const
+    {
+        return GetCount() == 0;
+    }
+
+private:
+    struct Slot
+    {
+        T Value{};
+        uint32 Generation = 0;
+        bool IsOccupied = false;
+    };
+
+    DArray<Slot> _slots;
+    DArray<uint32> _freeIndices;
+
+    mutable SpinLock _lock;
+    std::atomic<SnapshotPtr> _snapshot;
+    std::atomic<const Snapshot*> _currentSnapshot;
+    std::atomic<uint32> _count = 0;
+
+    // Replaced snapshots that readers of GetCurrentSnapshot may still be iterating
+    DArray<SnapshotPtr> _retiredSnapshots;
+
+private:
+    static constexpr uint64 MakeHandle(uint32 index, uint32 generation)
+    {
+        return static_cast<uint64>(generation) << 32 | static_cast<uint64>(index + 1);
+    }
+
+    static constexpr uint32 GetIndex(uint64 handle)
+    {
+        return static_cast<uint32>(handle & 0xFFFFFFFFull) - 1;
+    }
+
+    static constexpr uint32 GetGeneration(uint64 handle)
+    {
+        return static_cast<uint32>(handle >> 32);
+    }
+
+    // Must be called while holding _lock.
+    void Publish()
+    {
+        std::shared_ptr<Snapshot> snapshot = std::make_shared<Snapshot>();
+        snapshot->Reserve(_slots.Count() - _freeIndices.Count());
+
+        for (const Slot& slot : _slots)
+        {
+            if (slot.IsOccupied)
+            {
+                snapshot->Add(slot.Value);
+            }
+        }
+
+        const uint32 count = static_cast<uint32>(snapshot->Count());
+        _currentSnapshot.store(snapshot.get(), std::memory_order_release);
+        _retiredSnapshots.Add(_snapshot.exchange(std::move(snapshot), std::memory_order_acq_rel));
+        _count.store(count, std::memory_order_release);
+    }
+
+    // Copies slots as-is, so handles issued by other remain valid for this array.
+    void CopyFrom(const SnapshotSlotArray& other)
+    {
+        SpinLockGuard otherGuard(other._lock);
+        SpinLockGuard guard(_lock);
+
+        _slots.Clear();
+        _freeIndices.Clear();
+
+        for (const Slot& slot : other._slots)
+        {
+            _slots.Add(slot);
+        }
+
+        for (const uint32 index : other._freeIndices)
+        {
+            _freeIndices.Add(index);
+        }
+
+        Publish();
+    }
+};
@@ -0,0 +1,386 @@
+﻿#pragma once
+
+#include "Core.h"
+#include "BoundingBox.h"
+#include "Containers/DArray.h"
+#include "Math/Math.h"
+#include <functional>
+
+/**
+ * Incrementally updated bounding volume hierarchy of fattened AABBs.
+ * Leaves store AABBs enlarged by a margin, so items moving a little don't need to be reinserted. Insertion picks
+ * the sibling with the lowest surface area cost and the tree is kept balanced with rotations, so it copes well with
+ * items of very different sizes.
+ */
+class DynamicAABBTree
+{
+public:
+    static constexpr uint32 NullNode = std::numeric_limits<uint32>::max();
+
+public:
+    explicit DynamicAABBTree(float fatMargin = 0.1f) :
+        _fatMargin(fatMargin)
+    {
+    }
+
+    /**
+     * Returns proxy ID used to move and remove the item.
+     */
+    uint32 Insert(uint32 item, const BoundingBox& aabb)
+    {
+        const uint32 proxy = AllocateNode();
+
+        Node& node = _nodes[proxy];
+        node.AABB = MakeFat(aabb);
+        node.Item = item;
+        node.Height = 0;
+
+        InsertLeaf(proxy);
+
+        return proxy;
+    }
+
+    void Remove(uint32 proxy)
+    {
+        RemoveLeaf(proxy);
+        FreeNode(proxy);
+    }
+
+    /**
+     * Reinserts the item if aabb is no longer contained in its fat AABB. Returns true if the item was reinserted.
+     */
+    bool Move(uint32 proxy, const BoundingBox& aabb)
+    {
+        if (Contains(_nodes[proxy].AABB, aabb))
+        {
+            return false;
+        }
+
+        RemoveLeaf(proxy);
+        _nodes[proxy].AABB = MakeFat(aabb);
+        InsertLeaf(proxy);
+
+        return true;
+    }
+
+    uint32 GetItem(uint32 proxy) const
+    {
+        return _nodes[proxy].Item;
+    }
+
+    const BoundingBox& GetFatAABB(uint32 proxy) const
+    {
+        return _nodes[proxy].AABB;
+    }
+
+    uint32 GetHeight() const
+    {
+        return _root == NullNode ? 0 : static_cast<uint32>(_nodes[_root].Height);
+    }
+
+    void Query(const BoundingBox& aabb, const std::function<bool(uint32 item)>& func) const
+    {
+        Traverse([&aabb](const BoundingBox& nodeAABB)
+        {
+            return nodeAABB.Overlap(aabb);
+        }, func);
+    }
+
+    void Query(const Line& line, const std::function<bool(uint32 item)>& func) const
+    {
+        Traverse([&line](const BoundingBox& nodeAABB)
+        {
+            return nodeAABB.Overlap(line);
+        }, func);
+    }
+
+private:
+    struct Node
+    {
+    public:
+        BoundingBox AABB;
+        uint32 Parent = NullNode;
+        uint32 Children[2] = {NullNode, NullNode};
+        uint32 Item = 0;
+        // Leaves have height 0, free nodes -1
+        int32 Height = -1;
+
+    public:
+        bool IsLeaf() const
+        {
+            return Children[0] == NullNode;
+        }
+    };
+
+    DArray<Node> _nodes;
+    DArray<uint32> _freeNodes;
+    uint32 _root = NullNode;
+
+    float _fatMargin;
+
+private:
+    uint32 AllocateNode()
+    {
+        if (!_freeNodes.IsEmpty())
+        {
+            const uint32 index = _freeNodes.Back();
+            _freeNodes.PopBack();
+
+            _nodes[index] = Node();
+            return index;
+        }
+
+        _nodes.AddDefault();
+        return static_cast<uint32>(_nodes.Count()) - 1;
+    }
+
+    void FreeNode(uint32 index)
+    {
+        _nodes[index].Height = -1;
+        _freeNodes.Add(index);
+    }
+
+    BoundingBox MakeFat(const BoundingBox& aabb) const
+    {
+        const Vector3 margin = Vector3(_fatMargin);
+        return BoundingBox(aabb.GetMin() - margin, aabb.GetMax() + margin);
+    }
+
+    static bool Contains(const BoundingBox& outer, const BoundingBox& inner)
+    {
+        const Vector3& outerMin = outer.GetMin();
+        const Vector3& outerMax = outer.GetMax();
+        const Vector3& innerMin = inner.GetMin();
+        const Vector3& innerMax = inner.GetMax();
+
+        return outerMin.x <= innerMin.x && outerMin.y <= innerMin.y && outerMin.z <= innerMin.z &&
+            innerMax.x <= outerMax.x && innerMax.y <= outerMax.y && innerMax.z <= outerMax.z;
+    }
+
+    static float SurfaceArea(const BoundingBox& aabb)
+    {
+        const Vector3 size = aabb.GetMax() - aabb.GetMin();
+        return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+
+    void InsertLeaf(uint32 leaf)
+    {
+        if (_root == NullNode)
+        {
+            _root = leaf;
+            _nodes[leaf].Parent = NullNode;
+            return;
+        }
+
+        // Find the best sibling, descending while it's cheaper to push the leaf further down
+        const BoundingBox leafAABB = _nodes[leaf].AABB;
+        uint32 index = _root;
+        while (!_nodes[index].IsLeaf())
+        {
+            const Node& node = _nodes[index];
+
+            const float area = SurfaceArea(node.AABB);
+            const float combinedArea = SurfaceArea(node.AABB.Union(leafAABB));
+
+            const float cost = 2.0f * combinedArea;
+            const float inheritanceCost = 2.0f * (combinedArea - area);
+
+            float childCosts[2];
+            for (uint32 i = 0; i < 2; ++i)
+            {
+                const Node& child = _nodes[node.Children[i]];
+                const float unionArea = SurfaceArea(child.AABB.Union(leafAABB));
+
+                childCosts[i] = (child.IsLeaf() ? unionArea : unionArea - SurfaceArea(child.AABB)) + inheritanceCost;
+            }
+
+            if (cost < childCosts[0] && cost < childCosts[1])
+            {
+                break;
+            }
+
+            index = childCosts[0] < childCosts[1] ? node.Children[0] : node.Children[1];
+        }
+
+        const uint32 sibling = index;
+        const uint32 oldParent = _nodes[sibling].Parent;
+        const uint32 newParent = AllocateNode();
+
+        Node& newParentNode = _nodes[newParent];
+        newParentNode.Parent = oldParent;
+        newParentNode.AABB = leafAABB.Union(_nodes[sibling].AABB);
+        newParentNode.Height = _nodes[sibling].Height + 1;
+        newParentNode.Children[0] = sibling;
+        newParentNode.Children[1] = leaf;
+
+        if (oldParent != NullNode)
+        {
+            Node& oldParentNode = _nodes[oldParent];
+            oldParentNode.Children[oldParentNode.Children[0] == sibling ? 0 : 1] = newParent;
+        }
+        else
+        {
+            _root = newParent;
+        }
+
+        _nodes[sibling].Parent = newParent;
+        _nodes[leaf].Parent = newParent;
+
+        Refit(_nodes[leaf].Parent);
+    }
+
+    void RemoveLeaf(uint32 leaf)
+    {
+        if (leaf == _root)
+        {
+            _root = NullNode;
+            return;
+        }
+
+        const uint32 parent = _nodes[leaf].Parent;
+        const uint32 grandParent = _nodes[parent].Parent;
+        const uint32 sibling = _nodes[parent].Children[_nodes[parent].Children[0] == leaf ? 1 : 0];
+
+        if (grandParent != NullNode)
+        {
+            Node& grandParentNode = _nodes[grandParent];
+            grandParentNode.Children[grandParentNode.Children[0] == parent ? 0 : 1] = sibling;
+            _nodes[sibling].Parent = grandParent;
+
+            FreeNode(parent);
+            Refit(grandParent);
+        }
+        else
+        {
+            _root = sibling;
+            _nodes[sibling].Parent = NullNode;
+
+            FreeNode(parent);
+        }
+    }
+
+    // Walks from index to the root, balancing and recomputing AABBs and heights
+    void Refit(uint32 index)
+    {
+        while (index != NullNode)
+        {
+            index = Balance(index);
+
+            Node& node = _nodes[index];
+            const Node& child0 = _nodes[node.Children[0]];
+            const Node& child1 = _nodes[node.Children[1]];
+
+            node.Height = 1 + Math::Max(child0.Height, child1.Height);
+            node.AABB = child0.AABB.Union(child1.AABB);
+
+            index = node.Parent;
+        }
+    }
+
+    // Rotates the taller child of a up if subtrees of a are imbalanced, returns the new root of the subtree
+    uint32 Balance(uint32 a)
+    {
+        Node& nodeA = _nodes[a];
+        if (nodeA.IsLeaf() || nodeA.Height < 2)
+        {
+            return a;
+        }
+
+        const uint32 b = nodeA.Children[0];
+        const uint32 c = nodeA.Children[1];
+        const int32 balance = _nodes[c].Height - _nodes[b].Height;
+
+        if (balance > 1)
+        {
+            return Rotate(a, c, 1);
+        }
+
+        if (balance < -1)
+        {
+            return Rotate(a, b, 0);
+        }
+
+        return a;
+    }
+
+    // Moves child of a at childSlot up in place of a, a takes the shorter grandchild
+    uint32 Rotate(uint32 a, uint32 up, uint32 childSlot)
+    {
+        Node& nodeA = _nodes[a];
+        Node& nodeUp = _nodes[up];
+
+        const uint32 f = nodeUp.Children[0];
+        const uint32 g = nodeUp.Children[1];
+        Node& nodeF = _nodes[f];
+        Node& nodeG = _nodes[g];
+
+        nodeUp.Children[0] = a;
+        nodeUp.Parent = nodeA.Parent;
+        nodeA.Parent = up;
+
+        if (nodeUp.Parent != NullNode)
+        {
+            Node& parentNode = _nodes[nodeUp.Parent];
+            parentNode.Children[parentNode.Children[0] == a ? 0 : 1] = up;
+        }
+        else
+        {
+            _root = up;
+        }
+
+        const Node& nodeOther = _nodes[nodeA.Children[1 - childSlot]];
+
+        // Taller grandchild stays with the rotated node, shorter one goes to a
+        const bool isFTaller = nodeF.Height > nodeG.Height;
+        const uint32 taller = isFTaller ? f : g;
+        const uint32 shorter = isFTaller ? g : f;
+
+        nodeUp.Children[1] = taller;
+        nodeA.Children[childSlot] = shorter;
+        _nodes[shorter].Parent = a;
+
+        nodeA.AABB = nodeOther.AABB.Union(_nodes[shorter].AABB);
+        nodeA.Height = 1 + Math::Max(nodeOther.Height, _nodes[shorter].Height);
+
+        nodeUp.AABB = nodeA.AABB.Union(_nodes[taller].AABB);
+        nodeUp.Height = 1 + Math::Max(nodeA.Height, _nodes[taller].Height);
+
+        return up;
+    }
+
+    void Traverse(const std::function<bool(const BoundingBox& nodeAABB)>& overlaps, const std::function<bool(uint32 item)>& func) const
+    {
+        if (_root == NullNode)
+        {
+            return;
+        }
+
+        DArray<uint32, 64> stack;
+        stack.Add(_root);
+
+        while (!stack.IsEmpty())
+        {
+            const uint32 index = stack.Back();
+            stack.PopBack();
+
+            const Node& node = _nodes[index];
+            if (!overlaps(node.AABB))
+            {
+                continue;
+            }
+
+            if (node.IsLeaf())
+            {
+                if (!func(node.Item))
+                {
+                    return;
+                }
+
+                continue;
+            }
+
+            stack.Add(node.Children[0]);
+            stack.Add(node.Children[1]);
+        }
+    }
+};
@@ -0,0 +1,581 @@
+﻿#pragma once
+
+#include "Core.h"
+#include "BoundingBox.h"
+#include "Containers/DArray.h"
+#include "Math/Math.h"
+#include <algorithm>
+#include <bit>
+#include <functional>
+#include <span>
+
+/**
+ * Uniform grid over fixed bounds, storing indices of items overlapping each cell.
+ * Only occupied cells are stored, in an open addressed hash table keyed by Morton code of the cell index. Items of
+ * all cells live in one shared pool, ordered by Morton code of their cell, so neighbouring cells are mostly close in
+ * memory as well. Grid is not updated incrementally, it's rebuilt from scratch with a counting sort.
+ */
+class SpatialHashGrid3D
+{
+public:
+    struct CellIndex
+    {
+        int32 X = 0;
+        int32 Y = 0;
+        int32 Z = 0;
+    };
+
+    // Morton code uses 10 bits per axis
+    static constexpr uint32 MaxCellCountPerAxis = 1024;
+
+public:
+    void Initialize(const BoundingBox& bounds, uint32 cellCountPerAxis)
+    {
+        _bounds = bounds;
+        _cellCountPerAxis = Math::Clamp(cellCountPerAxis, 1u, MaxCellCountPerAxis);
+        _cellSize = bounds.GetExtent() * 2.0f / static_cast<float>(_cellCountPerAxis);
+    }
+
+    /**
+     * Rebuilds the grid from itemCount items. getBounds returns false for items that should be left out of the grid.
+     */
+    void Build(uint32 itemCount, const std::function<bool(uint32 item, BoundingBox& outBounds)>& getBounds)
+    {
+        _itemRanges.Clear();
+        _itemRanges.Reserve(itemCount);
+
+        uint64 entryCount = 0;
+        for (uint32 item = 0; item < itemCount; ++item)
+        {
+            BoundingBox bounds;
+            if (!getBounds(item, bounds))
+            {
+                _itemRanges.Add({});
+                continue;
+            }
+
+            const CellRange& range = _itemRanges.Add({GetCellIndex(bounds.GetMin()), GetCellIndex(bounds.GetMax()), true});
+            entryCount += range.GetCellCount();
+        }
+
+        const uint32 capacity = Math::NextPowerOfTwo(Math::Max(16u, static_cast<uint32>(entryCount) * 2));
+        _tableShift = 32 - std::countr_zero(capacity);
+
+        _table.Clear();
+        _table.Reserve(capacity);
+        for (uint32 i = 0; i < capacity; ++i)
+        {
+            _table.AddDefault();
+        }
+
+        _occupiedCells.Clear();
+
+        // Count items in each cell
+        for (const CellRange& range : _itemRanges)
+        {
+            ForEachCellInRange(range, [this](uint32 key)
+            {
+                ++FindOrAdd(key).ItemCount;
+            });
+        }
+
+        std::sort(_occupiedCells.GetData(), _occupiedCells.GetData() + _occupiedCells.Count(), [this](uint32 a, uint32 b)
+        {
+            return _table[a].Key < _table[b].Key;
+        });
+
+        uint32 firstItem = 0;
+        for (const uint32 slot : _occupiedCells)
+        {
+            Cell& cell = _table[slot];
+            cell.FirstItem = firstItem;
+            firstItem += cell.ItemCount;
+            cell.ItemCount = 0;
+        }
+
+        _cellItems.Clear();
+        _cellItems.Reserve(entryCount);
+        for (uint64 i = 0; i < entryCount; ++i)
+        {
+            _cellItems.Add(0);
+        }
+
+        for (uint32 item = 0; item < itemCount; ++item)
+        {
+            ForEachCellInRange(_itemRanges[item], [this, item](uint32 key)
+            {
+                Cell& cell = *const_cast<Cell*>(Find(key));
+                _cellItems[cell.FirstItem + cell.ItemCount] = item;
+                ++cell.ItemCount;
+            });
+        }
+    }
+
+    CellIndex GetCellIndex(const Vector3& location) const
+    {
+        const Vector3 index3D = (location - _bounds.GetMin()) / _cellSize;
+        const int64 maxIndex = static_cast<int64>(_cellCountPerAxis) - 1;
+
+        CellIndex index;
+        index.X = static_cast<int32>(Math::Clamp(Math::FloorToInt(index3D.x), static_cast<int64>(0), maxIndex));
+        index.Y = static_cast<int32>(Math::Clamp(Math::FloorToInt(index3D.y), static_cast<int64>(0), maxIndex));
+        index.Z = static_cast<int32>(Math::Clamp(Math::FloorToInt(index3D.z), static_cast<int64>(0), maxIndex));
+
+        return index;
+    }
+
+    std::span<const uint32> GetCellItems(const CellIndex& index) const
+    {
+        if (!IsValidIndex(index))
+        {
+            return {};
+        }
+
+        const Cell* cell = Find(EncodeKey(index));
+        if (cell == nullptr)
+        {
+            return {};
+        }
+
+        return {_cellItems.GetData() + cell->FirstItem, cell->ItemCount};
+    }
+
+    void ForEachCellAt(const BoundingBox& aabb, const std::function<bool(const CellIndex& index, std::span<const uint32> items)>& func) const
+    {
+        const CellIndex min = GetCellIndex(aabb.GetMin());
+        const CellIndex max = GetCellIndex(aabb.GetMax());
+
+        const CellRange range = {min, max, true};
+
+        // Large boxes in sparse grids touch far fewer occupied cells than empty ones
+        if (range.GetCellCount() > _occupiedCells.Count())
+        {
+            for (const uint32 slot : _occupiedCells)
+            {
+                const Cell& cell = _table[slot];
+                const CellIndex index = DecodeKey(cell.Key);
+                if (!range.Contains(index))
+                {
+                    continue;
+                }
+
+                if (!func(index, {_cellItems.GetData() + cell.FirstItem, cell.ItemCount}))
+                {
+                    return;
+                }
+            }
+
+            return;
+        }
+
+        for (int32 x = min.X; x <= max.X; ++x)
+        {
+            for (int32 y = min.Y; y <= max.Y; ++y)
+            {
+                for (int32 z = min.Z; z <= max.Z; ++z)
+                {
+                    const CellIndex index = {x, y, z};
+                    const Cell* cell = Find(EncodeKey(index));
+                    if (cell == nullptr)
+                    {
+                        continue;
+                    }
+
+                    if (!func(index, {_cellItems.GetData() + cell->FirstItem, cell->ItemCount}))
+                    {
+                        return;
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * Walks cells crossed by line in order from start to end, skipping cells without items.
+     */
+    void ForEachCellAlongLine(const Line& line, const std::function<bool(const CellIndex& index, std::span<const uint32> items)>& func) const
+    {
+        const Vector3 direction = line.End - line.Start;
+        const Vector3 relativeStart = line.Start - _bounds.GetMin();
+
+        const CellIndex startIndex = GetCellIndex(line.Start);
+        const CellIndex endIndex = GetCellIndex(line.End);
+
+        int32 index[3] = {startIndex.X, startIndex.Y, startIndex.Z};
+        const int32 end[3] = {endIndex.X, endIndex.Y, endIndex.Z};
+        const float directionAxes[3] = {direction.x, direction.y, direction.z};
+        const float startAxes[3] = {relativeStart.x, relativeStart.y, relativeStart.z};
+        const float cellSizeAxes[3] = {_cellSize.x, _cellSize.y, _cellSize.z};
+
+        // Line parameter at which the next cell boundary is crossed and the parameter distance between boundaries
+        int32 step[3];
+        float tMax[3];
+        float tDelta[3];
+        for (uint32 axis = 0; axis < 3; ++axis)
+        {
+            if (directionAxes[axis] > 0.0f)
+            {
+                step[axis] = 1;
+                tMax[axis] = ((index[axis] + 1) * cellSizeAxes[axis] - startAxes[axis]) / directionAxes[axis];
+                tDelta[axis] = cellSizeAxes[axis] / directionAxes[axis];
+            }
+            else if (directionAxes[axis] < 0.0f)
+            {
+                step[axis] = -1;
+                tMax[axis] = (index[axis] * cellSizeAxes[axis] - startAxes[axis]) / directionAxes[axis];
+                tDelta[axis] = -cellSizeAxes[axis] / directionAxes[axis];
+            }
+            else
+            {
+                step[axis] = 0;
+                tMax[axis] = std::numeric_limits<float>::max();
+                tDelta[axis] = std::numeric_limits<float>::max();
+            }
+        }
+
+        while (true)
+        {
+            const CellIndex cellIndex = {index[0], index[1], index[2]};
+            if (const Cell* cell = Find(EncodeKey(cellIndex)))
+            {
+                if (!func(cellIndex, {_cellItems.GetData() + cell->FirstItem, cell->ItemCount}))
+                {
+                    return;
+                }
+            }
+
+            if (index[0] == end[0] && index[1] == end[1] && index[2] == end[2])
+            {
+                return;
+            }
+
+            const uint32 axis = tMax[0] < tMax[1] ? (tMax[0] < tMax[2] ? 0 : 2) : (tMax[1] < tMax[2] ? 1 : 2);
+            if (tMax[axis] > 1.0f)
+            {
+                return;
+            }
+
+            index[axis] += step[axis];
+            tMax[axis] += tDelta[axis];
+
+            if (!IsValidIndex({index[0], index[1], index[2]}))
+            {
+                return;
+            }
+        }
+    }
+
+    /**
+     * Calls func once for each item in cells overlapping aabb, even if the item spans multiple cells.
+     */
+    void ForEachItemAt(const BoundingBox& aabb, const std::function<bool(uint32 item)>& func) const
+    {
+        const CellIndex queryMin = GetCellIndex(aabb.GetMin());
+
+        ForEachCellAt(aabb, [this, &queryMin, &func](const CellIndex& index, std::span<const uint32> items)
+        {
+            for (const uint32 item : items)
+            {
+                // Item is reported only from the first cell it shares with the query box
+                const CellIndex& itemMin = _itemRanges[item].Min;
+                if (index.X != Math::Max(itemMin.X, queryMin.X) ||
+                    index.Y != Math::Max(itemMin.Y, queryMin.Y) ||
+                    index.Z != Math::Max(itemMin.Z, queryMin.Z))
+                {
+                    continue;
+                }
+
+                if (!func(item))
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        });
+    }
+
+    /**
+     * Nearest item search without a fixed radius. Visits cells in rings of growing distance from the cell of location
+     * and stops once no unvisited cell can hold an item closer than maxDistanceSquared, which func lowers as it finds
+     * closer items. Once a ring would touch more cells than are occupied, the remaining occupied cells are visited
+     * directly instead, skipping those further than maxDistanceSquared. Items spanning cells may be reported twice.
+     */
+    void ForEachItemNear(const Vector3& location, const float& maxDistanceSquared, const std::function<void(uint32 item)>& func) const
+    {
+        if (_occupiedCells.IsEmpty())
+        {
+            return;
+        }
+
+        const CellIndex center = GetCellIndex(location);
+        const float cellSize = Math::Min(_cellSize.x, Math::Min(_cellSize.y, _cellSize.z));
+        const int32 maxRing = static_cast<int32>(_cellCountPerAxis) - 1;
+
+        const auto visitCell = [this, &func](const CellIndex& index)
+        {
+            if (const Cell* cell = Find(EncodeKey(index)))
+            {
+                for (uint32 i = cell->FirstItem; i < cell->FirstItem + cell->ItemCount; ++i)
+                {
+                    func(_cellItems[i]);
+                }
+            }
+        };
+
+        uint64 visitedCellCount = 0;
+        for (int32 ring = 0; ring <= maxRing; ++ring)
+        {
+            // Cells of ring are separated from the cell of location by ring - 1 whole cells
+            const float ringDistance = static_cast<float>(Math::Max(ring - 1, 0)) * cellSize;
+            if (ringDistance * ringDistance > maxDistanceSquared)
+            {
+                return;
+            }
+
+            const uint64 outerSide = 2 * static_cast<uint64>(ring) + 1;
+            const uint64 innerSide = outerSide - 2;
+            const uint64 ringCellCount = ring == 0 ? 1 : outerSide * outerSide * outerSide - innerSide * innerSide * innerSide;
+            if (visitedCellCount + ringCellCount > _occupiedCells.Count())
+            {
+                VisitCellsOutsideRing(location, center, ring, maxDistanceSquared, func);
+                return;
+            }
+
+            visitedCellCount += ringCellCount;
+
+            for (int32 x = center.X - ring; x <= center.X + ring; ++x)
+            {
+                for (int32 y = center.Y - ring; y <= center.Y + ring; ++y)
+                {
+                    // Inside the ring only the cells on its top and bottom faces belong to it
+                    const bool isOnSide = std::abs(x - center.X) == ring || std::abs(y - center.Y) == ring;
+                    const int32 zStep = isOnSide || ring == 0 ? 1 : 2 * ring;
+
+                    for (int32 z = center.Z - ring; z <= center.Z + ring; z += zStep)
+                    {
+                        const CellIndex index = {x, y, z};
+                        if (IsValidIndex(index))
+                        {
+                            visitCell(index);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    bool IsValidIndex(const CellIndex& index) const
+    {
+        const int32 count = static_cast<int32>(_cellCountPerAxis);
+        return index.X >= 0 && index.X < count &&
+            index.Y >= 0 && index.Y < count &&
+            index.Z >= 0 && index.Z < count;
+    }
+
+    const Vector3& GetCellSize() const
+    {
+        return _cellSize;
+    }
+
+    uint32 GetOccupiedCellCount() const
+    {
+        return static_cast<uint32>(_occupiedCells.Count());
+    }
+
+    void ForEachOccupiedCell(const std::function<void(const CellIndex& index, std::span<const uint32> items)>& func) const
+    {
+        for (const uint32 slot : _occupiedCells)
+        {
+            const Cell& cell = _table[slot];
+            func(DecodeKey(cell.Key), {_cellItems.GetData() + cell.FirstItem, cell.ItemCount});
+        }
+    }
+
+private:
+    static constexpr uint32 EmptyKey = std::numeric_limits<uint32>::max();
+
+    struct Cell
+    {
+        uint32 Key = EmptyKey;
+        uint32 FirstItem = 0;
+        uint32 ItemCount = 0;
+    };
+
+    struct CellRange
+    {
+    public:
+        CellIndex Min;
+        CellIndex Max;
+        bool IsValid = false;
+
+    public:
+        uint64 GetCellCount() const
+        {
+            if (!IsValid)
+            {
+                return 0;
+            }
+
+            return static_cast<uint64>(Max.X - Min.X + 1) *
+                static_cast<uint64>(Max.Y - Min.Y + 1) *
+                static_cast<uint64>(Max.Z - Min.Z + 1);
+        }
+
+        bool Contains(const CellIndex& index) const
+        {
+            return index.X >= Min.X && index.X <= Max.X &&
+                index.Y >= Min.Y && index.Y <= Max.Y &&
+                index.Z >= Min.Z && index.Z <= Max.Z;
+        }
+    };
+
+    BoundingBox _bounds;
+    Vector3 _cellSize = Vector3::One;
+    uint32 _cellCountPerAxis = 1;
+
+    // Open addressed hash table of occupied cells, capacity is a power of two
+    DArray<Cell> _table;
+    uint32 _tableShift = 32;
+
+    // Slots of occupied cells in _table, sorted by Morton code
+    DArray<uint32> _occupiedCells;
+    DArray<uint32> _cellItems;
+    DArray<CellRange> _itemRanges;
+
+private:
+    static constexpr uint32 SpreadBits(uint32 value)
+    {
+        value &= 0x000003FF;
+        value = (value | value << 16) & 0x030000FF;
+        value = (value | value << 8) & 0x0300F00F;
+        value = (value | value << 4) & 0x030C30C3;
+        value = (value | value << 2) & 0x09249249;
+
+        return value;
+    }
+
+    static constexpr uint32 CompactBits(uint32 value)
+    {
+        value &= 0x09249249;
+        value = (value | value >> 2) & 0x030C30C3;
+        value = (value | value >> 4) & 0x0300F00F;
+        value = (value | value >> 8) & 0x030000FF;
+        value = (value | value >> 16) & 0x000003FF;
+
+        return value;
+    }
+
+    static constexpr uint32 EncodeKey(const CellIndex& index)
+    {
+        return SpreadBits(static_cast<uint32>(index.X)) |
+            SpreadBits(static_cast<uint32>(index.Y)) << 1 |
+            SpreadBits(static_cast<uint32>(index.Z)) << 2;
+    }
+
+    static constexpr CellIndex DecodeKey(uint32 key)
+    {
+        return {
+            static_cast<int32>(CompactBits(key)),
+            static_cast<int32>(CompactBits(key >> 1)),
+            static_cast<int32>(CompactBits(key >> 2))
+        };
+    }
+
+    uint32 GetSlot(uint32 key) const
+    {
+        // Fibonacci hashing, Morton codes of nearby cells differ mostly in low bits
+        return (key * 2654435769u) >> _tableShift;
+    }
+
+    const Cell* Find(uint32 key) const
+    {
+        if (_table.IsEmpty())
+        {
+            return nullptr;
+        }
+
+        const uint32 mask = static_cast<uint32>(_table.Count()) - 1;
+        for (uint32 slot = GetSlot(key); ; slot = (slot + 1) & mask)
+        {
+            const Cell& cell = _table[slot];
+            if (cell.Key == key)
+            {
+                return &cell;
+            }
+
+            if (cell.Key == EmptyKey)
+            {
+                return nullptr;
+            }
+        }
+    }
+
+    Cell& FindOrAdd(uint32 key)
+    {
+        const uint32 mask = static_cast<uint32>(_table.Count()) - 1;
+        for (uint32 slot = GetSlot(key); ; slot = (slot + 1) & mask)
+        {
+            Cell& cell = _table[slot];
+            if (cell.Key == key)
+            {
+                return cell;
+            }
+
+            if (cell.Key == EmptyKey)
+            {
+                cell.Key = key;
+                _occupiedCells.Add(slot);
+
+                return cell;
+            }
+        }
+    }
+
+    void VisitCellsOutsideRing(const Vector3& location, const CellIndex& center, int32 ring, const float& maxDistanceSquared,
+                               const std::function<void(uint32 item)>& func) const
+    {
+        for (const uint32 slot : _occupiedCells)
+        {
+            const Cell& cell = _table[slot];
+            const CellIndex index = DecodeKey(cell.Key);
+
+            const int32 distance = Math::Max(std::abs(index.X - center.X), Math::Max(std::abs(index.Y - center.Y), std::abs(index.Z - center.Z)));
+            if (distance < ring)
+            {
+                continue;
+            }
+
+            const Vector3 cellMin = _bounds.GetMin() + Vector3(static_cast<float>(index.X), static_cast<float>(index.Y), static_cast<float>(index.Z)) * _cellSize;
+            const Vector3 closest = Vector3::Max(cellMin, Vector3::Min(location, cellMin + _cellSize));
+            if (Vector3::DistanceSquared(location, closest) > maxDistanceSquared)
+            {
+                continue;
+            }
+
+            for (uint32 i = cell.FirstItem; i < cell.FirstItem + cell.ItemCount; ++i)
+            {
+                func(_cellItems[i]);
+            }
+        }
+    }
+
+    static void ForEachCellInRange(const CellRange& range, const std::function<void(uint32 key)>& func)
+    {
+        if (!range.IsValid)
+        {
+            return;
+        }
+
+        for (int32 x = range.Min.X; x <= range.Max.X; ++x)
+        {
+            for (int32 y = range.Min.Y; y <= range.Max.Y; ++y)
+            {
+                for (int32 z = range.Min.Z; z <= range.Max.Z; ++z)
+                {
+                    func(EncodeKey({x, y, z}));
+                }
+            }
+        }
+    }
+};
@@ -1 +1,48 @@
 ﻿#include "CCollider.h"
+#include "MemoryReader.h"
+#include "MemoryWriter.h"
+#include <cstring>
+
+bool CCollider::Serialize(MemoryWriter& writer) const
+{
+    if (!Component::Serialize(writer))
+    {
+        return false;
+    }
+
+    writer << ColliderTransform;
+    writer << Shape;
+
+    writer << _collisionFilterTag;
+    writer << Layer;
+    writer << CollisionMask;
+
+    return true;
+}
+
+bool CCollider::Deserialize(MemoryReader& reader)
+{
+    if (!Component::Deserialize(reader))
+    {
+        return false;
+    }
+
+    reader >> ColliderTransform;
+    reader >> Shape;
+
+    // Assets saved before collision layers keep the default layer and collide with everything
+    uint64 tag = 0;
+    if (reader.GetNumRemainingBytes() >= sizeof(tag))
+    {
+        std::memcpy(&tag, reader.GetCurrentPointer(), sizeof(tag));
+    }
+
+    if (tag == _collisionFilterTag)
+    {
+        reader.Skip(sizeof(tag));
+        reader >> Layer;
+        reader >> CollisionMask;
+    }
+
+    return true;
+}
@@ -8,6 +8,15 @@
 #include "CCollider.reflection.h"
 
 REFLECTED()
+enum class ECollisionLayer : uint8
+{
+    Default,
+    Static,
+    Unit,
+    Projectile
+};
+
+REFLECTED(CustomSerialization)
 class CCollider : public Component
 {
     GENERATED()
@@ -20,4 +29,20 @@ public:
 
     PROPERTY(Edit, Serialize)
     std::variant<BoundingBox, MeshCollision> Shape;
+
+    PROPERTY(Edit, Serialize)
+    ECollisionLayer Layer = ECollisionLayer::Default;
+
+    // Bit i set if this collider collides with colliders in layer i, both colliders must accept each other
+    PROPERTY(Edit, Serialize)
+    uint32 CollisionMask = std::numeric_limits<uint32>::max();
+
+    // Object
+public:
+    virtual bool Serialize(MemoryWriter& writer) const override;
+    virtual bool Deserialize(MemoryReader& reader) override;
+
+private:
+    // Written before Layer and CollisionMask, colliders saved before those existed are followed by other data
+    static constexpr uint64 _collisionFilterTag = 0x43'4F'4C'4C'4D'41'53'4Bull;
 };
@@ -0,0 +1,25 @@
+﻿#pragma once
+
+#include "Component.h"
+#include "Containers/DArray.h"
+#include "CPathBuffer.reflection.h"
+
+/**
+ * Route found by PathfindingSystem for an entity with CPathfinding, entities without it steer by flow fields.
+ */
+REFLECTED()
+class CPathBuffer : public Component
+{
+    GENERATED()
+
+public:
+    // Points where the path changes direction, the last one is the destination the path was found for
+    DArray<Vector3> Waypoints;
+    uint32 NextWaypoint = 0;
+
+    Vector3 PathDestination;
+    uint32 NavigationVersion = 0;
+
+    bool IsPending = false;
+    bool IsPathFound = false;
+};
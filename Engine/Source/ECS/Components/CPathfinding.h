@@ -11,4 +11,10 @@ class CPathfinding : public Component
 public:
     Vector3 Destination;
     float Speed = 1.0f;
+    // Agents keep at least this far from each other's centers when avoiding
+    float AvoidanceRadius = 0.5f;
+
+    // Velocity towards the next waypoint and velocity the agent actually moved with after avoiding others
+    Vector3 PreferredVelocity;
+    Vector3 Velocity;
 };
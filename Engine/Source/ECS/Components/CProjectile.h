@@ -19,4 +19,7 @@ public:
     float Lifetime = 1.0f;
 
     float TimeAlive = 0.0f;
+
+    // Forward vector scaled by Speed, computed once when the projectile is spawned
+    Vector3 Velocity;
 };
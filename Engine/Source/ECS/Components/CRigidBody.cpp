@@ -17,3 +17,8 @@ CCollider& Body::GetCollider() const
 {
     return Entity->Get<CCollider>(ColliderIndex);
 }
+
+bool Body::CanCollideWith(const Body& other) const
+{
+    return (CollisionMask & other.CollisionLayer) != 0 && (other.CollisionMask & CollisionLayer) != 0;
+}
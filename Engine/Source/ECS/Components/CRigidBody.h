@@ -2,6 +2,7 @@
 
 #include "BoundingBox.h"
 #include "Component.h"
+#include "Physics/CollisionKernels.h"
 #include "CRigidBody.reflection.h"
 
 class Entity;
@@ -17,12 +18,34 @@ public:
     uint16 TransformIndex;
     uint16 RigidBodyIndex;
     uint16 ColliderIndex;
-    DArray<uint32, 4> IndicesInCells;
+    // Index of this body in the physics system, stable for the lifetime of the body
+    uint32 BodyIndex = 0;
+
+    // Number of consecutive steps this body has been below sleep velocity thresholds
+    uint32 StepsAtRest = 0;
+    // Index into the awake body array of the current step, used to build islands
+    uint32 IslandIndex = 0;
+    // ID of the sleeping island this body belongs to, 0 if body is not part of a sleeping island
+    uint32 SleepingIslandID = 0;
+
+    // Transform of the body cached once per step, support queries read these from many threads
+    Matrix WorldMatrix;
+    Matrix InverseWorldMatrix;
+
+    // Layer bit of the body and bits of layers it collides with, copied from the collider
+    uint32 CollisionLayer = 1;
+    uint32 CollisionMask = std::numeric_limits<uint32>::max();
+
+    // Set if collider shape is a box, box pairs are tested by closed form kernels instead of GJK/EPA
+    bool IsBox = false;
+    OrientedBox WorldBox;
 
 public:
     CTransform& GetTransform() const;
     CRigidBody& GetRigidBody() const;
     CCollider& GetCollider() const;
+
+    bool CanCollideWith(const Body& other) const;
 };
 
 REFLECTED()
@@ -0,0 +1,22 @@
+﻿#pragma once
+
+#include "Component.h"
+#include "CSimulationLOD.reflection.h"
+
+/**
+ * Marks an entity whose simulation may run at reduced rate far from cameras and level streaming invokers.
+ * Bucket is assigned by the world before systems tick, 0 is the nearest bucket and always ticks at full rate.
+ * Entity templates have to add this component for their entities to take part, no system adds it on its own.
+ */
+REFLECTED()
+class CSimulationLOD : public Component
+{
+    GENERATED()
+
+public:
+    uint8 Bucket = 0;
+
+    // Frame the entity was last simulated in and the time passed since then, both updated with Bucket
+    uint64 LastSimulatedFrame = 0;
+    double DeltaTime = 0.0;
+};
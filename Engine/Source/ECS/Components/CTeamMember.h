@@ -8,6 +8,9 @@ class CTeamMember : public Component
 {
     GENERATED()
     
+public:
+    static constexpr uint32 NoTeam = std::numeric_limits<uint32>::max();
+
 public:
     PROPERTY(Edit, Serialize)
     uint32 TeamID = 0;
@@ -10,6 +10,16 @@ uint64_t Entity::GetID() const
     return _id;
 }
 
+void Entity::SetActive(bool isActive, PassKey<World>)
+{
+    _isActive = isActive;
+}
+
+bool Entity::IsActive() const
+{
+    return _isActive;
+}
+
 void Entity::AddComponent(const SharedObjectPtr<Component>& newComponent, PassKey<World>)
 {
     _components.Emplace(newComponent);
@@ -19,6 +19,12 @@ public:
     void SetID(uint64 id, PassKey<World>);
     [[nodiscard]] uint64 GetID() const;
 
+    /**
+     * Inactive entities are parked in an entity pool, they keep their components but EntityList::ForEach skips them.
+     */
+    void SetActive(bool isActive, PassKey<World>);
+    [[nodiscard]] bool IsActive() const;
+
     void AddComponent(const SharedObjectPtr<Component>& newComponent, PassKey<World>);
     void RemoveComponent(uint16 index, PassKey<World>);
 
@@ -57,6 +63,7 @@ public:
 
 private:
     uint64 _id = 0;
+    bool _isActive = true;
 
     // todo this should be unique ptr, but Object only returns shared ptr
     DArray<SharedObjectPtr<Component>, 5> _components{};
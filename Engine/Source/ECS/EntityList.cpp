@@ -8,3 +8,83 @@ const Archetype& EntityList::GetArchetype() const
 {
     return _type;
 }
+
+void EntityList::ForEach(const std::function<bool(Entity&)>& callback)
+{
+    BucketArray::ForEach([&callback](Entity& entity)
+    {
+        return !entity.IsActive() || callback(entity);
+    });
+}
+
+void EntityList::ForEach(const std::function<bool(const Entity&)>& callback) const
+{
+    BucketArray::ForEach([&callback](const Entity& entity)
+    {
+        return !entity.IsActive() || callback(entity);
+    });
+}
+
+void EntityList::SetGroup(Entity& entity, uint32 groupKey, PassKey<World>)
+{
+    const auto it = _groupSlots.find(&entity);
+    if (it != _groupSlots.end())
+    {
+        if (_groups[it->second.Group].Key == groupKey)
+        {
+            return;
+        }
+
+        RemoveFromGroup(entity, {});
+    }
+
+    uint32 group = 0;
+    while (group < _groups.Count() && _groups[group].Key != groupKey)
+    {
+        ++group;
+    }
+
+    if (group == _groups.Count())
+    {
+        _groups.AddDefault().Key = groupKey;
+    }
+
+    DArray<Entity*>& members = _groups[group].Members;
+    _groupSlots[&entity] = {group, static_cast<uint32>(members.Count())};
+    members.Add(&entity);
+}
+
+void EntityList::RemoveFromGroup(const Entity& entity, PassKey<World>)
+{
+    const auto it = _groupSlots.find(&entity);
+    if (it == _groupSlots.end())
+    {
+        return;
+    }
+
+    const GroupSlot slot = it->second;
+    _groupSlots.erase(it);
+
+    DArray<Entity*>& members = _groups[slot.Group].Members;
+    members.RemoveAtSwap(slot.Index);
+    if (slot.Index < members.Count())
+    {
+        _groupSlots[members[slot.Index]].Index = slot.Index;
+    }
+}
+
+void EntityList::ForEachGroup(const std::function<bool(uint32 groupKey, std::span<Entity* const> members)>& callback) const
+{
+    for (const EntityGroup& group : _groups)
+    {
+        if (group.Members.IsEmpty())
+        {
+            continue;
+        }
+
+        if (!callback(group.Key, std::span<Entity* const>(group.Members.GetData(), group.Members.Count())))
+        {
+            return;
+        }
+    }
+}
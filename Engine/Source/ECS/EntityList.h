@@ -3,6 +3,8 @@
 #include "Archetype.h"
 #include "Entity.h"
 #include "Containers/BucketArray.h"
+#include <span>
+#include <unordered_map>
 
 class EntityList : public BucketArray<Entity>
 {
@@ -11,7 +13,41 @@ public:
     explicit EntityList(const Archetype& type);
 
     const Archetype& GetArchetype() const;
+
+    /**
+     * Same as BucketArray::ForEach but skips inactive entities.
+     */
+    void ForEach(const std::function<bool(Entity&)>& callback);
+    void ForEach(const std::function<bool(const Entity&)>& callback) const;
+
+    /**
+     * Entities can be grouped by a value they share, e.g. their team, so a whole group is visited or skipped without
+     * reading components of its members. Groups are kept up to date by World.
+     */
+    void SetGroup(Entity& entity, uint32 groupKey, PassKey<World>);
+    void RemoveFromGroup(const Entity& entity, PassKey<World>);
+
+    /**
+     * Calls callback for each non-empty group with its key and active members.
+     */
+    void ForEachGroup(const std::function<bool(uint32 groupKey, std::span<Entity* const> members)>& callback) const;
     
+private:
+    struct EntityGroup
+    {
+        uint32 Key = 0;
+        DArray<Entity*> Members;
+    };
+
+    struct GroupSlot
+    {
+        uint32 Group = 0;
+        uint32 Index = 0;
+    };
+
 private:
     Archetype _type;
+
+    DArray<EntityGroup> _groups;
+    std::unordered_map<const Entity*, GroupSlot> _groupSlots;
 };
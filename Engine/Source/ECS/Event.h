@@ -3,6 +3,7 @@
 #include "TypeSet.h"
 #include "Containers/DArray.h"
 #include "Containers/LockFreeQueue.h"
+#include "Containers/SnapshotSlotArray.h"
 #include "ECS/Archetype.h"
 #include "ECS/EntityListGraph.h"
 
@@ -150,33 +151,12 @@ class EventDispatcher : public EventDispatcherBase
 public:
     [[nodiscard]] EventHandle RegisterListener(Event<ComponentList, Args...>& event)
     {
-        const uint64 id = _idGenerator.GenerateID();
-        _listener.Add({&event, id});
-        _handleIDToIndex[id] = _listener.Count() - 1;
-
-        return {id};
+        return {_listeners.Add(&event)};
     }
 
     void UnregisterListener(const EventHandle& handle)
     {
-        const auto it = _handleIDToIndex.find(handle.ID);
-        if (it == _handleIDToIndex.end())
-        {
-            return;
-        }
-
-        size_t index = it->second;
-        _handleIDToIndex.erase(handle.ID);
-
-        if (index == _listener.Count() - 1)
-        {
-            _listener.PopBack();
-            return;
-        }
-
-        _listener.RemoveAtSwap(index);
-
-        _handleIDToIndex[_listener[index].ID] = index;
+        _listeners.Remove(handle.ID);
     }
 
     template <typename SystemType> requires IsA<SystemType, SystemBase> && IsCompatible<ComponentList, SystemType>
@@ -190,24 +170,26 @@ public:
         Add(entity, archetype, args...);
     }
 
-private:
-    struct Listener
+    /**
+     * Frees listener snapshots replaced by RegisterListener and UnregisterListener. Must be called by the owner at a
+     * point where nothing signals the dispatcher.
+     */
+    void ReclaimRetiredListeners()
     {
-        Event<ComponentList, Args...>* Event;
-        uint64 ID;
-    };
-
-    DArray<Listener> _listener;
+        _listeners.ReclaimRetiredSnapshots();
+    }
 
-    std::map<uint64, size_t> _handleIDToIndex;
-    IDGenerator<uint64> _idGenerator;
+private:
+    // Listeners can register and unregister while other threads signal. Add reads the current snapshot through a
+    // plain pointer, as it's signalled on every write of a component, so no reference count is shared between threads
+    SnapshotSlotArray<Event<ComponentList, Args...>*> _listeners;
 
 private:
     void Add(Entity& entity, const Archetype& archetype, Args... args)
     {
-        for (const Listener& listener : _listener)
+        for (Event<ComponentList, Args...>* listener : _listeners.GetCurrentSnapshot())
         {
-            SignalEvent(*listener.Event, entity, archetype, args...);
+            SignalEvent(*listener, entity, archetype, args...);
         }
     }
 };
@@ -0,0 +1,136 @@
+﻿#include "SimulationLOD.h"
+#include "ECS/World.h"
+#include "ECS/Components/CCamera.h"
+#include "ECS/Components/CLevelStreamingInvoker.h"
+#include "ECS/Components/CSimulationLOD.h"
+#include "ECS/Components/CTransform.h"
+#include "Math/Math.h"
+
+SimulationLOD::SimulationLOD()
+{
+    SetBucket(0, 0.0f, 1);
+    SetBucket(1, 50.0f, 2);
+    SetBucket(2, 100.0f, 4);
+    SetBucket(3, 200.0f, 8);
+}
+
+void SimulationLOD::SetBucket(uint32 bucket, float minDistance, uint32 tickInterval)
+{
+    _bucketDistances[bucket] = bucket == 0 ? 0.0f : minDistance;
+    _tickIntervals[bucket] = bucket == 0 ? 1 : Math::Clamp(tickInterval, 1u, MaxTickInterval);
+}
+
+float SimulationLOD::GetBucketDistance(uint32 bucket) const
+{
+    return _bucketDistances[bucket];
+}
+
+uint32 SimulationLOD::GetTickInterval(uint32 bucket) const
+{
+    return _tickIntervals[bucket];
+}
+
+void SimulationLOD::Update(World& world, double deltaTime)
+{
+    ++_frameIndex;
+    _frameDeltaTimes[_frameIndex % MaxTickInterval] = deltaTime;
+
+    for (uint32 bucket = 0; bucket < BucketCount; ++bucket)
+    {
+        _entityCounts[bucket] = 0;
+    }
+
+    _sourceLocations.Clear();
+
+    world.Query<CCamera>(_cameraQuery);
+    for (EntityList* entityList : _cameraQuery.GetEntityLists())
+    {
+        const uint16 cameraIndex = entityList->GetArchetype().GetComponentIndex<CCamera>();
+        entityList->ForEach([this, cameraIndex](Entity& entity)
+        {
+            _sourceLocations.Add(entity.Get<CCamera>(cameraIndex).GetTransform().GetWorldLocation());
+            return true;
+        });
+    }
+
+    world.Query<CTransform, CLevelStreamingInvoker>(_invokerQuery);
+    for (EntityList* entityList : _invokerQuery.GetEntityLists())
+    {
+        const uint16 transformIndex = entityList->GetArchetype().GetComponentIndex<CTransform>();
+        entityList->ForEach([this, transformIndex](Entity& entity)
+        {
+            _sourceLocations.Add(entity.Get<CTransform>(transformIndex).ComponentTransform.GetWorldLocation());
+            return true;
+        });
+    }
+
+    float bucketDistancesSquared[BucketCount];
+    for (uint32 bucket = 0; bucket < BucketCount; ++bucket)
+    {
+        bucketDistancesSquared[bucket] = Math::Square(_bucketDistances[bucket]);
+    }
+
+    world.Query<CTransform, CSimulationLOD>(_entityQuery);
+    for (EntityList* entityList : _entityQuery.GetEntityLists())
+    {
+        const uint16 transformIndex = entityList->GetArchetype().GetComponentIndex<CTransform>();
+        const uint16 lodIndex = entityList->GetArchetype().GetComponentIndex<CSimulationLOD>();
+
+        entityList->ForEach([this, transformIndex, lodIndex, &bucketDistancesSquared](Entity& entity)
+        {
+            // Without any relevance source nothing can be far, everything is simulated at full rate
+            uint8 bucket = 0;
+            if (!_sourceLocations.IsEmpty())
+            {
+                const Vector3 location = entity.Get<CTransform>(transformIndex).ComponentTransform.GetWorldLocation();
+
+                float nearestDistanceSquared = std::numeric_limits<float>::max();
+                for (const Vector3& sourceLocation : _sourceLocations)
+                {
+                    nearestDistanceSquared = Math::Min(nearestDistanceSquared, Vector3::DistanceSquared(location, sourceLocation));
+                }
+
+                while (bucket + 1 < BucketCount && nearestDistanceSquared >= bucketDistancesSquared[bucket + 1])
+                {
+                    ++bucket;
+                }
+            }
+
+            CSimulationLOD& simulationLOD = entity.Get<CSimulationLOD>(lodIndex);
+            simulationLOD.Bucket = bucket;
+            ++_entityCounts[bucket];
+
+            if (IsSimulatedThisFrame(bucket, entity.GetID()))
+            {
+                simulationLOD.DeltaTime = GetDeltaTimeSince(simulationLOD.LastSimulatedFrame);
+                simulationLOD.LastSimulatedFrame = _frameIndex;
+            }
+
+            return true;
+        });
+    }
+}
+
+bool SimulationLOD::IsSimulatedThisFrame(uint32 bucket, uint64 entityID) const
+{
+    return (_frameIndex + entityID) % _tickIntervals[bucket] == 0;
+}
+
+double SimulationLOD::GetDeltaTimeSince(uint64 frame) const
+{
+    // New entities haven't been simulated yet, only the current frame passed for them
+    const uint64 frameCount = frame == 0 ? 1 : Math::Min(_frameIndex - frame, static_cast<uint64>(MaxTickInterval));
+
+    double deltaTime = 0.0;
+    for (uint64 i = 0; i < frameCount; ++i)
+    {
+        deltaTime += _frameDeltaTimes[(_frameIndex - i) % MaxTickInterval];
+    }
+
+    return deltaTime;
+}
+
+uint32 SimulationLOD::GetEntityCount(uint32 bucket) const
+{
+    return _entityCounts[bucket];
+}
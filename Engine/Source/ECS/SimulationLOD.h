@@ -0,0 +1,55 @@
+﻿#pragma once
+
+#include "Core.h"
+#include "ECS/ECSQuery.h"
+
+class World;
+
+/**
+ * Buckets entities with CSimulationLOD by distance to the nearest relevance source, which is any camera or level
+ * streaming invoker. Systems that opt in to a bucket only simulate its entities every Nth frame, with delta time
+ * covering all frames since the entity was last simulated, so moving between buckets doesn't lose or repeat time. Entities of one bucket are spread over those frames by their IDs, so the cost of a
+ * bucket is split evenly instead of landing on one frame.
+ */
+class SimulationLOD
+{
+public:
+    static constexpr uint32 BucketCount = 4;
+    static constexpr uint32 MaxTickInterval = 16;
+
+public:
+    SimulationLOD();
+
+    /**
+     * Entities at least minDistance away from every relevance source are in bucket unless a further bucket takes
+     * them, they are simulated every tickInterval frames. Bucket 0 is always simulated every frame.
+     */
+    void SetBucket(uint32 bucket, float minDistance, uint32 tickInterval);
+    float GetBucketDistance(uint32 bucket) const;
+    uint32 GetTickInterval(uint32 bucket) const;
+
+    void Update(World& world, double deltaTime);
+
+    bool IsSimulatedThisFrame(uint32 bucket, uint64 entityID) const;
+
+    uint32 GetEntityCount(uint32 bucket) const;
+
+private:
+    float _bucketDistances[BucketCount];
+    uint32 _tickIntervals[BucketCount];
+
+    uint64 _frameIndex = 0;
+    double _frameDeltaTimes[MaxTickInterval] = {};
+    uint32 _entityCounts[BucketCount] = {};
+
+    ECSQuery _cameraQuery;
+    ECSQuery _invokerQuery;
+    ECSQuery _entityQuery;
+    DArray<Vector3> _sourceLocations;
+
+private:
+    /**
+     * Time passed since frame, frames older than MaxTickInterval are no longer known and aren't counted.
+     */
+    double GetDeltaTimeSince(uint64 frame) const;
+};
@@ -1,6 +1,9 @@
 ﻿#include "ECS/Systems/HealthSystem.h"
 #include "ECS/World.h"
 #include "ECS/Components/CHealth.h"
+#include "ECS/Components/CTransform.h"
+#include "Engine/Engine.h"
+#include "Math/Math.h"
 
 HealthSystem::HealthSystem(const HealthSystem& other) : System(other)
 {
@@ -11,10 +14,27 @@ void HealthSystem::DamageEntity(Entity& entity, const Archetype& archetype, floa
     _onEntityDamaged.Add(entity, archetype, damage, PassKey<HealthSystem>());
 }
 
+void HealthSystem::DamageArea(const Vector3& center, float radius, float damage, uint32 sparedTeamID)
+{
+    _areaDamageQueue.Enqueue({center, radius, damage, sparedTeamID});
+}
+
+void HealthSystem::Initialize()
+{
+    System::Initialize();
+
+    const Vector3 size = World::WorldBounds.GetMax() - World::WorldBounds.GetMin();
+    _targetGrid.Initialize(World::WorldBounds, static_cast<uint32>(Math::Max(1.0f, Math::Max(size.x, size.y) / _targetCellSize)));
+}
+
 void HealthSystem::Tick(double deltaTime)
 {
     GetEventQueue().ProcessEvents();
 
+    _damagedEntities.Clear();
+    _damagedEntityIndices.clear();
+    _killedEntities.Clear();
+
     for (auto& entityListStruct : _onEntityDamaged.GetEntityLists())
     {
         if (!entityListStruct.EntityArchetype.HasComponent<CHealth>())
@@ -24,8 +44,6 @@ void HealthSystem::Tick(double deltaTime)
         
         CacheArchetype(entityListStruct.EntityArchetype);
 
-        World& world = GetWorld();
-
         Event<TypeSet<>, float>::EventData eventData;
         while (entityListStruct.Queue.Dequeue(eventData))
         {
@@ -34,13 +52,138 @@ void HealthSystem::Tick(double deltaTime)
                 continue;
             }
 
-            CHealth& health = Get<CHealth>(*eventData.Entity);
-            health.Health -= std::get<float>(eventData.Arguments);
+            AddDamage(*eventData.Entity, Get<CHealth>(*eventData.Entity), std::get<float>(eventData.Arguments));
+        }
+    }
+
+    ResolveAreaDamage();
+
+    for (const DamagedEntity& damagedEntity : _damagedEntities)
+    {
+        damagedEntity.Health->Health -= damagedEntity.Damage;
+
+        if (damagedEntity.Health->Health <= 0.0f)
+        {
+            _killedEntities.Add(damagedEntity.Target);
+        }
+    }
+
+    GetWorld().DestroyEntitiesAsync(_killedEntities);
+}
+
+void HealthSystem::AddDamage(Entity& entity, CHealth& health, float damage)
+{
+    const auto [it, isNew] = _damagedEntityIndices.emplace(&entity, static_cast<uint32>(_damagedEntities.Count()));
+    if (isNew)
+    {
+        _damagedEntities.Add({&entity, &health, damage});
+    }
+    else
+    {
+        _damagedEntities[it->second].Damage += damage;
+    }
+}
+
+void HealthSystem::ResolveAreaDamage()
+{
+    _areaDamageRequests.Clear();
+
+    AreaDamageRequest request;
+    while (_areaDamageQueue.Dequeue(request))
+    {
+        _areaDamageRequests.Add(request);
+    }
+
+    if (_areaDamageRequests.IsEmpty())
+    {
+        return;
+    }
+
+    // Targets are indexed once per tick, however many requests there are
+    _targets.Clear();
+    _targetHealths.Clear();
+    _targetLocations.Clear();
+    _targetTeamIDs.Clear();
+
+    GetWorld().Query<CHealth, CTransform>(_targetQuery);
+    for (EntityList* entityList : _targetQuery.GetEntityLists())
+    {
+        const uint16 healthIndex = entityList->GetArchetype().GetComponentIndex<CHealth>();
+        const uint16 transformIndex = entityList->GetArchetype().GetComponentIndex<CTransform>();
+
+        const auto addTarget = [this, healthIndex, transformIndex](Entity& entity, uint32 teamID)
+        {
+            _targets.Add(&entity);
+            _targetHealths.Add(&entity.Get<CHealth>(healthIndex));
+            _targetLocations.Add(entity.Get<CTransform>(transformIndex).ComponentTransform.GetWorldLocation());
+            _targetTeamIDs.Add(teamID);
+        };
+
+        // Team members are grouped by team, so their team is known without reading CTeamMember
+        if (entityList->GetArchetype().HasComponent<CTeamMember>())
+        {
+            entityList->ForEachGroup([&addTarget](uint32 teamID, std::span<Entity* const> members)
+            {
+                for (Entity* entity : members)
+                {
+                    addTarget(*entity, teamID);
+                }
 
-            if (health.Health <= 0.0f)
+                return true;
+            });
+        }
+        else
+        {
+            entityList->ForEach([&addTarget](Entity& entity)
             {
-                world.DestroyEntityAsync(*eventData.Entity);
-            }
+                addTarget(entity, CTeamMember::NoTeam);
+                return true;
+            });
+        }
+    }
+
+    _targetGrid.Build(static_cast<uint32>(_targets.Count()), [this](uint32 target, BoundingBox& outBounds)
+    {
+        outBounds = BoundingBox(_targetLocations[target], _targetLocations[target]);
+        return true;
+    });
+
+    const uint32 requestCount = static_cast<uint32>(_areaDamageRequests.Count());
+    while (_areaDamageHits.Count() < requestCount)
+    {
+        _areaDamageHits.AddDefault();
+    }
+
+    Engine::Get().GetThreadPool().ParallelFor(requestCount, _requestsPerBatch, [this](uint32 begin, uint32 end)
+    {
+        for (uint32 requestIndex = begin; requestIndex < end; ++requestIndex)
+        {
+            const AreaDamageRequest& areaRequest = _areaDamageRequests[requestIndex];
+            const float radiusSquared = Math::Square(areaRequest.Radius);
+            const Vector3 extent(areaRequest.Radius);
+
+            DArray<uint32>& hits = _areaDamageHits[requestIndex];
+            hits.Clear();
+
+            _targetGrid.ForEachItemAt(BoundingBox(areaRequest.Center - extent, areaRequest.Center + extent), [this, &areaRequest, radiusSquared, &hits](uint32 target)
+            {
+                const bool isSpared = areaRequest.SparedTeamID != CTeamMember::NoTeam && _targetTeamIDs[target] == areaRequest.SparedTeamID;
+                if (!isSpared && Vector3::DistanceSquared(_targetLocations[target], areaRequest.Center) <= radiusSquared)
+                {
+                    hits.Add(target);
+                }
+
+                return true;
+            });
+        }
+    });
+
+    // Summed in request order so the result doesn't depend on how requests were split between threads
+    for (uint32 requestIndex = 0; requestIndex < requestCount; ++requestIndex)
+    {
+        for (const uint32 target : _areaDamageHits[requestIndex])
+        {
+            AddDamage(*_targets[target], *_targetHealths[target], _areaDamageRequests[requestIndex].Damage);
         }
     }
 }
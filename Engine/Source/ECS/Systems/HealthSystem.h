@@ -1,7 +1,10 @@
 ﻿#pragma once
 
 #include "ECS/Systems/System.h"
+#include "Containers/LockFreeQueue.h"
+#include "Containers/Spatialization/SpatialHashGrid3D.h"
 #include "ECS/Components/CHealth.h"
+#include "ECS/Components/CTeamMember.h"
 #include "HealthSystem.reflection.h"
 
 REFLECTED()
@@ -14,12 +17,60 @@ public:
     HealthSystem(const HealthSystem& other);
     
     void DamageEntity(Entity& entity, const Archetype& archetype, float damage);
+
+    /**
+     * Damages every entity with CHealth and CTransform within radius of center, except members of sparedTeamID.
+     * Requests are collected and resolved together on the next tick, safe to call from other systems while they run.
+     */
+    void DamageArea(const Vector3& center, float radius, float damage, uint32 sparedTeamID = CTeamMember::NoTeam);
     
     // System
 public:
+    virtual void Initialize() override;
     virtual void Tick(double deltaTime) override;
 
+private:
+    struct AreaDamageRequest
+    {
+        Vector3 Center;
+        float Radius = 0.0f;
+        float Damage = 0.0f;
+        uint32 SparedTeamID = CTeamMember::NoTeam;
+    };
+
+    // Damage summed over all requests of a tick, applied once per entity
+    struct DamagedEntity
+    {
+        Entity* Target = nullptr;
+        CHealth* Health = nullptr;
+        float Damage = 0.0f;
+    };
+
 private:
     PROPERTY()
     Event<TypeSet<>, float /*Damage*/> _onEntityDamaged;
+
+    LockFreeQueue<AreaDamageRequest> _areaDamageQueue;
+    DArray<AreaDamageRequest> _areaDamageRequests;
+    // Targets hit by each area request, filled in parallel
+    DArray<DArray<uint32>> _areaDamageHits;
+
+    // Entities that can take area damage, indexed by the grid
+    ECSQuery _targetQuery;
+    DArray<Entity*> _targets;
+    DArray<CHealth*> _targetHealths;
+    DArray<Vector3> _targetLocations;
+    DArray<uint32> _targetTeamIDs;
+    SpatialHashGrid3D _targetGrid;
+
+    DArray<DamagedEntity> _damagedEntities;
+    std::unordered_map<const Entity*, uint32> _damagedEntityIndices;
+    DArray<Entity*> _killedEntities;
+
+    static constexpr float _targetCellSize = 5.0f;
+    static constexpr uint32 _requestsPerBatch = 8;
+
+private:
+    void AddDamage(Entity& entity, CHealth& health, float damage);
+    void ResolveAreaDamage();
 };
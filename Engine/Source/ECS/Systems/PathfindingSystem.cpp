@@ -1,7 +1,44 @@
 ﻿#include "ECS/Systems/PathfindingSystem.h"
 #include "ECS/EntityList.h"
+#include "ECS/World.h"
+#include "Engine/Engine.h"
+#include "Level.h"
 #include "Math/Math.h"
 
+void PathfindingSystem::SetTraversalCost(const BoundingBox& area, uint8 cost)
+{
+    _grid.SetCost(area, cost);
+}
+
+const NavigationGrid& PathfindingSystem::GetNavigationGrid() const
+{
+    return _grid;
+}
+
+const PathService& PathfindingSystem::GetPathService() const
+{
+    return _pathService;
+}
+
+void PathfindingSystem::Initialize()
+{
+    System::Initialize();
+
+    SetSimulationLODBuckets(std::numeric_limits<uint32>::max());
+
+    _grid.Initialize(World::WorldBounds, _cellSize);
+    _navigationVersion = _grid.GetVersion();
+
+    for (uint32 i = 0; i < _maxCachedFlowFields; ++i)
+    {
+        _flowFields.AddDefault();
+    }
+
+    // Clusters of the abstract graph match level chunks
+    _pathService.Initialize(_grid, static_cast<uint32>(Level::ChunkDimension / _cellSize));
+    _crowdAvoidance.Initialize(World::WorldBounds, _avoidanceNeighborDistance);
+}
+
 void PathfindingSystem::OnEntityCreated(const Archetype& archetype, Entity& entity)
 {
     CPathfinding& pathfinding = entity.Get<CPathfinding>(archetype);
@@ -10,27 +47,283 @@ void PathfindingSystem::OnEntityCreated(const Archetype& archetype, Entity& enti
     pathfinding.Destination = transform.ComponentTransform.GetWorldLocation() + Math::RandomUnitVector() * Math::Random(0.0f, 10.0f);
 }
 
+void PathfindingSystem::Tick(double deltaTime)
+{
+    ++_tickIndex;
+
+    if (_navigationVersion != _grid.GetVersion())
+    {
+        for (CachedFlowField& flowField : _flowFields)
+        {
+            flowField.IsValid = false;
+        }
+
+        _flowFieldSlots.clear();
+        _pathService.Rebuild();
+        _navigationVersion = _grid.GetVersion();
+    }
+
+    // Entity lists only request fields and paths for their agents, missing fields are built and queued paths are
+    // searched together before any agent moves
+    System::Tick(deltaTime);
+
+    BuildRequestedFlowFields();
+    _pathService.Process(_pathBudgetMilliseconds);
+
+    // Preferred velocities of all agents are known before avoidance runs, agents move once all of them are solved
+    _crowdAvoidance.Clear();
+    _agentSteps.Clear();
+    for (EntityList* entityList : GetQuery().GetEntityLists())
+    {
+        CacheArchetype(entityList->GetArchetype());
+        SteerAgents(*entityList, deltaTime);
+    }
+
+    _crowdAvoidance.Solve(static_cast<float>(deltaTime));
+
+    uint32 agentIndex = 0;
+    for (EntityList* entityList : GetQuery().GetEntityLists())
+    {
+        CacheArchetype(entityList->GetArchetype());
+        MoveAgents(*entityList, agentIndex);
+    }
+}
+
 void PathfindingSystem::ProcessEntityList(EntityList& entityList, double deltaTime)
 {
     System::ProcessEntityList(entityList, deltaTime);
 
-    entityList.ForEach([this, deltaTime](Entity& entity)
+    const uint16 pathBufferIndex = entityList.GetArchetype().GetComponentIndexChecked<CPathBuffer>();
+    const bool hasPathBuffer = pathBufferIndex != std::numeric_limits<uint16>::max();
+
+    entityList.ForEach([this, pathBufferIndex, hasPathBuffer](Entity& entity)
     {
         const CPathfinding& pathfinding = Get<const CPathfinding>(entity);
-        CTransform& transform = Get<CTransform>(entity);
+        const Vector3 location = Get<const CTransform>(entity).ComponentTransform.GetWorldLocation();
 
-        if (Vector3::Distance(transform.ComponentTransform.GetWorldLocation(), pathfinding.Destination) < 0.75f)
+        if (Vector3::Distance(location, pathfinding.Destination) < _arrivalDistance)
         {
             return true;
         }
 
-        Vector3 direction = pathfinding.Destination - transform.ComponentTransform.GetWorldLocation();
-        direction.Normalize();
+        if (hasPathBuffer)
+        {
+            RequestPath(entity.GetID(), entity.Get<CPathBuffer>(pathBufferIndex), location, pathfinding.Destination);
+        }
+        else
+        {
+            RequestFlowField(_grid.GetCell(pathfinding.Destination));
+        }
+
+        return true;
+    });
+}
+
+void PathfindingSystem::OnEntityDestroyed(const Archetype& archetype, Entity& entity)
+{
+    System::OnEntityDestroyed(archetype, entity);
+
+    _pathService.Cancel(entity.GetID());
+}
+
+void PathfindingSystem::RequestFlowField(uint32 goalCell)
+{
+    const auto it = _flowFieldSlots.find(goalCell);
+    if (it != _flowFieldSlots.end())
+    {
+        _flowFields[it->second].LastUsedTick = _tickIndex;
+        return;
+    }
+
+    if (_requestedGoals.Count() < _maxFlowFieldBuildsPerTick && !_requestedGoals.Contains(goalCell))
+    {
+        _requestedGoals.Add(goalCell);
+    }
+}
+
+void PathfindingSystem::BuildRequestedFlowFields()
+{
+    DArray<uint32> slots;
+    for (const uint32 goalCell : _requestedGoals)
+    {
+        // Fields used in this tick are never replaced, so a tick with many goals can leave some of them without one
+        uint32 slot = _maxCachedFlowFields;
+        for (uint32 i = 0; i < _maxCachedFlowFields; ++i)
+        {
+            const CachedFlowField& flowField = _flowFields[i];
+            if (!flowField.IsValid)
+            {
+                slot = i;
+                break;
+            }
+
+            if (flowField.LastUsedTick != _tickIndex && (slot == _maxCachedFlowFields || flowField.LastUsedTick < _flowFields[slot].LastUsedTick))
+            {
+                slot = i;
+            }
+        }
+
+        if (slot == _maxCachedFlowFields)
+        {
+            break;
+        }
+
+        CachedFlowField& flowField = _flowFields[slot];
+        if (flowField.IsValid)
+        {
+            _flowFieldSlots.erase(flowField.GoalCell);
+        }
+
+        flowField.GoalCell = goalCell;
+        flowField.LastUsedTick = _tickIndex;
+        flowField.IsValid = true;
+
+        _flowFieldSlots[goalCell] = slot;
+        slots.Add(slot);
+    }
 
+    _requestedGoals.Clear();
+
+    Engine::Get().GetThreadPool().ParallelFor(static_cast<uint32>(slots.Count()), 1, [this, &slots](uint32 begin, uint32 end)
+    {
+        for (uint32 i = begin; i < end; ++i)
+        {
+            CachedFlowField& flowField = _flowFields[slots[i]];
+            flowField.Field.Build(_grid, flowField.GoalCell);
+        }
+    });
+}
+
+const FlowField* PathfindingSystem::FindFlowField(uint32 goalCell) const
+{
+    const auto it = _flowFieldSlots.find(goalCell);
+    return it != _flowFieldSlots.end() ? &_flowFields[it->second].Field : nullptr;
+}
+
+void PathfindingSystem::RequestPath(uint64 entityID, CPathBuffer& pathBuffer, const Vector3& location, const Vector3& destination)
+{
+    if (pathBuffer.IsPending)
+    {
+        return;
+    }
+
+    // Failed paths are only retried once the destination or the costs change
+    if (pathBuffer.NavigationVersion == _grid.GetVersion() && Vector3::Distance(pathBuffer.PathDestination, destination) <= _repathDistance)
+    {
+        return;
+    }
+
+    _pathService.Submit(entityID, location, destination);
+
+    pathBuffer.PathDestination = destination;
+    pathBuffer.NavigationVersion = _grid.GetVersion();
+    pathBuffer.IsPending = true;
+}
+
+void PathfindingSystem::SteerAgents(EntityList& entityList, double deltaTime)
+{
+    const uint16 pathBufferIndex = entityList.GetArchetype().GetComponentIndexChecked<CPathBuffer>();
+    const bool hasPathBuffer = pathBufferIndex != std::numeric_limits<uint16>::max();
+
+    entityList.ForEach([this, deltaTime, pathBufferIndex, hasPathBuffer](Entity& entity)
+    {
+        AgentStep& step = _agentSteps.AddDefault();
+
+        double agentDeltaTime = 0.0;
+        if (!ShouldSimulate(entity, deltaTime, agentDeltaTime))
+        {
+            return true;
+        }
+
+        step.DeltaTime = static_cast<float>(agentDeltaTime);
+        step.IsSimulated = true;
+
+        CPathfinding& pathfinding = Get<CPathfinding>(entity);
+        const Vector3 currentLocation = Get<const CTransform>(entity).ComponentTransform.GetWorldLocation();
+
+        // Agents that arrived still take part in avoidance, so others can push past them
+        Vector3 direction = Vector3::Zero;
+        if (Vector3::Distance(currentLocation, pathfinding.Destination) >= _arrivalDistance)
+        {
+            if (hasPathBuffer)
+            {
+                direction = FollowPath(entity.GetID(), entity.Get<CPathBuffer>(pathBufferIndex), currentLocation, pathfinding.Destination);
+            }
+            else
+            {
+                // Agents follow the field of their destination cell until they reach that cell
+                const uint32 goalCell = _grid.GetCell(pathfinding.Destination);
+                const uint32 agentCell = _grid.GetCell(currentLocation);
+                const FlowField* flowField = FindFlowField(goalCell);
+                if (flowField != nullptr && agentCell != goalCell && flowField->IsReachable(agentCell))
+                {
+                    const Vector2 flowDirection = flowField->GetDirection(agentCell);
+                    direction = Vector3(flowDirection.x, flowDirection.y, 0.0f);
+                }
+            }
+
+            // Agents without a field or path walk straight to the destination
+            if (direction == Vector3::Zero)
+            {
+                direction = pathfinding.Destination - currentLocation;
+            }
+
+            direction.Normalize();
+        }
+
+        pathfinding.PreferredVelocity = direction * pathfinding.Speed;
+
+        // Agents in far buckets skip avoidance and move with their preferred velocity
+        step.AvoidanceAgent = NoAvoidanceAgent;
+        if (GetSimulationLODBucket(entity) == 0)
+        {
+            step.AvoidanceAgent = _crowdAvoidance.AddAgent(
+                Vector2(currentLocation.x, currentLocation.y),
+                Vector2(pathfinding.Velocity.x, pathfinding.Velocity.y),
+                Vector2(pathfinding.PreferredVelocity.x, pathfinding.PreferredVelocity.y),
+                pathfinding.AvoidanceRadius,
+                pathfinding.Speed
+            );
+        }
+
+        return true;
+    });
+}
+
+void PathfindingSystem::MoveAgents(EntityList& entityList, uint32& agentIndex)
+{
+    entityList.ForEach([this, &agentIndex](Entity& entity)
+    {
+        const AgentStep& step = _agentSteps[agentIndex++];
+        if (!step.IsSimulated)
+        {
+            return true;
+        }
+
+        CPathfinding& pathfinding = Get<CPathfinding>(entity);
+        pathfinding.Velocity = pathfinding.PreferredVelocity;
+
+        // Avoidance only changes the velocity in the XY plane
+        if (step.AvoidanceAgent != NoAvoidanceAgent)
+        {
+            const Vector2 velocity = _crowdAvoidance.GetVelocity(step.AvoidanceAgent);
+            pathfinding.Velocity = Vector3(velocity.x, velocity.y, pathfinding.PreferredVelocity.z);
+        }
+
+        if (pathfinding.Velocity.LengthSquared() < _minMoveSpeed * _minMoveSpeed)
+        {
+            pathfinding.Velocity = Vector3::Zero;
+            return true;
+        }
+
+        CTransform& transform = Get<CTransform>(entity);
         const Vector3 currentLocation = transform.ComponentTransform.GetWorldLocation();
-        const Vector3 newLocation = currentLocation + direction * pathfinding.Speed * static_cast<float>(deltaTime);
+        const Vector3 newLocation = currentLocation + pathfinding.Velocity * step.DeltaTime;
         transform.ComponentTransform.SetWorldLocation(newLocation);
 
+        Vector3 direction = pathfinding.Velocity;
+        direction.Normalize();
+
         Vector3 euler = transform.ComponentTransform.GetWorldRotation().ToEuler();
         euler.z = atan2f(direction.y, direction.x);
 
@@ -42,3 +335,31 @@ void PathfindingSystem::ProcessEntityList(EntityList& entityList, double deltaTi
         return true;
     });
 }
+
+Vector3 PathfindingSystem::FollowPath(uint64 entityID, CPathBuffer& pathBuffer, const Vector3& location, const Vector3& destination)
+{
+    // Agent keeps following its previous path while a new one is pending
+    PathResult result;
+    if (pathBuffer.IsPending && _pathService.TakeResult(entityID, result))
+    {
+        pathBuffer.Waypoints = std::move(result.Waypoints);
+        pathBuffer.NextWaypoint = 0;
+        pathBuffer.IsPathFound = result.IsFound;
+        pathBuffer.IsPending = false;
+    }
+
+    const uint32 waypointCount = static_cast<uint32>(pathBuffer.Waypoints.Count());
+    if (waypointCount == 0)
+    {
+        return Vector3::Zero;
+    }
+
+    while (pathBuffer.NextWaypoint + 1 < waypointCount && Vector3::Distance(location, pathBuffer.Waypoints[pathBuffer.NextWaypoint]) < _waypointReachedDistance)
+    {
+        ++pathBuffer.NextWaypoint;
+    }
+
+    // Last waypoint is where the destination was when the path was requested, the agent heads to where it is now
+    const bool isLastWaypoint = pathBuffer.NextWaypoint + 1 >= waypointCount;
+    return (isLastWaypoint ? destination : pathBuffer.Waypoints[pathBuffer.NextWaypoint]) - location;
+}
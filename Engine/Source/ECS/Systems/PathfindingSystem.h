@@ -1,12 +1,96 @@
 ﻿#pragma once
 
 #include "System.h"
+#include "Containers/DArray.h"
+#include "ECS/Components/CPathBuffer.h"
 #include "ECS/Components/CPathfinding.h"
 #include "ECS/Components/CTransform.h"
+#include "Navigation/CrowdAvoidance.h"
+#include "Navigation/FlowField.h"
+#include "Navigation/NavigationGrid.h"
+#include "Navigation/PathService.h"
+#include <unordered_map>
 
+/**
+ * Moves agents towards their destinations. Agents with CPathBuffer follow routes from a hierarchical path service,
+ * other agents sample flow fields shared by everyone heading to the same cell. Velocities are then adjusted so nearby
+ * agents don't run into each other before anyone moves.
+ * Agents far from relevance sources are moved less often and don't avoid each other, see SimulationLOD.
+ */
 class PathfindingSystem : public System<CTransform, CPathfinding>
 {
+public:
+    /**
+     * Sets traversal cost of area for all agents. Cached flow fields are rebuilt when they are next used and agents
+     * with a path buffer request new paths.
+     */
+    void SetTraversalCost(const BoundingBox& area, uint8 cost);
+    const NavigationGrid& GetNavigationGrid() const;
+    const PathService& GetPathService() const;
+
 protected:
+    virtual void Initialize() override;
     virtual void OnEntityCreated(const Archetype& archetype, Entity& entity) override;
+    virtual void Tick(double deltaTime) override;
     virtual void ProcessEntityList(EntityList& entityList, double deltaTime) override;
+    virtual void OnEntityDestroyed(const Archetype& archetype, Entity& entity) override;
+
+private:
+    struct CachedFlowField
+    {
+        FlowField Field;
+        uint32 GoalCell = 0;
+        uint64 LastUsedTick = 0;
+        bool IsValid = false;
+    };
+
+    // How each agent moves in the current tick, in the order agents are steered
+    struct AgentStep
+    {
+        float DeltaTime = 0.0f;
+        uint32 AvoidanceAgent = 0;
+        bool IsSimulated = false;
+    };
+
+    static constexpr uint32 NoAvoidanceAgent = std::numeric_limits<uint32>::max();
+
+    static constexpr float _cellSize = 1.0f;
+    static constexpr uint32 _maxCachedFlowFields = 32;
+    // Fields missing from the cache are built in parallel, goals beyond this wait for the next tick
+    static constexpr uint32 _maxFlowFieldBuildsPerTick = 8;
+    // Agents closer to their destination than this stop
+    static constexpr float _arrivalDistance = 0.75f;
+    // Agents with a path buffer request a new path once their destination moves this far from the path's end
+    static constexpr float _repathDistance = 2.0f;
+    static constexpr float _waypointReachedDistance = 0.5f;
+    static constexpr double _pathBudgetMilliseconds = 1.0;
+    static constexpr float _avoidanceNeighborDistance = 3.0f;
+    // Agents slower than this after avoidance stay in place instead of jittering
+    static constexpr float _minMoveSpeed = 0.05f;
+
+    NavigationGrid _grid;
+    uint32 _navigationVersion = 0;
+
+    // Least recently used field is replaced when a new goal needs a slot
+    DArray<CachedFlowField> _flowFields;
+    std::unordered_map<uint32, uint32> _flowFieldSlots;
+    DArray<uint32> _requestedGoals;
+    uint64 _tickIndex = 0;
+
+    PathService _pathService;
+    CrowdAvoidance _crowdAvoidance;
+    DArray<AgentStep> _agentSteps;
+
+private:
+    void RequestFlowField(uint32 goalCell);
+    void BuildRequestedFlowFields();
+    const FlowField* FindFlowField(uint32 goalCell) const;
+    void RequestPath(uint64 entityID, CPathBuffer& pathBuffer, const Vector3& location, const Vector3& destination);
+    void SteerAgents(EntityList& entityList, double deltaTime);
+    void MoveAgents(EntityList& entityList, uint32& agentIndex);
+
+    /**
+     * Returns direction towards the next waypoint of pathBuffer, or zero if the agent has no path to follow.
+     */
+    Vector3 FollowPath(uint64 entityID, CPathBuffer& pathBuffer, const Vector3& location, const Vector3& destination);
 };
@@ -1,6 +1,11 @@
 ﻿#include "PhysicsSystem.h"
 #include "ECS/Components/CStaticMesh.h"
+#include "Engine/Engine.h"
+#include "FNV1a.h"
+#include "Math/Float4.h"
 #include "Math/Math.h"
+#include <algorithm>
+#include <bit>
 #include <queue>
 
 PhysicsSystem::PhysicsSystem(const PhysicsSystem& other) : System(other)
@@ -15,119 +20,334 @@ PhysicsSystem::Hit PhysicsSystem::Raycast(const Vector3& start, const Vector3& d
 
 PhysicsSystem::Hit PhysicsSystem::Raycast(const Vector3& start, const Vector3& end) const
 {
-    const int32 stepX = Math::Sign(end.x - start.x);
-    const int32 stepY = Math::Sign(end.y - start.y);
-    const int32 stepZ = Math::Sign(end.z - start.z);
-    
-    CellIndex currentIndex = GetCellIndex(start);
-    auto [justOutX, justOutY, justOutZ] = GetCellIndex(end);
-    justOutX += stepX;
-    justOutY += stepY;
-    justOutZ += stepZ;
+    return Raycast(start, end, QueryFilter());
+}
 
-    Vector3 direction = end - start;
-    direction.Normalize();
-    
-    Vector3 delta;
-    const Vector3 projX = (Vector3::UnitX * _cellSize.x).Dot(direction) * direction;
-    delta.x = projX.x;
+PhysicsSystem::Hit PhysicsSystem::Raycast(const Vector3& start, const Vector3& end, const QueryFilter& filter) const
+{
+    CastScratch scratch;
+    return Cast({start, end}, 0.0f, filter, scratch);
+}
 
-    const Vector3 projY = (Vector3::UnitY * _cellSize.y).Dot(direction) * direction;
-    delta.y = projY.y;
+void PhysicsSystem::RaycastBatch(std::span<const Line> rays, std::span<Hit> outHits, const QueryFilter& filter) const
+{
+    assert(outHits.size() >= rays.size());
 
-    const Vector3 projZ = (Vector3::UnitZ * _cellSize.z).Dot(direction) * direction;
-    delta.z = projZ.z;
-    
-    delta = Math::Abs(_cellSize * _cellSize / delta);
+    Engine::Get().GetThreadPool().ParallelFor(static_cast<uint32>(rays.size()), _queriesPerBatch, [this, rays, outHits, &filter](uint32 begin, uint32 end)
+    {
+        CastScratch scratch;
+        for (uint32 i = begin; i < end; ++i)
+        {
+            outHits[i] = Cast(rays[i], 0.0f, filter, scratch);
+        }
+    });
+}
 
-    float tMaxX = Math::RoundToNearest(start.x, delta.x) - start.x;
-    float tMaxY = Math::RoundToNearest(start.y, delta.y) - start.y;
-    float tMaxZ = Math::RoundToNearest(start.z, delta.z) - start.z;
-    
-    const Line line = {start, end};
-    
-    while (true)
+void PhysicsSystem::SphereCastBatch(std::span<const SphereCastQuery> casts, std::span<Hit> outHits, const QueryFilter& filter) const
+{
+    assert(outHits.size() >= casts.size());
+
+    Engine::Get().GetThreadPool().ParallelFor(static_cast<uint32>(casts.size()), _queriesPerBatch, [this, casts, outHits, &filter](uint32 begin, uint32 end)
     {
-        if (tMaxX < tMaxY)
+        CastScratch scratch;
+        for (uint32 i = begin; i < end; ++i)
         {
-            if (tMaxX < tMaxZ)
-            {
-                currentIndex.X += stepX;
-                if (currentIndex.X == justOutX)
-                {
-                    break;
-                }
-                tMaxX += delta.x;
-            }
-            else
-            {
-                currentIndex.Z += stepZ;
-                if (currentIndex.Z == justOutZ)
-                {
-                    break;
-                }
-                tMaxZ += delta.z;
-            }
+            const SphereCastQuery& cast = casts[i];
+            outHits[i] = Cast({cast.Start, cast.End}, Math::Max(cast.Radius, 0.0f), filter, scratch);
         }
-        else
+    });
+}
+
+void PhysicsSystem::SetSimulationEnabled(bool value)
+{
+    _simulatePhysics = value;
+}
+
+bool PhysicsSystem::IsSimulationEnabled() const
+{
+    return _simulatePhysics;
+}
+
+void PhysicsSystem::SetSolverIterations(uint32 velocityIterations, uint32 positionIterations)
+{
+    _velocityIterations = velocityIterations;
+    _positionIterations = positionIterations;
+}
+
+uint32 PhysicsSystem::GetVelocityIterations() const
+{
+    return _velocityIterations;
+}
+
+uint32 PhysicsSystem::GetPositionIterations() const
+{
+    return _positionIterations;
+}
+
+void PhysicsSystem::SetDeterministic(bool value)
+{
+    _isDeterministic = value;
+    _fixedStepRemainder = 0.0;
+    _stepHashes.Clear();
+}
+
+bool PhysicsSystem::IsDeterministic() const
+{
+    return _isDeterministic;
+}
+
+std::span<const uint64> PhysicsSystem::GetStepHashes() const
+{
+    return {_stepHashes.GetData(), _stepHashes.Count()};
+}
+
+uint64 PhysicsSystem::GetStepCount() const
+{
+    return _stepCount;
+}
+
+uint64 PhysicsSystem::ComputeStateHash() const
+{
+    DArray<const Body*> bodies;
+    for (const Body* body : _bodies)
+    {
+        if (body != nullptr)
         {
-            if (tMaxY < tMaxZ)
-            {
-                currentIndex.Y += stepY;
-                if (currentIndex.Y == justOutY)
-                {
-                    break;
-                }
-                tMaxY += delta.y;
-            }
-            else
-            {
-                currentIndex.Z += stepZ;
-                if (currentIndex.Z == justOutZ)
-                {
-                    break;
-                }
-                tMaxZ += delta.z;
-            }
+            bodies.Add(body);
         }
-        
-        const Cell* currentCell = GetCellAtIfExistsImplementation(currentIndex);
-        if (currentCell == nullptr)
+    }
+
+    std::sort(bodies.GetData(), bodies.GetData() + bodies.Count(), [](const Body* a, const Body* b)
+    {
+        return a->Entity->GetID() < b->Entity->GetID();
+    });
+
+    // Floats are hashed by their bits, so results that differ only in the last bit produce different hashes
+    FNV1a hash;
+    const auto combineFloats = [&hash](float a, float b)
+    {
+        hash.Combine(static_cast<uint64>(std::bit_cast<uint32>(a)) << 32 | std::bit_cast<uint32>(b));
+    };
+
+    for (const Body* body : bodies)
+    {
+        const Transform& transform = body->GetTransform().ComponentTransform;
+        const CRigidBody& rigidBody = body->GetRigidBody();
+
+        const Vector3 location = transform.GetWorldLocation();
+        const Quaternion rotation = transform.GetWorldRotation();
+
+        hash.Combine(body->Entity->GetID());
+        hash.Combine(static_cast<uint64>(rigidBody.State));
+        combineFloats(location.x, location.y);
+        combineFloats(location.z, rotation.x);
+        combineFloats(rotation.y, rotation.z);
+        combineFloats(rotation.w, rigidBody.Velocity.x);
+        combineFloats(rigidBody.Velocity.y, rigidBody.Velocity.z);
+        combineFloats(rigidBody.AngularVelocity.x, rigidBody.AngularVelocity.y);
+        combineFloats(rigidBody.AngularVelocity.z, 0.0f);
+    }
+
+    return hash.GetHash();
+}
+
+void PhysicsSystem::SaveSnapshot(PhysicsSnapshot& outSnapshot) const
+{
+    outSnapshot.Clear();
+
+    for (const Body* body : _bodies)
+    {
+        if (body == nullptr)
         {
             continue;
         }
-        
-        for (const Body* body : currentCell->Bodies)
+
+        const Transform& transform = body->GetTransform().ComponentTransform;
+        const CRigidBody& rigidBody = body->GetRigidBody();
+
+        outSnapshot.BodyIndices.Add(body->BodyIndex);
+        outSnapshot.EntityIDs.Add(body->Entity->GetID());
+        outSnapshot.Locations.Add(transform.GetWorldLocation());
+        outSnapshot.Rotations.Add(transform.GetWorldRotation());
+        outSnapshot.Velocities.Add(rigidBody.Velocity);
+        outSnapshot.AngularVelocities.Add(rigidBody.AngularVelocity);
+        outSnapshot.AABBs.Add(body->AABB);
+        outSnapshot.States.Add(rigidBody.State);
+        outSnapshot.StepsAtRest.Add(body->StepsAtRest);
+        outSnapshot.SleepingIslandIDs.Add(body->SleepingIslandID);
+    }
+
+    for (const auto& [key, manifold] : _manifolds)
+    {
+        outSnapshot.ManifoldKeys.Add(key);
+        outSnapshot.Manifolds.Add(manifold);
+    }
+
+    outSnapshot.SleepingIslandIDGenerator = _sleepingIslandIDGenerator;
+    outSnapshot.StepCount = _stepCount;
+    outSnapshot.FixedStepRemainder = _fixedStepRemainder;
+}
+
+bool PhysicsSystem::RestoreSnapshot(const PhysicsSnapshot& snapshot)
+{
+    bool isComplete = true;
+    _sleepingIslands.clear();
+
+    // Bodies whose entity is still the one in the snapshot, only these get their state and manifolds back
+    DArray<bool> isRestored;
+    isRestored.Reserve(_bodies.Count());
+    for (uint32 i = 0; i < _bodies.Count(); ++i)
+    {
+        isRestored.Add(false);
+    }
+
+    for (uint32 i = 0; i < snapshot.GetBodyCount(); ++i)
+    {
+        const uint32 bodyIndex = snapshot.BodyIndices[i];
+        Body* body = bodyIndex < _bodies.Count() ? _bodies[bodyIndex] : nullptr;
+        if (body == nullptr || body->Entity->GetID() != snapshot.EntityIDs[i])
         {
-            if (body->AABB.Overlap(line))
-            {
-                const Hit hit = CollisionCheck(line, *body);
-                if (hit.IsValid)
-                {
-                    return hit;
-                }
-            }
-        } 
+            isComplete = false;
+            continue;
+        }
+
+        Transform& transform = body->GetTransform().ComponentTransform;
+        transform.SetWorldLocation(snapshot.Locations[i]);
+        transform.SetWorldRotation(snapshot.Rotations[i]);
+
+        CRigidBody& rigidBody = body->GetRigidBody();
+        rigidBody.Velocity = snapshot.Velocities[i];
+        rigidBody.AngularVelocity = snapshot.AngularVelocities[i];
+        rigidBody.State = snapshot.States[i];
+
+        body->AABB = snapshot.AABBs[i];
+        body->StepsAtRest = snapshot.StepsAtRest[i];
+        body->SleepingIslandID = snapshot.SleepingIslandIDs[i];
+        UpdateBodyTransform(*body);
+        isRestored[bodyIndex] = true;
+
+        if (body->SleepingIslandID != 0)
+        {
+            _sleepingIslands[body->SleepingIslandID].Add(body);
+        }
+
+        // Moved items keep their place in the tree if they stay within their fat bounds
+        _broadPhase->Move(bodyIndex, body->AABB);
+    }
+
+    // Islands of the snapshot are rebuilt from restored bodies only, bodies created since then would keep IDs of
+    // islands that no longer exist
+    for (uint32 bodyIndex = 0; bodyIndex < _bodies.Count(); ++bodyIndex)
+    {
+        Body* body = _bodies[bodyIndex];
+        if (body != nullptr && !isRestored[bodyIndex])
+        {
+            body->SleepingIslandID = 0;
+            WakeBody(*body);
+        }
     }
 
-    return {};
+    // Manifolds of pairs whose bodies no longer exist are dropped, the key holds body indices of the pair
+    _manifolds.clear();
+    for (uint32 i = 0; i < snapshot.Manifolds.Count(); ++i)
+    {
+        const uint64 key = snapshot.ManifoldKeys[i];
+        const ContactManifold& manifold = snapshot.Manifolds[i];
+
+        const uint32 bodyIndexA = static_cast<uint32>(key >> 32);
+        const uint32 bodyIndexB = static_cast<uint32>(key);
+        if (bodyIndexA >= _bodies.Count() || bodyIndexB >= _bodies.Count() || !isRestored[bodyIndexA] || !isRestored[bodyIndexB])
+        {
+            continue;
+        }
+
+        const Body* bodyA = _bodies[bodyIndexA];
+        const Body* bodyB = _bodies[bodyIndexB];
+
+        if (manifold.BelongsTo(*bodyA, *bodyB) || manifold.BelongsTo(*bodyB, *bodyA))
+        {
+            _manifolds.emplace(key, manifold);
+        }
+    }
+
+    _sleepingIslandIDGenerator = snapshot.SleepingIslandIDGenerator;
+    _stepCount = snapshot.StepCount;
+    _fixedStepRemainder = snapshot.FixedStepRemainder;
+
+    _broadPhase->Commit();
+
+    return isComplete;
 }
 
-void PhysicsSystem::SetSimulationEnabled(bool value)
+void PhysicsSystem::SetStatsEnabled(bool value)
 {
-    _simulatePhysics = value;
+    _isStatsEnabled = value;
+    _currentStats = PhysicsStepStats();
+    _gjkIterationCount = 0;
+    _epaExpansionCount = 0;
 }
 
-bool PhysicsSystem::IsSimulationEnabled() const
+bool PhysicsSystem::IsStatsEnabled() const
 {
-    return _simulatePhysics;
+    return _isStatsEnabled;
+}
+
+const PhysicsStepStats& PhysicsSystem::GetLastStepStats() const
+{
+    static const PhysicsStepStats emptyStats;
+    if (_statsHistory.IsEmpty())
+    {
+        return emptyStats;
+    }
+
+    return _statsHistory[(_statsHistoryNext + _statsHistorySize - 1) % _statsHistorySize];
+}
+
+void PhysicsSystem::GetStatsHistory(DArray<PhysicsStepStats>& outStats) const
+{
+    outStats.Clear();
+
+    // Until the ring buffer fills up the oldest step is at index 0
+    const uint32 count = static_cast<uint32>(_statsHistory.Count());
+    const uint32 first = count < _statsHistorySize ? 0 : _statsHistoryNext;
+    for (uint32 i = 0; i < count; ++i)
+    {
+        outStats.Add(_statsHistory[(first + i) % count]);
+    }
+}
+
+bool PhysicsSystem::DumpStatsToCSV(const std::filesystem::path& path) const
+{
+    DArray<PhysicsStepStats> stats;
+    GetStatsHistory(stats);
+
+    return PhysicsStepStats::WriteCSV(path, {stats.GetData(), stats.Count()});
+}
+
+void PhysicsSystem::SetBroadPhaseType(EBroadPhaseType type)
+{
+    if (_broadPhaseType == type)
+    {
+        return;
+    }
+
+    _broadPhaseType = type;
+    if (_broadPhase != nullptr)
+    {
+        CreateBroadPhase();
+    }
+}
+
+EBroadPhaseType PhysicsSystem::GetBroadPhaseType() const
+{
+    return _broadPhaseType;
 }
 
 void PhysicsSystem::Initialize()
 {
     System::Initialize();
     
-    _cellSize = (GetWorld().WorldBounds.GetExtent() * 2.0f / _cellCountX);
+    CreateBroadPhase();
     
     _onTransformChangedHandle = GetWorld().OnTransformChanged.RegisterListener(_onTransformChanged);
     _onArchetypeChangedHandle = GetWorld().OnArchetypeChanged.RegisterListener(_onArchetypeChanged);
@@ -161,22 +381,34 @@ void PhysicsSystem::OnEntityCreated(const Archetype& archetype, Entity& entity)
     Body& body = rigidBody.PhysicsBody;
     body.Entity = &entity;
     body.AABB = collider.Bounds.TransformBy(transform.ComponentTransform);
+    UpdateBodyTransform(body);
     body.TransformIndex = transformIndex;
     body.RigidBodyIndex = rigidBodyIndex;
     body.ColliderIndex = colliderIndex;
+    body.CollisionLayer = 1u << static_cast<uint32>(collider.Layer);
+    body.CollisionMask = collider.CollisionMask;
     
-    ERigidBodyState state = rigidBody.State;
-    ForEachCellAt(body.AABB, [&body, state](Cell& cell, uint32 index)
+    if (!_freeBodyIndices.IsEmpty())
     {
-        const uint32 indexInCell = cell.AddBody(body, state);
-        body.IndicesInCells.Add(indexInCell);
+        body.BodyIndex = _freeBodyIndices.Back();
+        _freeBodyIndices.PopBack();
 
-        return true;
-    });
+        _bodies[body.BodyIndex] = &body;
+    }
+    else
+    {
+        body.BodyIndex = static_cast<uint32>(_bodies.Count());
+        _bodies.Add(&body);
+    }
+
+    _broadPhase->Add(body.BodyIndex, body.AABB, static_cast<uint32>(std::countr_zero(body.CollisionLayer)));
 }
 
 void PhysicsSystem::Tick(double deltaTime)
 {
+    // OnHit is only signalled from within Tick
+    OnHit.ReclaimRetiredListeners();
+
     for (auto& entityListStruct : _onArchetypeChanged.GetEntityLists())
     {
         const uint16 rigidBodyIndex = entityListStruct.EntityArchetype.GetComponentIndexChecked<CRigidBody>();
@@ -188,20 +420,12 @@ void PhysicsSystem::Tick(double deltaTime)
         EventArchetypeChanged::EventData eventData;
         while (entityListStruct.Queue.Dequeue(eventData))
         {
-            CRigidBody& oldRigidBody = eventData.Entity->Get<CRigidBody>(rigidBodyIndex);
-            Body& body = oldRigidBody.PhysicsBody;
-
-            ForEachCellAt(body.AABB, [&body, &eventData](Cell& cell, uint32 index)
-            {
-                Entity* newEntity = std::get<Entity*>(eventData.Arguments);
+            Entity* newEntity = std::get<Entity*>(eventData.Arguments);
 
-                Body& newBody = newEntity->Get<CRigidBody>(std::get<Archetype>(eventData.Arguments)).PhysicsBody;
-                newBody.Entity = newEntity;
+            Body& newBody = newEntity->Get<CRigidBody>(std::get<Archetype>(eventData.Arguments)).PhysicsBody;
+            newBody.Entity = newEntity;
 
-                cell.Bodies[body.IndicesInCells[index]] = &newBody;
-
-                return true;
-            });
+            _bodies[newBody.BodyIndex] = &newBody;
         }
     }
     
@@ -223,30 +447,86 @@ void PhysicsSystem::Tick(double deltaTime)
             }
 
             CRigidBody& rigidBody = eventData.Entity->Get<CRigidBody>(rigidBodyIndex);
+            Body& body = rigidBody.PhysicsBody;
 
-            BoundingBox nextAABB = rigidBody.PhysicsBody.AABB;
-            nextAABB.Move(nextAABB.GetCenter() - eventData.Entity->Get<CTransform>(rigidBody.PhysicsBody.TransformIndex).ComponentTransform.GetWorldLocation());
-            
-            Move(rigidBody, rigidBody.PhysicsBody.AABB, nextAABB);
+            body.AABB = body.GetCollider().Bounds.TransformBy(body.GetTransform().ComponentTransform);
+            _broadPhase->Move(body.BodyIndex, body.AABB);
+            UpdateBodyTransform(body);
+
+            if (rigidBody.State == ERigidBodyState::Dormant)
+            {
+                WakeBody(rigidBody.PhysicsBody);
+            }
 
             // todo
             // BroadPhase()
         }
     }
-    
-    constexpr double substepDuration = 1.0f / 120.0f;
 
+    _broadPhase->Commit();
+    
     double remainingTime = deltaTime;
-    while (remainingTime > 0.001f)
+    if (_isDeterministic)
+    {
+        remainingTime += _fixedStepRemainder;
+        _stepHashes.Clear();
+    }
+
+    const double minStepTime = _isDeterministic ? _stepDuration : 0.001;
+    while (remainingTime >= minStepTime)
     {
-        const double substepTime = std::min(remainingTime, substepDuration);
+        const double substepTime = _isDeterministic ? _stepDuration : std::min(remainingTime, _stepDuration);
         remainingTime -= substepTime;
 
+        // System::Tick only gathers awake bodies, the step itself runs as a pipeline of stages, each stage is either
+        // parallel over independent work items or a short serial pass over shared state
         System::Tick(substepTime);
-        
-        NarrowPhase();
+
+        if (_isDeterministic)
+        {
+            SortAwakeBodies();
+        }
+
+        RunStage(EPhysicsStage::Integrate, [this, substepTime]() { Integrate(substepTime); });
+        RunStage(EPhysicsStage::ContinuousCollision, [this]() { ContinuousCollision(); });
+        RunStage(EPhysicsStage::BroadPhase, [this]() { BroadPhase(); });
+        RunStage(EPhysicsStage::NarrowPhase, [this]() { NarrowPhase(); });
+        RunStage(EPhysicsStage::Manifolds, [this]() { UpdateManifolds(); });
+        RunStage(EPhysicsStage::Islands, [this]() { BuildIslands(); });
+        RunStage(EPhysicsStage::Solve, [this]() { Solve(); });
+        RunStage(EPhysicsStage::WriteBack, [this]()
+        {
+            WriteBack();
+            UpdateIslands();
+
+            std::erase_if(_manifolds, [this](const auto& entry)
+            {
+                return entry.second.LastStep != _stepCount;
+            });
+
+            _broadPhase->Commit();
+        });
+
+        if (_isStatsEnabled)
+        {
+            CollectStepStats();
+        }
 
         _narrowPhaseInputPairs.Clear();
+        _narrowPhaseHits.Clear();
+        _pairManifolds.Clear();
+        _awakeBodies.Clear();
+
+        ++_stepCount;
+        if (_isDeterministic)
+        {
+            _stepHashes.Add(ComputeStateHash());
+        }
+    }
+
+    if (_isDeterministic)
+    {
+        _fixedStepRemainder = remainingTime;
     }
 }
 
@@ -259,7 +539,7 @@ void PhysicsSystem::ProcessEntityList(EntityList& entityList, double deltaTime)
         return;
     }
     
-    entityList.ForEach([this, deltaTime](Entity& entity)
+    entityList.ForEach([this](Entity& entity)
     {
         CRigidBody& rigidBody = Get<CRigidBody>(entity);
         if (rigidBody.State != ERigidBodyState::Dynamic)
@@ -267,29 +547,9 @@ void PhysicsSystem::ProcessEntityList(EntityList& entityList, double deltaTime)
             return true;
         }
 
-        const CTransform& transform = Get<CTransform>(entity);
-        
-        const Vector3 force = rigidBody.Mass * _gravity;
-        const Vector3 acceleration = force / rigidBody.Mass;
-        rigidBody.Velocity += acceleration * static_cast<float>(deltaTime);
-        //LOG(L"Velocity after tick: {}", rigidBody.Velocity);
-
-        const Vector3 currentLocation = transform.ComponentTransform.GetWorldLocation();
-        const Vector3 newLocation = currentLocation + rigidBody.Velocity * static_cast<float>(deltaTime);
-
-       //LOG(L"Desired location delta: {}", newLocation - currentLocation);
-
-        if (GetWorld().WorldBounds.Contains(newLocation))
-        {
-            //LOG(L"Location before move: {}", transform.ComponentTransform.GetWorldLocation());
-            Move(rigidBody, currentLocation, newLocation, deltaTime);
-            //LOG(L"Location after move: {}", transform.ComponentTransform.GetWorldLocation());
-        }
-        else
-        {
-            // todo migrate entity to another world
-            GetWorld().DestroyEntityAsync(entity);
-        }
+        Body& body = rigidBody.PhysicsBody;
+        body.IslandIndex = static_cast<uint32>(_awakeBodies.Count());
+        _awakeBodies.Add({&body, body.AABB});
         
         return true;
     });
@@ -301,17 +561,24 @@ void PhysicsSystem::OnEntityDestroyed(const Archetype& archetype, Entity& entity
     
     const CRigidBody& rigidBody = entity.Get<const CRigidBody>(archetype);
 
-    ForEachCellAt(rigidBody.PhysicsBody.AABB, [&rigidBody, this](Cell& cell, uint32 index)
+    if (rigidBody.PhysicsBody.SleepingIslandID != 0)
     {
-        if (!rigidBody.PhysicsBody.IndicesInCells.IsValidIndex(index))
+        const auto it = _sleepingIslands.find(rigidBody.PhysicsBody.SleepingIslandID);
+        if (it != _sleepingIslands.end())
         {
-            return true;
+            it->second.RemoveSwap(const_cast<Body*>(&rigidBody.PhysicsBody));
+            if (it->second.IsEmpty())
+            {
+                _sleepingIslandIDGenerator.FreeID(it->first);
+                _sleepingIslands.erase(it);
+            }
         }
-        
-        cell.RemoveBody(*this, rigidBody.PhysicsBody.IndicesInCells[index]);
+    }
 
-        return true;
-    });
+    // Broad phase may still report the index until the next commit, so queries skip empty slots
+    _broadPhase->Remove(rigidBody.PhysicsBody.BodyIndex);
+    _bodies[rigidBody.PhysicsBody.BodyIndex] = nullptr;
+    _freeBodyIndices.Add(rigidBody.PhysicsBody.BodyIndex);
 }
 
 void PhysicsSystem::Shutdown()
@@ -323,501 +590,1029 @@ void PhysicsSystem::Shutdown()
     world.OnArchetypeChanged.UnregisterListener(_onArchetypeChangedHandle);
 }
 
-uint32 PhysicsSystem::Cell::AddBody(Body& body, ERigidBodyState bodyType)
+void PhysicsSystem::CreateBroadPhase()
 {
-    Bodies.Resize(StaticBodyCount + DormantBodyCount + DynamicBodyCount + 1);
+    switch (_broadPhaseType)
+    {
+        case EBroadPhaseType::UniformGrid:
+        {
+            _broadPhase = std::make_unique<GridBroadPhase>(GetWorld().WorldBounds, _cellCountX);
+            break;
+        }
 
-    uint32 bodyIndex = 0;
-    
-    switch (bodyType)
+        case EBroadPhaseType::DynamicTree:
+        {
+            _broadPhase = std::make_unique<TreeBroadPhase>();
+            break;
+        }
+    }
+
+    for (const Body* body : _bodies)
     {
-        case ERigidBodyState::Static:
+        if (body != nullptr)
         {
-            bodyIndex = StaticBodyCount;
-            
-            const uint32 firstDynamicIndex = StaticBodyCount + DormantBodyCount;
-            const uint32 lastDynamicIndex = firstDynamicIndex + DynamicBodyCount;
+            _broadPhase->Add(body->BodyIndex, body->AABB, static_cast<uint32>(std::countr_zero(body->CollisionLayer)));
+        }
+    }
+
+    _broadPhase->Commit();
+}
+
+template <typename FuncType>
+void PhysicsSystem::RunStage(EPhysicsStage stage, FuncType&& func)
+{
+    if (!_isStatsEnabled)
+    {
+        func();
+        return;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    func();
+
+    const std::chrono::duration<double, std::milli> duration = std::chrono::steady_clock::now() - start;
+    _currentStats.StageMilliseconds[static_cast<uint32>(stage)] = duration.count();
+}
+
+void PhysicsSystem::CollectStepStats()
+{
+    PhysicsStepStats& stats = _currentStats;
+    stats.Step = _stepCount;
+    stats.AwakeBodyCount = static_cast<uint32>(_awakeBodies.Count());
+    stats.BroadPhasePairCount = static_cast<uint32>(_narrowPhaseInputPairs.Count());
+    stats.ContactCount = static_cast<uint32>(_islandContacts.Count());
+    stats.ManifoldCount = static_cast<uint32>(_manifolds.size());
+    stats.IslandCount = _islandContactRanges.IsEmpty() ? 0 : static_cast<uint32>(_islandContactRanges.Count()) - 1;
+    stats.GJKIterationCount = _gjkIterationCount.exchange(0, std::memory_order_relaxed);
+    stats.EPAExpansionCount = _epaExpansionCount.exchange(0, std::memory_order_relaxed);
+
+    for (const AwakeBody& awakeBody : _awakeBodies)
+    {
+        stats.SweptBodyCount += awakeBody.NeedsContinuousCollision ? 1 : 0;
+        stats.TimeOfImpactCount += awakeBody.TimeOfImpact < 1.0f ? 1 : 0;
+    }
+
+    // Pairs are sorted by the first body, so pairs of each awake body are adjacent
+    const Body* currentBody = nullptr;
+    uint32 currentPairCount = 0;
+    for (uint32 i = 0; i < _narrowPhaseInputPairs.Count(); ++i)
+    {
+        const CollisionPair& pair = _narrowPhaseInputPairs[i];
+        stats.BoxPairCount += pair.BodyA->IsBox && pair.BodyB->IsBox ? 1 : 0;
+
+        currentPairCount = pair.BodyA == currentBody ? currentPairCount + 1 : 1;
+        currentBody = pair.BodyA;
+        if (currentPairCount > stats.MostPairsCount)
+        {
+            stats.MostPairsCount = currentPairCount;
+            stats.MostPairsEntityID = currentBody->Entity->GetID();
+        }
+
+        const Hit& hit = _narrowPhaseHits[i];
+        if (hit.IsValid && hit.PenetrationDepth > stats.DeepestPenetration)
+        {
+            stats.DeepestPenetration = hit.PenetrationDepth;
+            stats.DeepestContactEntityID = pair.BodyA->Entity->GetID();
+        }
+    }
+
+    _broadPhase->AddCellOccupancy(stats.CellOccupancy);
+
+    if (_statsHistory.Count() < _statsHistorySize)
+    {
+        _statsHistory.Add(stats);
+    }
+    else
+    {
+        _statsHistory[_statsHistoryNext] = stats;
+    }
+
+    _statsHistoryNext = (_statsHistoryNext + 1) % _statsHistorySize;
+    _currentStats = PhysicsStepStats();
+}
+
+void PhysicsSystem::AddToStat(std::atomic<uint64>& stat, uint32 value) const
+{
+    if (_isStatsEnabled)
+    {
+        stat.fetch_add(value, std::memory_order_relaxed);
+    }
+}
+
+void PhysicsSystem::SortAwakeBodies()
+{
+    // Entity lists are visited in archetype and bucket order, which depends on allocation history
+    AwakeBody* awakeBodies = _awakeBodies.GetData();
+    std::sort(awakeBodies, awakeBodies + _awakeBodies.Count(), [](const AwakeBody& a, const AwakeBody& b)
+    {
+        return a.PhysicsBody->Entity->GetID() < b.PhysicsBody->Entity->GetID();
+    });
+
+    for (uint32 i = 0; i < _awakeBodies.Count(); ++i)
+    {
+        _awakeBodies[i].PhysicsBody->IslandIndex = i;
+    }
+}
+
+void PhysicsSystem::ForEachBodyAt(const BoundingBox& aabb, uint32 layerMask, const std::function<bool(Body& body)>& func) const
+{
+    _broadPhase->ForEachItemAt(aabb, layerMask, [this, &func](uint32 bodyIndex)
+    {
+        Body* body = _bodies[bodyIndex];
+        return body == nullptr || func(*body);
+    });
+}
+
+PhysicsSystem::Hit PhysicsSystem::Cast(const Line& line, float radius, const QueryFilter& filter, CastScratch& scratch) const
+{
+    const Vector3 delta = line.End - line.Start;
+    const float length = delta.Length();
+    const bool isRay = radius == 0.0f;
+
+    Hit closestHit;
+    float closestDistance = std::numeric_limits<float>::max();
+    bool isDone = false;
+
+    scratch.Bodies.Clear();
+    scratch.Boxes.Clear();
+
+    // Boxes, and every shape in sphere casts, are gathered and tested one SIMD batch at a time
+    const auto flushBoxes = [&line, radius, length, &filter, &scratch, &closestHit, &closestDistance, &isDone]()
+    {
+        scratch.Contacts.Clear();
+        for (uint32 i = 0; i < scratch.Boxes.Count(); ++i)
+        {
+            scratch.Contacts.AddDefault();
+        }
+
+        CollisionKernels::RayBox(line, scratch.Boxes.GetData(), static_cast<uint32>(scratch.Boxes.Count()), scratch.Contacts.GetData());
 
-            if (DynamicBodyCount > 0)
+        for (uint32 i = 0; i < scratch.Contacts.Count(); ++i)
+        {
+            const RayContact& contact = scratch.Contacts[i];
+            const float distance = contact.Fraction * length;
+            if (!contact.IsValid || distance >= closestDistance)
             {
-                Body* firstDynamicBody = Bodies[firstDynamicIndex];
-                bodyIndex = lastDynamicIndex;
-                Bodies[lastDynamicIndex] = firstDynamicBody;
+                continue;
             }
 
-            if (DormantBodyCount > 0)
+            closestDistance = distance;
+
+            closestHit.IsValid = true;
+            closestHit.PenetrationDepth = 0.0f;
+            closestHit.OtherBody = scratch.Bodies[i];
+            closestHit.ImpactNormal = contact.Normal;
+            closestHit.Location = Vector3::Lerp(line.Start, line.End, contact.Fraction) - contact.Normal * radius;
+        }
+
+        scratch.Bodies.Clear();
+        scratch.Boxes.Clear();
+
+        isDone = filter.Mode == EQueryMode::Any && closestHit.IsValid;
+    };
+
+    const auto visitBody = [this, &line, radius, isRay, &filter, &scratch, &closestHit, &closestDistance, &isDone, &flushBoxes](uint32 bodyIndex)
+    {
+        Body* body = _bodies[bodyIndex];
+        if (body == nullptr || body->Entity == filter.IgnoredEntity)
+        {
+            return true;
+        }
+
+        if (isRay && !body->IsBox)
+        {
+            if (!body->AABB.Overlap(line))
             {
-                Body* firstDormantBody = Bodies[StaticBodyCount];
-                bodyIndex = firstDynamicIndex;
-                
-                Bodies[firstDynamicIndex] = firstDormantBody;
-                Bodies[StaticBodyCount] = &body;
+                return true;
             }
-            else
+
+            const Hit hit = CollisionCheck(line, *body);
+            if (!hit.IsValid)
             {
-                Bodies[StaticBodyCount] = &body;
+                return true;
             }
-            
-            ++StaticBodyCount;
-            
-            break;
+
+            const float distance = (hit.Location - line.Start).Length();
+            if (distance < closestDistance)
+            {
+                closestDistance = distance;
+                closestHit = hit;
+            }
+
+            isDone = filter.Mode == EQueryMode::Any;
+            return !isDone;
+        }
+
+        OrientedBox& box = scratch.Boxes.Add(body->IsBox ? body->WorldBox : OrientedBox(body->AABB));
+        box.HalfExtents += Vector3(radius);
+        scratch.Bodies.Add(body);
+
+        if (scratch.Boxes.Count() == Float4::LaneCount)
+        {
+            flushBoxes();
         }
 
-        case ERigidBodyState::Dormant:
+        return !isDone;
+    };
+
+    if (isRay)
+    {
+        _broadPhase->ForEachItemAlongLine(line, filter.LayerMask, visitBody);
+    }
+    else
+    {
+        const BoundingBox sweptAABB = BoundingBox(line.Start - Vector3(radius), line.Start + Vector3(radius)).Union(
+            BoundingBox(line.End - Vector3(radius), line.End + Vector3(radius)));
+
+        ForEachBodyAt(sweptAABB, filter.LayerMask, [&sweptAABB, &visitBody](const Body& body)
+        {
+            return !body.AABB.Overlap(sweptAABB) || visitBody(body.BodyIndex);
+        });
+    }
+
+    if (!isDone && !scratch.Boxes.IsEmpty())
+    {
+        flushBoxes();
+    }
+
+    return closestHit;
+}
+
+void PhysicsSystem::Integrate(double deltaTime)
+{
+    const float time = static_cast<float>(deltaTime);
+    const BoundingBox& worldBounds = GetWorld().WorldBounds;
+
+    Engine::Get().GetThreadPool().ParallelFor(static_cast<uint32>(_awakeBodies.Count()), _bodiesPerBatch, [this, time, &worldBounds](uint32 begin, uint32 end)
+    {
+        for (uint32 i = begin; i < end; ++i)
         {
-            const uint32 firstDynamicIndex = StaticBodyCount + DormantBodyCount;
-            const uint32 lastDynamicIndex = firstDynamicIndex + DynamicBodyCount;
+            AwakeBody& awakeBody = _awakeBodies[i];
+            Body& body = *awakeBody.PhysicsBody;
+            CRigidBody& rigidBody = body.GetRigidBody();
 
-            Body* firstDynamicBody = Bodies[firstDynamicIndex];
-            if (DynamicBodyCount > 0)
+            const Vector3 force = rigidBody.Mass * _gravity;
+            const Vector3 acceleration = force / rigidBody.Mass;
+            rigidBody.Velocity += acceleration * time;
+
+            Transform& transform = body.GetTransform().ComponentTransform;
+
+            const Vector3 currentLocation = transform.GetWorldLocation();
+            const Vector3 newLocation = currentLocation + rigidBody.Velocity * time;
+            if (!worldBounds.Contains(newLocation))
             {
-                bodyIndex = lastDynamicIndex;
-                Bodies[lastDynamicIndex] = firstDynamicBody;
+                awakeBody.IsOutOfBounds = true;
+                continue;
             }
-            else
+
+            transform.SetWorldLocation(newLocation);
+
+            const Vector3 deltaRotationRad = rigidBody.AngularVelocity * time;
+            transform.SetWorldRotation(
+                transform.GetWorldRotationEuler() + Math::ToDegrees(deltaRotationRad)
+            );
+
+            body.AABB.Move(newLocation - currentLocation);
+
+            UpdateBodyTransform(body);
+
+            const Vector3 size = body.AABB.GetMax() - body.AABB.GetMin();
+            const float motionThreshold = Math::Min(size.x, Math::Min(size.y, size.z)) * _continuousCollisionMotionThreshold;
+            const float motionSquared = (newLocation - currentLocation).LengthSquared();
+            awakeBody.NeedsContinuousCollision = motionSquared > 0.0f && motionSquared > motionThreshold * motionThreshold;
+        }
+    });
+}
+
+void PhysicsSystem::ContinuousCollision()
+{
+    const uint32 awakeBodyCount = static_cast<uint32>(_awakeBodies.Count());
+
+    // All fast bodies are swept before any of them is moved back, so every sweep sees bodies where Integrate left them
+    Engine::Get().GetThreadPool().ParallelFor(awakeBodyCount, _bodiesPerBatch, [this](uint32 begin, uint32 end)
+    {
+        DArray<OrientedBox> targets;
+        DArray<RayContact> contacts;
+
+        for (uint32 i = begin; i < end; ++i)
+        {
+            AwakeBody& awakeBody = _awakeBodies[i];
+            if (awakeBody.NeedsContinuousCollision && !awakeBody.IsOutOfBounds)
             {
-                bodyIndex = firstDynamicIndex;
-                Bodies[firstDynamicIndex] = &body;
+                awakeBody.TimeOfImpact = FindTimeOfImpact(awakeBody, targets, contacts);
+            }
+        }
+    });
+
+    Engine::Get().GetThreadPool().ParallelFor(awakeBodyCount, _bodiesPerBatch, [this](uint32 begin, uint32 end)
+    {
+        for (uint32 i = begin; i < end; ++i)
+        {
+            const AwakeBody& awakeBody = _awakeBodies[i];
+            if (awakeBody.TimeOfImpact >= 1.0f)
+            {
+                continue;
+            }
+
+            Body& body = *awakeBody.PhysicsBody;
+
+            const Vector3 motion = body.AABB.GetCenter() - awakeBody.StartAABB.GetCenter();
+            const float fraction = Math::Min(1.0f, awakeBody.TimeOfImpact + _continuousCollisionPenetration / motion.Length());
+            MoveBody(body, motion * (fraction - 1.0f));
+        }
+    });
+}
+
+float PhysicsSystem::FindTimeOfImpact(const AwakeBody& awakeBody, DArray<OrientedBox>& targets, DArray<RayContact>& contacts) const
+{
+    const Body& body = *awakeBody.PhysicsBody;
+    const BoundingBox sweptAABB = awakeBody.StartAABB.Union(body.AABB);
+
+    const OrientedBox movingBox = body.IsBox ? body.WorldBox : OrientedBox(body.AABB);
+    const Vector3 motion = body.AABB.GetCenter() - awakeBody.StartAABB.GetCenter();
+    const Line motionLine = {movingBox.Center - motion, movingBox.Center};
+
+    // Each candidate is grown by the moving box projected on its axes, which turns the sweep into a ray test against
+    // a box that contains the true Minkowski sum, so the time of impact is conservative
+    targets.Clear();
+    ForEachBodyAt(sweptAABB, body.CollisionMask, [&body, &sweptAABB, &movingBox, &targets](const Body& otherBody)
+    {
+        if (otherBody.Entity == body.Entity || !body.CanCollideWith(otherBody) || !sweptAABB.Overlap(otherBody.AABB))
+        {
+            return true;
+        }
+
+        OrientedBox& target = targets.Add(otherBody.IsBox ? otherBody.WorldBox : OrientedBox(otherBody.AABB));
+        target.HalfExtents += Vector3(
+            movingBox.GetProjectedRadius(target.Axes[0]),
+            movingBox.GetProjectedRadius(target.Axes[1]),
+            movingBox.GetProjectedRadius(target.Axes[2])
+        );
+
+        return true;
+    });
+
+    if (targets.IsEmpty())
+    {
+        return 1.0f;
+    }
+
+    contacts.Clear();
+    for (uint32 i = 0; i < targets.Count(); ++i)
+    {
+        contacts.AddDefault();
+    }
+
+    CollisionKernels::RayBox(motionLine, targets.GetData(), static_cast<uint32>(targets.Count()), contacts.GetData());
+
+    // Bodies touching at the start of the step are left to the narrow phase
+    float timeOfImpact = 1.0f;
+    for (const RayContact& contact : contacts)
+    {
+        if (contact.IsValid && contact.Fraction > 0.0f)
+        {
+            timeOfImpact = Math::Min(timeOfImpact, contact.Fraction);
+        }
+    }
+
+    return timeOfImpact;
+}
+
+void PhysicsSystem::BroadPhase()
+{
+    Engine::Get().GetThreadPool().ParallelFor(static_cast<uint32>(_awakeBodies.Count()), _bodiesPerBatch, [this](uint32 begin, uint32 end)
+    {
+        DArray<CollisionPair> pairs;
+        for (uint32 i = begin; i < end; ++i)
+        {
+            if (!_awakeBodies[i].IsOutOfBounds)
+            {
+                BroadPhase(_awakeBodies[i], pairs);
+            }
+        }
+
+        if (pairs.IsEmpty())
+        {
+            return;
+        }
+
+        SpinLockGuard guard(_broadPhaseLock);
+        for (const CollisionPair& pair : pairs)
+        {
+            _narrowPhaseInputPairs.Add(pair);
+        }
+    });
+
+    // Two awake bodies find each other
+    CollisionPair* pairs = _narrowPhaseInputPairs.GetData();
+    const uint32 pairCount = static_cast<uint32>(_narrowPhaseInputPairs.Count());
+
+    // Pairs are gathered in whatever order jobs finish, contacts are solved in pair order, so deterministic mode orders
+    // them by entity IDs instead of addresses
+    if (_isDeterministic)
+    {
+        std::sort(pairs, pairs + pairCount, [](const CollisionPair& a, const CollisionPair& b)
+        {
+            return std::make_pair(a.BodyA->Entity->GetID(), a.BodyB->Entity->GetID()) <
+                std::make_pair(b.BodyA->Entity->GetID(), b.BodyB->Entity->GetID());
+        });
+    }
+    else
+    {
+        std::sort(pairs, pairs + pairCount);
+    }
+
+    const uint32 uniquePairCount = static_cast<uint32>(std::unique(pairs, pairs + pairCount) - pairs);
+    while (_narrowPhaseInputPairs.Count() > uniquePairCount)
+    {
+        _narrowPhaseInputPairs.PopBack();
+    }
+}
+
+void PhysicsSystem::BroadPhase(const AwakeBody& awakeBody, DArray<CollisionPair>& outPairs) const
+{
+    Body& body = *awakeBody.PhysicsBody;
+    const BoundingBox sweptAABB = awakeBody.StartAABB.Union(body.AABB);
+
+    // Layers outside of the mask are skipped by the broad phase, the other body's mask is checked per pair
+    ForEachBodyAt(sweptAABB, body.CollisionMask, [this, &body, &sweptAABB, &outPairs](Body& otherBody)
+    {
+        if (otherBody.Entity != body.Entity && body.CanCollideWith(otherBody) && sweptAABB.Overlap(otherBody.AABB))
+        {
+            outPairs.Add(MakeCollisionPair(body, otherBody));
+        }
+
+        return true;
+    });
+}
+
+void PhysicsSystem::NarrowPhase()
+{
+    const uint32 pairCount = static_cast<uint32>(_narrowPhaseInputPairs.Count());
+
+    _narrowPhaseHits.Reserve(pairCount);
+    for (uint32 i = 0; i < pairCount; ++i)
+    {
+        _narrowPhaseHits.AddDefault();
+    }
+
+    Engine::Get().GetThreadPool().ParallelFor(pairCount, _pairsPerBatch, [this](uint32 begin, uint32 end)
+    {
+        // Box pairs are gathered and tested together by the SAT kernel, other shape pairs go through GJK/EPA
+        uint32 boxPairs[_pairsPerBatch];
+        OrientedBox boxesA[_pairsPerBatch];
+        OrientedBox boxesB[_pairsPerBatch];
+        uint32 boxPairCount = 0;
+
+        const auto flushBoxPairs = [this, &boxPairs, &boxesA, &boxesB, &boxPairCount]()
+        {
+            BoxContact contacts[_pairsPerBatch];
+            CollisionKernels::BoxBox(boxesA, boxesB, boxPairCount, contacts);
+
+            for (uint32 i = 0; i < boxPairCount; ++i)
+            {
+                const BoxContact& contact = contacts[i];
+                Hit& hit = _narrowPhaseHits[boxPairs[i]];
+
+                hit.IsValid = contact.IsValid;
+                hit.PenetrationDepth = contact.PenetrationDepth;
+                hit.OtherBody = _narrowPhaseInputPairs[boxPairs[i]].BodyB;
+                hit.ImpactNormal = contact.Normal;
+                hit.Location = contact.Location;
+            }
+
+            boxPairCount = 0;
+        };
+
+        for (uint32 i = begin; i < end; ++i)
+        {
+            const CollisionPair& pair = _narrowPhaseInputPairs[i];
+            if (!pair.BodyA->IsBox || !pair.BodyB->IsBox)
+            {
+                _narrowPhaseHits[i] = CollisionCheck(*pair.BodyA, *pair.BodyB);
+                continue;
+            }
+
+            boxPairs[boxPairCount] = i;
+            boxesA[boxPairCount] = pair.BodyA->WorldBox;
+            boxesB[boxPairCount] = pair.BodyB->WorldBox;
+
+            if (++boxPairCount == _pairsPerBatch)
+            {
+                flushBoxPairs();
+            }
+        }
+
+        if (boxPairCount > 0)
+        {
+            flushBoxPairs();
+        }
+    });
+}
+
+void PhysicsSystem::UpdateManifolds()
+{
+    const uint32 pairCount = static_cast<uint32>(_narrowPhaseInputPairs.Count());
+
+    _pairManifolds.Clear();
+    _pairManifolds.Reserve(pairCount);
+
+    // Lookups modify the map, so they run serially before points of each manifold are updated in parallel
+    for (uint32 i = 0; i < pairCount; ++i)
+    {
+        if (!_narrowPhaseHits[i].IsValid)
+        {
+            _pairManifolds.Add(nullptr);
+            continue;
+        }
+
+        const CollisionPair& pair = _narrowPhaseInputPairs[i];
+        ContactManifold& manifold = _manifolds[MakeManifoldKey(*pair.BodyA, *pair.BodyB)];
+        if (!manifold.BelongsTo(*pair.BodyA, *pair.BodyB))
+        {
+            manifold.Reset(*pair.BodyA, *pair.BodyB);
+        }
+
+        manifold.LastStep = _stepCount;
+        _pairManifolds.Add(&manifold);
+    }
+
+    Engine::Get().GetThreadPool().ParallelFor(pairCount, _pairsPerBatch, [this](uint32 begin, uint32 end)
+    {
+        for (uint32 i = begin; i < end; ++i)
+        {
+            ContactManifold* manifold = _pairManifolds[i];
+            if (manifold != nullptr)
+            {
+                const Hit& hit = _narrowPhaseHits[i];
+                manifold->Update(hit.Location, hit.ImpactNormal, hit.PenetrationDepth, _contactBreakingDistance);
+            }
+        }
+    });
+}
+
+void PhysicsSystem::Solve()
+{
+    if (_islandContactRanges.Count() < 2)
+    {
+        return;
+    }
+
+    const uint32 islandCount = static_cast<uint32>(_islandContactRanges.Count()) - 1;
+
+    // Manifolds of an island are solved by one job with sequential impulses, islands don't share any dynamic bodies
+    Engine::Get().GetThreadPool().ParallelFor(islandCount, 1, [this](uint32 begin, uint32 end)
+    {
+        for (uint32 island = begin; island < end; ++island)
+        {
+            const uint32 contactsBegin = _islandContactRanges[island];
+            const uint32 contactsEnd = _islandContactRanges[island + 1];
+
+            for (uint32 i = contactsBegin; i < contactsEnd; ++i)
+            {
+                ContactManifold& manifold = *_pairManifolds[_islandContacts[i]];
+                PrepareContacts(manifold);
+                WarmStartContacts(manifold);
+            }
+
+            for (uint32 iteration = 0; iteration < _velocityIterations; ++iteration)
+            {
+                for (uint32 i = contactsBegin; i < contactsEnd; ++i)
+                {
+                    SolveContactVelocities(*_pairManifolds[_islandContacts[i]]);
+                }
+            }
+
+            for (uint32 iteration = 0; iteration < _positionIterations; ++iteration)
+            {
+                for (uint32 i = contactsBegin; i < contactsEnd; ++i)
+                {
+                    SolveContactPositions(*_pairManifolds[_islandContacts[i]]);
+                }
             }
-
-            ++DormantBodyCount;
-            break;
-        }
-        
-        case ERigidBodyState::Dynamic:
-        {
-            const uint32 index = StaticBodyCount + DormantBodyCount + DynamicBodyCount;
-            bodyIndex = index;
-            
-            Bodies[index] = &body;
-            
-            ++DynamicBodyCount;
-            break;
         }
-    }
-
-    return bodyIndex;
+    });
 }
 
-void PhysicsSystem::Cell::RemoveBody(const PhysicsSystem& system, uint32 index)
+void PhysicsSystem::WriteBack()
 {
-    if (index >= StaticBodyCount + DormantBodyCount && DynamicBodyCount > 0)
+    for (const AwakeBody& awakeBody : _awakeBodies)
     {
-        if (StaticBodyCount + DormantBodyCount > 0)
+        Body& body = *awakeBody.PhysicsBody;
+        if (awakeBody.IsOutOfBounds)
         {
-            const uint32 lastDynamicIndex = StaticBodyCount + DormantBodyCount + DynamicBodyCount - 1;
-            if (index < lastDynamicIndex)
-            {
-                Body* lastDynamicBody = Bodies[lastDynamicIndex];
-                lastDynamicBody->IndicesInCells[system.GetRelativeIndexOf(*lastDynamicBody, *this)] = index;
-                
-                Bodies[index] = lastDynamicBody;
-            }
+            // todo migrate entity to another world
+            GetWorld().DestroyEntityAsync(*body.Entity);
+            continue;
         }
 
-        --DynamicBodyCount;
+        _broadPhase->Move(body.BodyIndex, body.AABB);
+        UpdateSleepState(body);
     }
-    else if (index >= StaticBodyCount && DormantBodyCount > 0)
-    {
-        const uint32 lastDormantIndex = StaticBodyCount + DormantBodyCount - 1;
-        Body* lastDormantBody = Bodies[lastDormantIndex];
-        lastDormantBody->IndicesInCells[system.GetRelativeIndexOf(*lastDormantBody, *this)] = index;
-        Bodies[index] = lastDormantBody;
+}
 
-        Body* lastDynamicBody = Bodies[StaticBodyCount + DormantBodyCount + DynamicBodyCount - 1];
-        lastDynamicBody->IndicesInCells[system.GetRelativeIndexOf(*lastDynamicBody, *this)] = lastDormantIndex;
-        Bodies[lastDormantIndex] = lastDynamicBody;
+uint64 PhysicsSystem::MakeManifoldKey(const Body& bodyA, const Body& bodyB)
+{
+    const uint64 minIndex = Math::Min(bodyA.BodyIndex, bodyB.BodyIndex);
+    const uint64 maxIndex = Math::Max(bodyA.BodyIndex, bodyB.BodyIndex);
 
-        --DormantBodyCount;
-    }
-    else if (StaticBodyCount > 0)
-    {
-        const uint32 lastStaticIndex = StaticBodyCount - 1;
+    return minIndex << 32 | maxIndex;
+}
 
-        Body** lastStaticBody = &Bodies[lastStaticIndex];
-        (*lastStaticBody)->IndicesInCells[system.GetRelativeIndexOf(**lastStaticBody, *this)] = index;
-        Bodies[index] = *lastStaticBody;
+PhysicsSystem::CollisionPair PhysicsSystem::MakeCollisionPair(Body& awakeBody, Body& otherBody) const
+{
+    if (IsAwakeInCurrentStep(otherBody) && otherBody.Entity->GetID() < awakeBody.Entity->GetID())
+    {
+        return {&otherBody, &awakeBody};
+    }
 
-        Body** lastDormantBody = &Bodies[lastStaticIndex + DormantBodyCount];
-        (*lastDormantBody)->IndicesInCells[system.GetRelativeIndexOf(**lastDormantBody, *this)] = lastStaticIndex;
-        *lastStaticBody = *lastDormantBody;
+    return {&awakeBody, &otherBody};
+}
 
-        Body** lastDynamicBody = &Bodies[StaticBodyCount + DormantBodyCount + DynamicBodyCount - 1];
-        (*lastDormantBody)->IndicesInCells[system.GetRelativeIndexOf(**lastDormantBody, *this)] = lastStaticIndex + DormantBodyCount;
-        *lastDormantBody = *lastDynamicBody;
+void PhysicsSystem::UpdateSleepState(Body& body)
+{
+    const CRigidBody& rigidBody = body.GetRigidBody();
 
-        StaticBodyCount--;
+    if (rigidBody.Velocity.LengthSquared() < Math::Square(_sleepLinearVelocityThreshold) &&
+        rigidBody.AngularVelocity.LengthSquared() < Math::Square(_sleepAngularVelocityThreshold))
+    {
+        ++body.StepsAtRest;
     }
     else
     {
-        return;
+        body.StepsAtRest = 0;
     }
-
-    Bodies.RemoveAt(StaticBodyCount + DormantBodyCount + DynamicBodyCount);
 }
 
-void PhysicsSystem::Cell::SetBodyState(uint32 index, ERigidBodyState bodyType)
+void PhysicsSystem::BuildIslands()
 {
-}
+    // Bodies hit by awake bodies join current step, so every dynamic body of a contact belongs to an island
+    for (uint32 i = 0; i < _narrowPhaseInputPairs.Count(); ++i)
+    {
+        if (!_narrowPhaseHits[i].IsValid)
+        {
+            continue;
+        }
 
-PhysicsSystem::CellIndex PhysicsSystem::GetCellIndex(const Vector3& location) const
-{
-    const BoundingBox& worldBounds = GetWorld().WorldBounds;
-    const Vector3 relativeLocation = location - worldBounds.GetMin();
+        Body& body = *_narrowPhaseInputPairs[i].BodyB;
+        CRigidBody& rigidBody = body.GetRigidBody();
+        if (rigidBody.State == ERigidBodyState::Static || IsAwakeInCurrentStep(body))
+        {
+            continue;
+        }
 
-    const Vector3 index3D = relativeLocation / _cellSize;
-    
-    CellIndex index;
-    index.X = static_cast<uint32>(Math::FloorToInt(index3D.x));
-    index.Y = static_cast<uint32>(Math::FloorToInt(index3D.y));
-    index.Z = static_cast<uint32>(Math::FloorToInt(index3D.z));
+        // Contact with a moving body wakes up the whole island of a sleeping body
+        if (rigidBody.State == ERigidBodyState::Dormant)
+        {
+            WakeBody(body);
+        }
 
-    return index;
-}
+        body.IslandIndex = static_cast<uint32>(_awakeBodies.Count());
+        _awakeBodies.Add({&body, body.AABB});
+    }
 
-PhysicsSystem::Cell& PhysicsSystem::GetCellAt(const Vector3& location)
-{
-    return const_cast<Cell&>(GetCellAt(GetCellIndex(location)));
-}
+    const uint32 bodyCount = static_cast<uint32>(_awakeBodies.Count());
 
-const PhysicsSystem::Cell& PhysicsSystem::GetCellAt(const Vector3& location) const
-{
-    return GetCellAt(GetCellIndex(location));
-}
+    _islandParents.Clear();
+    _islandSleepingIDs.Clear();
+    _islandCanSleep.Clear();
+    _islandParents.Reserve(bodyCount);
+    _islandSleepingIDs.Reserve(bodyCount);
+    _islandCanSleep.Reserve(bodyCount);
 
-PhysicsSystem::Cell& PhysicsSystem::GetCellAt(const CellIndex& index)
-{
-    return const_cast<Cell&>(GetCellAtImplementation(index));
-}
+    for (uint32 i = 0; i < bodyCount; ++i)
+    {
+        _islandParents.Add(i);
+        _islandSleepingIDs.Add(0);
+        _islandCanSleep.Add(true);
+    }
 
-const PhysicsSystem::Cell& PhysicsSystem::GetCellAt(const CellIndex& index) const
-{
-    return GetCellAtImplementation(index);
-}
+    _islandContacts.Clear();
 
-PhysicsSystem::Cell* PhysicsSystem::GetCellAtIfExists(const CellIndex& index)
-{
-    return const_cast<Cell*>(GetCellAtIfExistsImplementation(index));
-}
+    // Static bodies don't link islands together, otherwise every body resting on the floor would be in one island
+    for (uint32 i = 0; i < _narrowPhaseInputPairs.Count(); ++i)
+    {
+        if (!_narrowPhaseHits[i].IsValid)
+        {
+            continue;
+        }
 
-const PhysicsSystem::Cell* PhysicsSystem::GetCellAtIfExists(const CellIndex& index) const
-{
-    return GetCellAtIfExistsImplementation(index);
-}
+        _islandContacts.Add(i);
 
-uint32 PhysicsSystem::GetRelativeIndexOf(const Body& body, const Cell& cell) const
-{
-    const CellIndex minIndex = GetCellIndex(body.AABB.GetMin());
+        const CollisionPair& pair = _narrowPhaseInputPairs[i];
+        if (!IsAwakeInCurrentStep(*pair.BodyB))
+        {
+            continue;
+        }
 
-    return cell.Index.Z - minIndex.Z +
-        (cell.Index.Y - minIndex.Y) * _cellCountX +
-        (cell.Index.X - minIndex.X) * _cellCountX * _cellCountX;
-}
+        const uint32 rootA = FindIslandRoot(pair.BodyA->IslandIndex);
+        const uint32 rootB = FindIslandRoot(pair.BodyB->IslandIndex);
+        if (rootA != rootB)
+        {
+            _islandParents[Math::Max(rootA, rootB)] = Math::Min(rootA, rootB);
+        }
+    }
 
-void PhysicsSystem::ForEachCellAt(const BoundingBox& aabb, const std::function<bool(Cell& cell, uint32 index)>& func)
-{
-    const CellIndex minIndex = GetCellIndex(aabb.GetMin());
-    const CellIndex maxIndex = GetCellIndex(aabb.GetMax());
+    // Flatten, so that _islandParents holds the root of each body
+    for (uint32 i = 0; i < bodyCount; ++i)
+    {
+        FindIslandRoot(i);
+    }
 
-    uint32 i = 0;
-    for (uint32 x = minIndex.X; x <= maxIndex.X; ++x)
+    std::sort(_islandContacts.GetData(), _islandContacts.GetData() + _islandContacts.Count(), [this](uint32 a, uint32 b)
     {
-        for (uint32 y = minIndex.Y; y <= maxIndex.Y; ++y)
-        {
-            for (uint32 z = minIndex.Z; z <= maxIndex.Z; ++z)
-            {
-                CellIndex index = {x, y, z};
-                if (!func(GetCellAt(index), i))
-                {
-                    return;
-                }
+        const uint32 rootA = _islandParents[_narrowPhaseInputPairs[a].BodyA->IslandIndex];
+        const uint32 rootB = _islandParents[_narrowPhaseInputPairs[b].BodyA->IslandIndex];
 
-                ++i;
-            }
+        return std::tie(rootA, a) < std::tie(rootB, b);
+    });
+
+    _islandContactRanges.Clear();
+
+    uint32 previousRoot = std::numeric_limits<uint32>::max();
+    for (uint32 i = 0; i < _islandContacts.Count(); ++i)
+    {
+        const uint32 root = _islandParents[_narrowPhaseInputPairs[_islandContacts[i]].BodyA->IslandIndex];
+        if (root != previousRoot)
+        {
+            _islandContactRanges.Add(i);
+            previousRoot = root;
         }
     }
+
+    _islandContactRanges.Add(static_cast<uint32>(_islandContacts.Count()));
 }
 
-void PhysicsSystem::ForEachCellAt(const BoundingBox& aabb, const std::function<bool(const Cell& cell, uint32 index)>& func) const
+void PhysicsSystem::UpdateIslands()
 {
-    const CellIndex minIndex = GetCellIndex(aabb.GetMin());
-    const CellIndex maxIndex = GetCellIndex(aabb.GetMax());
+    const uint32 bodyCount = static_cast<uint32>(_awakeBodies.Count());
 
-    uint32 i = 0;
-    for (uint32 x = minIndex.X; x <= maxIndex.X; ++x)
+    for (uint32 i = 0; i < bodyCount; ++i)
     {
-        for (uint32 y = minIndex.Y; y <= maxIndex.Y; ++y)
+        if (_awakeBodies[i].IsOutOfBounds || _awakeBodies[i].PhysicsBody->StepsAtRest < _sleepStepCount)
         {
-            for (uint32 z = minIndex.Z; z <= maxIndex.Z; ++z)
-            {
-                CellIndex index = {x, y, z};
-                if (!func(GetCellAt(index), i))
-                {
-                    return;
-                }
+            _islandCanSleep[FindIslandRoot(i)] = false;
+        }
+    }
 
-                ++i;
-            }
+    for (uint32 i = 0; i < bodyCount; ++i)
+    {
+        const uint32 root = FindIslandRoot(i);
+        if (!_islandCanSleep[root])
+        {
+            continue;
+        }
+
+        if (_islandSleepingIDs[root] == 0)
+        {
+            _islandSleepingIDs[root] = _sleepingIslandIDGenerator.GenerateID();
         }
+
+        Body& body = *_awakeBodies[i].PhysicsBody;
+        body.SleepingIslandID = _islandSleepingIDs[root];
+        body.StepsAtRest = 0;
+
+        CRigidBody& rigidBody = body.GetRigidBody();
+        rigidBody.State = ERigidBodyState::Dormant;
+        rigidBody.Velocity = Vector3::Zero;
+        rigidBody.AngularVelocity = Vector3::Zero;
+
+        _sleepingIslands[body.SleepingIslandID].Add(&body);
     }
 }
 
-const PhysicsSystem::Cell& PhysicsSystem::GetCellAtImplementation(const CellIndex& index) const
+uint32 PhysicsSystem::FindIslandRoot(uint32 index)
 {
-    const uint32 index1D = index.X + index.Y * _cellCountX + index.Z * _cellCountX * _cellCountX;
-
-    auto it = _cells.find(index1D);
-    if (it != _cells.end())
+    while (_islandParents[index] != index)
     {
-        return it->second;
+        _islandParents[index] = _islandParents[_islandParents[index]];
+        index = _islandParents[index];
     }
 
-    Cell& newCell = const_cast<std::unordered_map<uint32, Cell>&>(_cells)[index1D];
-    newCell.Index = index;  
-    
-    return newCell;
+    return index;
 }
 
-const PhysicsSystem::Cell* PhysicsSystem::GetCellAtIfExistsImplementation(const CellIndex& index) const
+bool PhysicsSystem::IsAwakeInCurrentStep(const Body& body) const
 {
-    const uint32 index1D = index.X + index.Y * _cellCountX + index.Z * _cellCountX * _cellCountX;
+    return body.IslandIndex < _awakeBodies.Count() && _awakeBodies[body.IslandIndex].PhysicsBody == &body;
+}
+
+void PhysicsSystem::WakeBody(Body& body)
+{
+    if (body.SleepingIslandID == 0)
+    {
+        CRigidBody& rigidBody = body.GetRigidBody();
+        if (rigidBody.State == ERigidBodyState::Dormant)
+        {
+            rigidBody.State = ERigidBodyState::Dynamic;
+        }
+
+        body.StepsAtRest = 0;
+        return;
+    }
+
+    const auto it = _sleepingIslands.find(body.SleepingIslandID);
+    if (it == _sleepingIslands.end())
+    {
+        body.SleepingIslandID = 0;
+        WakeBody(body);
+        return;
+    }
 
-    auto it = _cells.find(index1D);
-    if (it != _cells.end())
+    for (Body* islandBody : it->second)
     {
-        return &it->second;
+        islandBody->SleepingIslandID = 0;
+        islandBody->StepsAtRest = 0;
+        islandBody->GetRigidBody().State = ERigidBodyState::Dynamic;
     }
 
-    return nullptr;
+    _sleepingIslandIDGenerator.FreeID(it->first);
+    _sleepingIslands.erase(it);
 }
 
-void PhysicsSystem::Move(CRigidBody& rigidBody, const Vector3& currentLocation, const Vector3& newLocation, double deltaTime)
+void PhysicsSystem::PrepareContacts(ContactManifold& manifold) const
 {
-    Body& body = rigidBody.PhysicsBody;
-    const BoundingBox currentAABB = body.AABB;
-
-    Vector3 sweepDirection = newLocation - currentLocation;
-    const float distance = sweepDirection.Length();
-    sweepDirection.Normalize();
-    
-    const float sweepDistance = body.AABB.SweepDistance(sweepDirection);
-    
-    float distanceRemaining = distance;
+    const CRigidBody& rigidBodyA = manifold.BodyA->GetRigidBody();
+    const CRigidBody& rigidBodyB = manifold.BodyB->GetRigidBody();
+
+    // Bodies that aren't simulated have infinite mass, so the solver never writes to them
+    const bool isDynamicB = rigidBodyB.State == ERigidBodyState::Dynamic;
+    manifold.InverseMassA = 1.0f / rigidBodyA.Mass;
+    manifold.InverseInertiaA = 1.0f / rigidBodyA.Inertia;
+    manifold.InverseMassB = isDynamicB ? 1.0f / rigidBodyB.Mass : 0.0f;
+    manifold.InverseInertiaB = isDynamicB ? 1.0f / rigidBodyB.Inertia : 0.0f;
+
+    const Vector3& normal = manifold.Normal;
+    manifold.Tangents[0] = Math::Abs(normal.x) >= 0.57735f ? Vector3(normal.y, -normal.x, 0.0f) : Vector3(0.0f, normal.z, -normal.y);
+    manifold.Tangents[0].Normalize();
+    manifold.Tangents[1] = normal.Cross(manifold.Tangents[0]);
+
+    const Vector3 locationA = manifold.BodyA->WorldMatrix.Translation();
+    const Vector3 locationB = manifold.BodyB->WorldMatrix.Translation();
+    const float restitution = (rigidBodyA.Restitution + rigidBodyB.Restitution) / 2.0f;
 
-    const Vector3 offset = body.GetTransform().ComponentTransform.GetWorldLocation() - body.AABB.GetCenter();
-    
-    while (distanceRemaining > 0.0f)
+    const auto getEffectiveMass = [&manifold](const ContactPoint& point, const Vector3& direction)
     {
-        BoundingBox sweepAABB = body.AABB;
-
-        const float distancePassed = Math::Min(sweepDistance, distanceRemaining);
-        distanceRemaining -= distancePassed;
+        const float inverseMass = manifold.InverseMassA + manifold.InverseMassB +
+            point.OffsetA.Cross(direction).LengthSquared() * manifold.InverseInertiaA +
+            point.OffsetB.Cross(direction).LengthSquared() * manifold.InverseInertiaB;
 
-        const Vector3 sweepVector = sweepDirection * distancePassed;
+        return inverseMass > 0.0f ? 1.0f / inverseMass : 0.0f;
+    };
 
-        body.AABB.Move(sweepVector);
-        sweepAABB = sweepAABB.Union(body.AABB);
+    for (uint32 i = 0; i < manifold.PointCount; ++i)
+    {
+        ContactPoint& point = manifold.Points[i];
+        point.OffsetA = point.PointB - locationA;
+        point.OffsetB = point.PointB - locationB;
 
-        Cell& cellAtSweep = GetCellAt(sweepAABB.GetCenter());
+        point.NormalMass = getEffectiveMass(point, normal);
+        point.TangentMasses[0] = getEffectiveMass(point, manifold.Tangents[0]);
+        point.TangentMasses[1] = getEffectiveMass(point, manifold.Tangents[1]);
 
-        bool hitFound = false;
-        for (Body* cellBody : cellAtSweep.Bodies)
-        {
-            if (cellBody->Entity == body.Entity)
-            {
-                continue;
-            }
-        
-            if (sweepAABB.Overlap(cellBody->AABB))
-            {
-                const Vector3 bodyLocation = body.AABB.GetCenter() + offset;
-                Transform& transform = body.GetTransform().ComponentTransform;
-                transform.SetWorldLocation(bodyLocation);
-                
-                Hit hit = CollisionCheck(body, *cellBody);
-                
-                if (hit.IsValid)
-                {
-                    ProcessHit(body, hit);
-                    // LOG(L"Hit location {}, normal {}", hit.Location, hit.ImpactNormal);
-                    
-                    const Vector3 location = body.AABB.GetCenter();
-                    body.AABB.Move(hit.ImpactNormal * hit.PenetrationDepth);
-                    if (hit.PenetrationDepth > 1.0f)
-                    {
-                        __nop();
-                    }
-                    LOG(L"Resolving penetration: normal {}, depth {}, location before {}, location after {}",
-                        hit.ImpactNormal,
-                        hit.PenetrationDepth,
-                        location,
-                        body.AABB.GetCenter()
-                    );
+        const float normalVelocity = GetContactVelocity(manifold, point).Dot(normal);
+        point.VelocityBias = normalVelocity < -_restitutionVelocityThreshold ? -restitution * normalVelocity : 0.0f;
+    }
+}
 
-                    _narrowPhaseInputPairs.Add({&body, hit.OtherBody});
+void PhysicsSystem::WarmStartContacts(ContactManifold& manifold) const
+{
+    for (uint32 i = 0; i < manifold.PointCount; ++i)
+    {
+        const ContactPoint& point = manifold.Points[i];
+        const Vector3 impulse = manifold.Normal * point.NormalImpulse +
+            manifold.Tangents[0] * point.TangentImpulses[0] +
+            manifold.Tangents[1] * point.TangentImpulses[1];
 
-                    hitFound = true;
-                    break;
-                }
-            }
-        }
-        
-        if (hitFound)
-        {
-            break;
-        }
+        ApplyContactImpulse(manifold, point, impulse);
     }
+}
+
+void PhysicsSystem::SolveContactVelocities(ContactManifold& manifold) const
+{
+    for (uint32 i = 0; i < manifold.PointCount; ++i)
+    {
+        ContactPoint& point = manifold.Points[i];
 
-    const Vector3 location = body.AABB.GetCenter() + offset;
+        // Friction is limited by the normal impulse of the previous iteration
+        const float maxFriction = _contactFriction * point.NormalImpulse;
+        for (uint32 t = 0; t < 2; ++t)
+        {
+            const float tangentVelocity = GetContactVelocity(manifold, point).Dot(manifold.Tangents[t]);
+            const float oldImpulse = point.TangentImpulses[t];
 
-    Transform& transform = body.GetTransform().ComponentTransform;
-    transform.SetWorldLocation(location);
+            point.TangentImpulses[t] = Math::Clamp(oldImpulse - tangentVelocity * point.TangentMasses[t], -maxFriction, maxFriction);
+            ApplyContactImpulse(manifold, point, manifold.Tangents[t] * (point.TangentImpulses[t] - oldImpulse));
+        }
 
-    const Vector3 deltaRotationRad = rigidBody.AngularVelocity * static_cast<float>(deltaTime);
-    transform.SetWorldRotation(
-        transform.GetWorldRotationEuler() + Math::ToDegrees(deltaRotationRad)
-    );
+        // Accumulated impulse is clamped instead of each delta, so later iterations can take back what earlier ones overshot
+        const float normalVelocity = GetContactVelocity(manifold, point).Dot(manifold.Normal);
+        const float oldImpulse = point.NormalImpulse;
 
-    Move(rigidBody, currentAABB, body.AABB);
+        point.NormalImpulse = Math::Max(oldImpulse - (normalVelocity - point.VelocityBias) * point.NormalMass, 0.0f);
+        ApplyContactImpulse(manifold, point, manifold.Normal * (point.NormalImpulse - oldImpulse));
+    }
 }
 
-void PhysicsSystem::Move(CRigidBody& rigidBody, const BoundingBox& current, const BoundingBox& next)
+void PhysicsSystem::SolveContactPositions(ContactManifold& manifold) const
 {
-    Body& body = rigidBody.PhysicsBody;
+    const float inverseMassSum = manifold.InverseMassA + manifold.InverseMassB;
+    if (inverseMassSum <= 0.0f)
+    {
+        return;
+    }
 
-    const CellIndex currentMin = GetCellIndex(current.GetMin());
-    const CellIndex currentMax = GetCellIndex(current.GetMax());
-    const CellIndex newMin = GetCellIndex(next.GetMin());
-    const CellIndex newMax = GetCellIndex(next.GetMax());
+    float maxPenetration = 0.0f;
+    for (uint32 i = 0; i < manifold.PointCount; ++i)
+    {
+        const ContactPoint& point = manifold.Points[i];
+        const Vector3 pointA = Vector3::Transform(point.LocalPointA, manifold.BodyA->WorldMatrix);
+        const Vector3 pointB = Vector3::Transform(point.LocalPointB, manifold.BodyB->WorldMatrix);
 
-    CellIndex intersectMin;
-    intersectMin.X = Math::Max(currentMin.X, newMin.X);
-    intersectMin.Y = Math::Max(currentMin.Y, newMin.Y);
-    intersectMin.Z = Math::Max(currentMin.Z, newMin.Z);
-    
-    CellIndex intersectMax;
-    intersectMax.X = Math::Min(currentMax.X, newMax.X);
-    intersectMax.Y = Math::Min(currentMax.Y, newMax.Y);
-    intersectMax.Z = Math::Min(currentMax.Z, newMax.Z);
+        maxPenetration = Math::Max(maxPenetration, (pointB - pointA).Dot(manifold.Normal));
+    }
 
-    uint32 index = 0;
-    for (uint32 x = currentMin.X; x < intersectMin.X; ++x)
+    const float correction = Math::Min((maxPenetration - _contactSlop) * _positionCorrectionFactor, _maxPositionCorrection);
+    if (correction <= 0.0f)
     {
-        for (uint32 y = currentMin.Y; y < intersectMin.Y; ++y)
-        {
-            for (uint32 z = currentMin.Z; z < intersectMin.Z; ++z)
-            {
-                Cell& cell = GetCellAt(CellIndex(x, y, z));
-                cell.RemoveBody(*this, body.IndicesInCells[index]);
-
-                ++index;
-            }
-        }
+        return;
     }
-    
-    for (uint32 x = intersectMax.X + 1; x <= currentMax.X; ++x)
+
+    MoveBody(*manifold.BodyA, manifold.Normal * (correction * manifold.InverseMassA / inverseMassSum));
+    if (manifold.InverseMassB > 0.0f)
     {
-        for (uint32 y = intersectMax.Y + 1; y <= currentMax.Y; ++y)
-        {
-            for (uint32 z = intersectMax.Z + 1; z <= currentMax.Z; ++z)
-            {
-                Cell& cell = GetCellAt(CellIndex(x, y, z));
-                cell.AddBody(body, rigidBody.State);
-            }
-        }
+        MoveBody(*manifold.BodyB, manifold.Normal * (-correction * manifold.InverseMassB / inverseMassSum));
     }
 }
 
-void PhysicsSystem::BroadPhase(Body& body, Cell& cell)
+void PhysicsSystem::ApplyContactImpulse(const ContactManifold& manifold, const ContactPoint& point, const Vector3& impulse) const
 {
-    for (Body* cellBody : cell.Bodies)
+    CRigidBody& rigidBodyA = manifold.BodyA->GetRigidBody();
+    rigidBodyA.Velocity += impulse * manifold.InverseMassA;
+    rigidBodyA.AngularVelocity += point.OffsetA.Cross(impulse) * manifold.InverseInertiaA;
+
+    if (manifold.InverseMassB > 0.0f)
     {
-        if (cellBody->Entity == body.Entity)
-        {
-            continue;
-        }
-        
-        if (body.AABB.Overlap(cellBody->AABB))
-        {
-            _narrowPhaseInputPairs.Add({&body, cellBody});
-        }
+        CRigidBody& rigidBodyB = manifold.BodyB->GetRigidBody();
+        rigidBodyB.Velocity -= impulse * manifold.InverseMassB;
+        rigidBodyB.AngularVelocity -= point.OffsetB.Cross(impulse) * manifold.InverseInertiaB;
     }
 }
 
-void PhysicsSystem::NarrowPhase()
+Vector3 PhysicsSystem::GetContactVelocity(const ContactManifold& manifold, const ContactPoint& point) const
 {
-    // for (const CollisionPair& pair : _narrowPhaseInputPairs)
-    // {
-    //     CRigidBody& rigidBodyA = pair.BodyA->GetRigidBody();
-    //     CRigidBody& rigidBodyB = pair.BodyB->GetRigidBody();
-    //
-    //     const Vector3 velocityA = rigidBodyA.Velocity;
-    //     const Vector3 velocityB = rigidBodyB.Velocity;
-    //
-    //     Hit hit = CollisionCheck(*pair.BodyA, *pair.BodyB);
-    //
-    //     // todo update overlaps
-    // }
+    const CRigidBody& rigidBodyA = manifold.BodyA->GetRigidBody();
+    const CRigidBody& rigidBodyB = manifold.BodyB->GetRigidBody();
+
+    return rigidBodyA.Velocity + rigidBodyA.AngularVelocity.Cross(point.OffsetA) -
+        rigidBodyB.Velocity - rigidBodyB.AngularVelocity.Cross(point.OffsetB);
 }
 
-void PhysicsSystem::ProcessHit(const Body& bodyA, const Hit& hit)
+void PhysicsSystem::MoveBody(Body& body, const Vector3& offset) const
 {
-    CRigidBody& rigidBodyA = bodyA.GetRigidBody();
-    CRigidBody& rigidBodyB = hit.OtherBody->GetRigidBody();
-
-    CTransform& transformA = bodyA.GetTransform();
-
-    const float mass = 1.0f / ((1.0f / rigidBodyA.Mass) + (1.0f / rigidBodyB.Mass));
-
-    const Vector3 rA = hit.Location - transformA.ComponentTransform.GetWorldLocation();
-    const Vector3 rB = hit.Location - hit.OtherBody->GetTransform().ComponentTransform.GetWorldLocation();
+    body.AABB.Move(offset);
 
-    const Vector3 relativeVelocity = (rigidBodyA.Velocity - rigidBodyB.Velocity) +
-        rigidBodyA.AngularVelocity.Cross(rA) -
-        rigidBodyB.AngularVelocity.Cross(rB);
-    const float impulseSpeed = hit.ImpactNormal.Dot(relativeVelocity);
+    Transform& transform = body.GetTransform().ComponentTransform;
+    transform.SetWorldLocation(transform.GetWorldLocation() + offset);
 
-    const float restitution = (rigidBodyA.Restitution + rigidBodyB.Restitution) / 2.0f;
-    const Vector3 impulse = hit.ImpactNormal * (1.0f + restitution) * impulseSpeed /
-    (mass +
-        rA.Cross(hit.ImpactNormal).Dot(rA.Cross(hit.ImpactNormal)) / rigidBodyA.Inertia +
-        rB.Cross(hit.ImpactNormal).Dot(rB.Cross(hit.ImpactNormal)) / rigidBodyB.Inertia);
+    UpdateBodyTransform(body);
+}
 
-    rigidBodyA.Velocity -= impulse / rigidBodyA.Mass;
-    rigidBodyA.AngularVelocity -= rA.Cross(impulse) / rigidBodyA.Inertia;
-    
-    const Vector3 velocityDeltaB = impulse * hit.ImpactNormal / rigidBodyB.Mass;
-    const Vector3 angularVelocityDeltaB = rB.Cross(impulse) / rigidBodyB.Inertia;
+void PhysicsSystem::UpdateBodyTransform(Body& body) const
+{
+    body.WorldMatrix = body.GetTransform().ComponentTransform.GetWorldMatrix();
+    body.InverseWorldMatrix = body.WorldMatrix.Invert();
 
-    if (rigidBodyB.State != ERigidBodyState::Dynamic)
-    {
-        rigidBodyA.Velocity -= velocityDeltaB;
-        rigidBodyA.AngularVelocity -= angularVelocityDeltaB;
-    }
-    else
+    const BoundingBox* box = std::get_if<BoundingBox>(&body.GetCollider().Shape);
+    body.IsBox = box != nullptr;
+    if (body.IsBox)
     {
-        rigidBodyB.Velocity += velocityDeltaB;
-        rigidBodyB.AngularVelocity += angularVelocityDeltaB;
+        body.WorldBox = OrientedBox(*box, body.WorldMatrix);
     }
-
-    //LOG(L"Velocity after hit: {}", rigidBodyA.Velocity);
 }
 
-Vector3 PhysicsSystem::Support(const Body& body, const Vector3& directionNormalized) const
+Vector3 PhysicsSystem::Support(const Body& body, const Vector3& directionNormalized, uint32& vertexHint) const
 {
-    Vector3 furthestPointA;
-    Vector3 transformedDirectionA = Vector3::TransformNormal(directionNormalized, body.GetTransform().ComponentTransform.GetWorldMatrix().Invert());
-    transformedDirectionA.Normalize();
-    std::visit([&transformedDirectionA, &furthestPointA](auto&& arg)
+    Vector3 furthestPoint;
+    Vector3 localDirection = Vector3::TransformNormal(directionNormalized, body.InverseWorldMatrix);
+    localDirection.Normalize();
+    std::visit([&localDirection, &furthestPoint, &vertexHint](auto&& arg)
     {
-        furthestPointA = arg.FurthestPointInDirection(transformedDirectionA);
+        if constexpr (std::is_same_v<std::decay_t<decltype(arg)>, MeshCollision>)
+        {
+            furthestPoint = arg.FurthestPointInDirection(localDirection, vertexHint);
+        }
+        else
+        {
+            furthestPoint = arg.FurthestPointInDirection(localDirection);
+        }
     },
     body.GetCollider().Shape);
 
-    return body.GetTransform().ComponentTransform * furthestPointA;
+    return Vector3::Transform(furthestPoint, body.WorldMatrix);
 }
 
-Vector3 PhysicsSystem::Support(const Line& line, const Vector3& directionNormalized) const
+Vector3 PhysicsSystem::Support(const Line& line, const Vector3& directionNormalized, uint32&) const
 {
     Vector3 rayDirection = line.End - line.Start;
     rayDirection.Normalize();
@@ -832,38 +1627,6 @@ Vector3 PhysicsSystem::Support(const Line& line, const Vector3& directionNormali
     return point + directionNormalized * lineThickness;
 }
 
-Vector3 PhysicsSystem::MinkowskiDifference(const Body& bodyA, const Body& bodyB, const Vector3& direction) const
-{
-    Vector3 directionNormalized = direction;
-    directionNormalized.Normalize();
-    
-    const Vector3 furthestPointA = Support(bodyA, directionNormalized);
-    const Vector3 furthestPointB = Support(bodyB, -directionNormalized);
-
-    return furthestPointA - furthestPointB;
-}
-
-Vector3 PhysicsSystem::MinkowskiDifference(const Line& line, const Body& bodyB, const Vector3& direction) const
-{
-    Vector3 directionNormalized = direction;
-    directionNormalized.Normalize();
-    
-    const Vector3 furthestPointA = Support(line, directionNormalized);
-    
-    Vector3 furthestPointB;
-    Vector3 transformedDirectionB = Vector3::TransformNormal(-directionNormalized, bodyB.GetTransform().ComponentTransform.GetWorldMatrix().Invert());
-    transformedDirectionB.Normalize();
-    std::visit([&transformedDirectionB, &furthestPointB](auto&& arg)
-    {
-        furthestPointB = arg.FurthestPointInDirection(transformedDirectionB);
-    },
-    bodyB.GetCollider().Shape);
-
-    furthestPointB = bodyB.GetTransform().ComponentTransform * furthestPointB;
-
-    return furthestPointA - furthestPointB;
-}
-
 bool PhysicsSystem::GJKSimplexContainsOrigin(DArray<GJKVertex, 4>& simplex, Vector3& direction) const
 {
     switch (simplex.Count())
@@ -1036,7 +1799,7 @@ bool PhysicsSystem::TetrahedronContainsOrigin(const EPAVertexArray& polytopeVert
 }
 
 template <typename ShapeProxyType>
-PhysicsSystem::Hit PhysicsSystem::ExpandingPolytopeAlgorithm(const ShapeProxyType& shape, const Body& bodyB, DArray<GJKVertex, 4>& simplex) const
+PhysicsSystem::Hit PhysicsSystem::ExpandingPolytopeAlgorithm(const ShapeProxyType& shape, const Body& bodyB, DArray<GJKVertex, 4>& simplex, SupportHints& hints) const
 {
     EPAVertexArray vertices(simplex);
     if (TetrahedronContainsOrigin(vertices))
@@ -1084,6 +1847,7 @@ PhysicsSystem::Hit PhysicsSystem::ExpandingPolytopeAlgorithm(const ShapeProxyTyp
     uint32 closestTriangleIndex = 0;
         
     EPASilhouetteArray silhouetteArray;
+    uint32 expansionCount = 0;
 
     while (!queue.empty())
     {
@@ -1102,9 +1866,10 @@ PhysicsSystem::Hit PhysicsSystem::ExpandingPolytopeAlgorithm(const ShapeProxyTyp
         }
         
         const Vector3 v = triangle.ClosestPoint;
+        ++expansionCount;
         
-        const Vector3 furthestPointA = Support(shape, v);
-        const Vector3 furthestPointB = Support(bodyB, -v);
+        const Vector3 furthestPointA = Support(shape, v, hints.VertexA);
+        const Vector3 furthestPointB = Support(bodyB, -v, hints.VertexB);
 
         const Vector3 w = furthestPointA - furthestPointB;
 
@@ -1121,13 +1886,7 @@ PhysicsSystem::Hit PhysicsSystem::ExpandingPolytopeAlgorithm(const ShapeProxyTyp
         if (current.Distance < distance)
         {
             triangle.Valid = false;
-            LOG(L"Invalidating triangle {} {} {}",
-                triangle.Indices[0],
-                triangle.Indices[1],
-                triangle.Indices[2]
-            );
 
-            LOG(L"Begin silhouette calculation");
             silhouetteArray.Clear();
             for (uint8 i = 0; i < 3; ++i)
             {
@@ -1138,7 +1897,6 @@ PhysicsSystem::Hit PhysicsSystem::ExpandingPolytopeAlgorithm(const ShapeProxyTyp
                 
                 EPASilhouette(*triangle.AdjacentTriangles[i], triangle.AdjacentTriangles[i]->IndexOfAdjacent(triangle), w, silhouetteArray);
             }
-            LOG(L"End silhouette calculation");
 
             if (silhouetteArray.Count() % 3 != 0)
             {
@@ -1222,6 +1980,8 @@ PhysicsSystem::Hit PhysicsSystem::ExpandingPolytopeAlgorithm(const ShapeProxyTyp
         }
     }
 
+    AddToStat(_epaExpansionCount, expansionCount);
+
     EPATriangle& closestTriangle = mesh[closestTriangleIndex];
     
     Hit hit;
@@ -1245,10 +2005,6 @@ PhysicsSystem::Hit PhysicsSystem::ExpandingPolytopeAlgorithm(const ShapeProxyTyp
     // todo once we implement hit events, we will need to broadcast both hits
     // const Vector3 contactPointB = baryCoords.x * vA.SupportB + baryCoords.y * vB.SupportB + baryCoords.z * vC.SupportB;
 
-    // LOG(L"Closest point: {}", closestTriangle.ClosestPoint);
-    // LOG(L"Contact point A: {}", contactPointA);
-    // LOG(L"Contact point B: {}", contactPointB);
-
     if (hit.ImpactNormal == Vector3::Zero)
     {
         hit.ImpactNormal = contactPointA;
@@ -1268,9 +2024,11 @@ PhysicsSystem::Hit PhysicsSystem::ExpandingPolytopeAlgorithm(const ShapeProxyTyp
 template <typename ShapeProxyType>
 PhysicsSystem::Hit PhysicsSystem::GilbertJohnsonKeerthi(const ShapeProxyType& shape, const Body& bodyB) const
 {
+    SupportHints hints;
+
     const Vector3 initialDirection = Vector3::UnitX;
-    Vector3 furthestPointA = Support(shape, initialDirection);
-    Vector3 furthestPointB = Support(bodyB, -initialDirection);
+    Vector3 furthestPointA = Support(shape, initialDirection, hints.VertexA);
+    Vector3 furthestPointB = Support(bodyB, -initialDirection, hints.VertexB);
 
     Vector3 difference = furthestPointA - furthestPointB;
 
@@ -1278,17 +2036,20 @@ PhysicsSystem::Hit PhysicsSystem::GilbertJohnsonKeerthi(const ShapeProxyType& sh
 
     Vector3 direction = -difference;
     direction.Normalize();
+
+    uint32 iterationCount = 0;
     while (true)
     {
-        furthestPointA = Support(shape, direction);
-        furthestPointB = Support(bodyB, -direction);
+        ++iterationCount;
+        direction.Normalize();
 
-        difference = furthestPointA - furthestPointB;
+        furthestPointA = Support(shape, direction, hints.VertexA);
+        furthestPointB = Support(bodyB, -direction, hints.VertexB);
 
-        difference = MinkowskiDifference(shape, bodyB, direction);
+        difference = furthestPointA - furthestPointB;
         if (difference.Dot(direction) <= 0.0f)
         {
-            // LOG(L"Hit not found");
+            AddToStat(_gjkIterationCount, iterationCount);
             return {};
         }
 
@@ -1296,10 +2057,10 @@ PhysicsSystem::Hit PhysicsSystem::GilbertJohnsonKeerthi(const ShapeProxyType& sh
 
         if (GJKSimplexContainsOrigin(simplex, direction))
         {
-            // LOG(L"Hit found");
+            AddToStat(_gjkIterationCount, iterationCount);
             if (simplex.Count() == 4)
             {
-                return ExpandingPolytopeAlgorithm(shape, bodyB, simplex);
+                return ExpandingPolytopeAlgorithm(shape, bodyB, simplex, hints);
             }
 
             // todo support for dot, line and triangle simplex expansion to tetrahedron
@@ -1381,11 +2142,6 @@ void PhysicsSystem::EPASilhouette(EPATriangle& triangle, uint8 adjIndex, const V
     }
 
     triangle.Valid = false;
-    LOG(L"Invalidating triangle {} {} {}",
-        triangle.Indices[0],
-        triangle.Indices[1],
-        triangle.Indices[2]
-    );
 
     if (EPATriangle* adjTriangle = triangle.AdjacentTriangles[(adjIndex + 1) % 3])
     {
@@ -1400,21 +2156,70 @@ void PhysicsSystem::EPASilhouette(EPATriangle& triangle, uint8 adjIndex, const V
 
 void PhysicsSystem::ForEachOverlappingEntityInternal(Entity& entity, const std::function<bool(const Entity& overlapped)>& func) const
 {
+    const CRigidBody* rigidBody = entity.GetChecked<CRigidBody>(Archetype(entity));
+    if (rigidBody == nullptr)
+    {
+        return;
+    }
+
+    const Body& body = rigidBody->PhysicsBody;
+    ForEachBodyAt(body.AABB, body.CollisionMask, [&body, &func](const Body& otherBody)
+    {
+        if (otherBody.Entity == body.Entity || !body.CanCollideWith(otherBody) || !otherBody.AABB.Overlap(body.AABB))
+        {
+            return true;
+        }
+
+        return func(*otherBody.Entity);
+    });
 }
 
-void PhysicsSystem::ForEachEntityInSphereInternal(const Vector3& location, float radius, const std::function<bool(const Entity& overlapped)>& func) const
+void PhysicsSystem::ForEachEntityInSphereInternal(const Vector3& location, float radius, uint32 layerMask, const std::function<bool(const Entity& overlapped)>& func) const
 {
     BoundingBox aabb(location - Vector3(radius), location + Vector3(radius));
-    ForEachCellAt(aabb, [this, &func](const Cell& cell, uint32 index)
+
+    // Boxes are tested exactly in one batch after the broad phase query, other shapes only by their bounds
+    DArray<const Body*> boxBodies;
+    DArray<OrientedBox> boxes;
+    bool isStopped = false;
+
+    ForEachBodyAt(aabb, layerMask, [&aabb, &func, &boxBodies, &boxes, &isStopped](const Body& body)
     {
-        for (const Body* body : cell.Bodies)
+        if (!body.AABB.Overlap(aabb))
         {
-            if (!func(*body->Entity))
-            {
-                return false;
-            }
+            return true;
         }
 
-        return true;
+        if (body.IsBox)
+        {
+            boxBodies.Add(&body);
+            boxes.Add(body.WorldBox);
+            return true;
+        }
+
+        isStopped = !func(*body.Entity);
+        return !isStopped;
     });
+
+    if (isStopped || boxes.IsEmpty())
+    {
+        return;
+    }
+
+    DArray<bool> overlaps;
+    overlaps.Reserve(boxes.Count());
+    for (uint32 i = 0; i < boxes.Count(); ++i)
+    {
+        overlaps.Add(false);
+    }
+
+    CollisionKernels::SphereBox(location, radius, boxes.GetData(), static_cast<uint32>(boxes.Count()), overlaps.GetData());
+
+    for (uint32 i = 0; i < boxBodies.Count(); ++i)
+    {
+        if (overlaps[i] && !func(*boxBodies[i]->Entity))
+        {
+            return;
+        }
+    }
 }
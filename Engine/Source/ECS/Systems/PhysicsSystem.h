@@ -3,7 +3,15 @@
 #include "ECS/Components/CCollider.h"
 #include "ECS/Components/CRigidBody.h"
 #include "ECS/Components/CTransform.h"
+#include "IDGenerator.h"
+#include "SpinLock.h"
+#include "Physics/BroadPhase.h"
+#include "Physics/ContactManifold.h"
+#include "Physics/PhysicsSnapshot.h"
+#include "Physics/PhysicsStats.h"
 #include "ECS/Systems/System.h"
+#include <atomic>
+#include <span>
 #include "ECS/Systems/PhysicsSystem.reflection.h"
 
 REFLECTED()
@@ -23,6 +31,29 @@ public:
 
     using EventHit = Event<TypeSet<CRigidBody>, Hit>;
     EventDispatcher<TypeSet<CRigidBody>, Hit> OnHit;
+
+    enum class EQueryMode : uint8
+    {
+        // Hit closest to the start of the query
+        Closest,
+        // First hit found, for visibility checks that don't care what was hit
+        Any
+    };
+
+    struct QueryFilter
+    {
+        EQueryMode Mode = EQueryMode::Closest;
+        // Bits of collision layers the query hits, other layers are skipped by the broad phase
+        uint32 LayerMask = BroadPhase::AllLayers;
+        const Entity* IgnoredEntity = nullptr;
+    };
+
+    struct SphereCastQuery
+    {
+        Vector3 Start;
+        Vector3 End;
+        float Radius = 0.0f;
+    };
     
 public:
     PhysicsSystem() = default;
@@ -30,7 +61,22 @@ public:
     
     Hit Raycast(const Vector3& start, const Vector3& direction, float distance) const;
     Hit Raycast(const Vector3& start, const Vector3& end) const;
-
+    Hit Raycast(const Vector3& start, const Vector3& end, const QueryFilter& filter) const;
+
+    /**
+     * Casts rays in parallel, outHits[i] receives result of rays[i].
+     */
+    void RaycastBatch(std::span<const Line> rays, std::span<Hit> outHits, const QueryFilter& filter = {}) const;
+
+    /**
+     * Sweeps spheres in parallel, outHits[i] receives result of casts[i]. Shapes are treated as their boxes grown by
+     * the radius, so hits near edges and corners are reported slightly early.
+     */
+    void SphereCastBatch(std::span<const SphereCastQuery> casts, std::span<Hit> outHits, const QueryFilter& filter = {}) const;
+
+    /**
+     * Calls func for entities whose bodies overlap the body of entity and collide with it according to their layers.
+     */
     template <TSystem SystemType> // todo check compatibility between systems, SystemType must not be compatible with PhysicsSystem (must not be executed in parallel)
     void ForEachOverlappingEntity(Entity& entity, const std::function<bool(const Entity& overlapped)>& func, PassKey<SystemType>) const
     {
@@ -38,13 +84,67 @@ public:
     }
 
     template <TSystem SystemType> // todo check compatibility between systems, SystemType must not be compatible with PhysicsSystem (must not be executed in parallel)
-    void ForEachEntityInSphere(const Vector3& location, float radius, const std::function<bool(const Entity& overlapped)>& func, PassKey<SystemType>) const
+    void ForEachEntityInSphere(const Vector3& location, float radius, const std::function<bool(const Entity& overlapped)>& func, PassKey<SystemType>, uint32 layerMask = BroadPhase::AllLayers) const
     {
-        ForEachEntityInSphereInternal(location, radius, func);
+        ForEachEntityInSphereInternal(location, radius, layerMask, func);
     }
 
     void SetSimulationEnabled(bool value);
     bool IsSimulationEnabled() const;
+
+    void SetBroadPhaseType(EBroadPhaseType type);
+    EBroadPhaseType GetBroadPhaseType() const;
+
+    /**
+     * Iterations of the contact solver per step, more iterations let stacks settle faster at a higher cost.
+     */
+    void SetSolverIterations(uint32 velocityIterations, uint32 positionIterations);
+    uint32 GetVelocityIterations() const;
+    uint32 GetPositionIterations() const;
+
+    /**
+     * In deterministic mode only whole fixed steps are simulated and the remaining time is carried over to the next
+     * tick, bodies and contact pairs are processed in order of entity IDs and a state hash is recorded after each step,
+     * so replaying the same inputs gives bit-identical results regardless of frame rate and worker count.
+     */
+    void SetDeterministic(bool value);
+    bool IsDeterministic() const;
+
+    /**
+     * Hashes of the state after each step simulated by the last tick, only recorded in deterministic mode.
+     */
+    std::span<const uint64> GetStepHashes() const;
+    uint64 GetStepCount() const;
+
+    /**
+     * Hashes transforms, velocities and states of all bodies in order of entity IDs.
+     */
+    uint64 ComputeStateHash() const;
+
+    /**
+     * Captures bodies, contacts and sleeping islands between ticks, for rollback or to start a scenario mid-game.
+     */
+    void SaveSnapshot(PhysicsSnapshot& outSnapshot) const;
+
+    /**
+     * Restores state saved by SaveSnapshot without rebuilding the broad phase, bodies are moved in place.
+     * Bodies created or destroyed since the snapshot are left as they are, returns false if any saved body is gone.
+     */
+    bool RestoreSnapshot(const PhysicsSnapshot& snapshot);
+
+    /**
+     * Stats are collected for each step while enabled, the most recent steps are kept in a ring buffer.
+     */
+    void SetStatsEnabled(bool value);
+    bool IsStatsEnabled() const;
+
+    const PhysicsStepStats& GetLastStepStats() const;
+
+    /**
+     * Copies kept stats to outStats, oldest step first.
+     */
+    void GetStatsHistory(DArray<PhysicsStepStats>& outStats) const;
+    bool DumpStatsToCSV(const std::filesystem::path& path) const;
     
     // System
 public:
@@ -70,45 +170,107 @@ private:
     const Vector3 _gravity = Vector3(0.0f, 0.0f, -9.81f);
     
     static constexpr uint32 _cellCountX = 100;
-    static constexpr uint32 _cellSSOCapacity = 256;
 
-    Vector3 _cellSize;
-    
-    struct CellIndex
-    {
-        uint32 X;
-        uint32 Y;
-        uint32 Z;
-    };
+    static constexpr double _stepDuration = 1.0 / 120.0;
 
-    struct Cell
-    {
-    public:
-        CellIndex Index;
-        DArray<Body*, _cellSSOCapacity> Bodies;
-        uint32 StaticBodyCount = 0;
-        uint32 DormantBodyCount = 0;
-        uint32 DynamicBodyCount = 0;
+    bool _isDeterministic = false;
+    // Time left over from the last tick in deterministic mode, less than one step
+    double _fixedStepRemainder = 0.0;
+    uint64 _stepCount = 0;
+    DArray<uint64> _stepHashes;
 
-    public:
-        uint32 AddBody(Body& body, ERigidBodyState bodyType);
-        void RemoveBody(const PhysicsSystem& system, uint32 index);
-        
-        void SetBodyState(uint32 index, ERigidBodyState bodyType);
-    };
-    
-    std::unordered_map<uint32, Cell> _cells;
+    static constexpr uint32 _statsHistorySize = 600;
+
+    bool _isStatsEnabled = false;
+    PhysicsStepStats _currentStats;
+    DArray<PhysicsStepStats> _statsHistory;
+    uint32 _statsHistoryNext = 0;
+    // Incremented from narrow phase and query jobs, moved to _currentStats at the end of each step
+    mutable std::atomic<uint64> _gjkIterationCount = 0;
+    mutable std::atomic<uint64> _epaExpansionCount = 0;
+
+    // Work items per job in parallel stages of the pipeline
+    static constexpr uint32 _bodiesPerBatch = 64;
+    static constexpr uint32 _pairsPerBatch = 16;
+    static constexpr uint32 _queriesPerBatch = 32;
+
+    // Registered bodies indexed by Body::BodyIndex, destroyed bodies leave a nullptr until their index is reused
+    DArray<Body*> _bodies;
+    DArray<uint32> _freeBodyIndices;
 
-    // BodyA is the entity with the lower ID
+    // Items are body indices, changes are committed after each step and before the first step of a tick
+    EBroadPhaseType _broadPhaseType = EBroadPhaseType::DynamicTree;
+    std::unique_ptr<BroadPhase> _broadPhase;
+
+    // BodyA is always awake in current step, if both bodies are awake BodyA is the entity with the lower ID
     struct CollisionPair
     {
+    public:
         Body* BodyA;
         Body* BodyB;
+
+    public:
+        auto operator<=>(const CollisionPair& other) const = default;
     };
 
-    std::unordered_map<Entity*, CollisionPair> _overlaps;
-    
     DArray<CollisionPair> _narrowPhaseInputPairs;
+    // Narrow phase result for each pair in _narrowPhaseInputPairs
+    DArray<Hit> _narrowPhaseHits;
+    SpinLock _broadPhaseLock;
+
+    // Manifolds keyed by body indices of the pair, removed after a step in which the pair wasn't in contact
+    std::unordered_map<uint64, ContactManifold> _manifolds;
+    // Manifold of each pair in _narrowPhaseInputPairs, nullptr if the pair isn't in contact
+    DArray<ContactManifold*> _pairManifolds;
+
+    uint32 _velocityIterations = 8;
+    uint32 _positionIterations = 3;
+    float _contactFriction = 0.5f;
+    // Penetration left unresolved, so resting bodies stay in contact and keep their manifolds between steps
+    float _contactSlop = 0.005f;
+    // Fraction of the remaining penetration resolved by each position iteration, and the most it may move a body
+    float _positionCorrectionFactor = 0.2f;
+    float _maxPositionCorrection = 0.2f;
+    // Contacts approaching slower than this don't bounce, so resting bodies don't jitter
+    float _restitutionVelocityThreshold = 1.0f;
+    // Manifold points that separate or slide apart further than this are dropped
+    float _contactBreakingDistance = 0.02f;
+
+    // Bodies slower than these thresholds for _sleepStepCount consecutive steps are put to sleep, along with
+    // every other body in their island
+    float _sleepLinearVelocityThreshold = 0.05f;
+    float _sleepAngularVelocityThreshold = 0.05f;
+    uint32 _sleepStepCount = 60;
+
+    // Bodies moving further than this fraction of their smallest AABB size in one step are swept against everything
+    // along their motion, so they can't tunnel through thin geometry
+    float _continuousCollisionMotionThreshold = 0.5f;
+    // How far a swept body may move into the obstacle it hits, so narrow phase of the same step registers the contact
+    float _continuousCollisionPenetration = 0.01f;
+
+    struct AwakeBody
+    {
+        Body* PhysicsBody;
+        // AABB at the start of current step, broad phase tests the volume swept from it
+        BoundingBox StartAABB;
+        bool IsOutOfBounds = false;
+        bool NeedsContinuousCollision = false;
+        // Fraction of the motion in current step at which the body first touches another body
+        float TimeOfImpact = 1.0f;
+    };
+
+    // Dynamic bodies simulated in current step, islands are built from these and contact pairs between them
+    DArray<AwakeBody> _awakeBodies;
+    DArray<uint32> _islandParents;
+    DArray<uint32> _islandSleepingIDs;
+    DArray<bool> _islandCanSleep;
+
+    // Indices of valid hits sorted by island, each island is solved as one job
+    DArray<uint32> _islandContacts;
+    DArray<uint32> _islandContactRanges;
+
+    std::unordered_map<uint32, DArray<Body*>> _sleepingIslands;
+    IDGenerator<uint32> _sleepingIslandIDGenerator;
 
 private:
     struct GJKVertex
@@ -117,6 +279,13 @@ private:
         Vector3 SupportA;
         Vector3 SupportB;
     };
+
+    // Last support vertex of each shape in a collision check, hill climbing on mesh hulls starts from these
+    struct SupportHints
+    {
+        uint32 VertexA = 0;
+        uint32 VertexB = 0;
+    };
     
     using EPAVertexArray = DArray<GJKVertex, 16>;
     
@@ -165,37 +334,63 @@ private:
     };
     
     using EPASilhouetteArray = DArray<EPASilhouetteEntry, 8>;
-    
-private:
-    CellIndex GetCellIndex(const Vector3& location) const;
-    Cell& GetCellAt(const Vector3& location);
-    const Cell& GetCellAt(const Vector3& location) const;
-    Cell& GetCellAt(const CellIndex& index);
-    const Cell& GetCellAt(const CellIndex& index) const;
-    Cell* GetCellAtIfExists(const CellIndex& index);
-    const Cell* GetCellAtIfExists(const CellIndex& index) const;
-
-    uint32 GetRelativeIndexOf(const Body& body, const Cell& cell) const;
-
-    void ForEachCellAt(const BoundingBox& aabb, const std::function<bool(Cell& cell, uint32 index)>& func);
-    void ForEachCellAt(const BoundingBox& aabb, const std::function<bool(const Cell& cell, uint32 index)>& func) const;
 
-    const Cell& GetCellAtImplementation(const CellIndex& index) const;
-    const Cell* GetCellAtIfExistsImplementation(const CellIndex& index) const;
+    // Reused by consecutive casts of one job
+    struct CastScratch
+    {
+        DArray<Body*> Bodies;
+        DArray<OrientedBox> Boxes;
+        DArray<RayContact> Contacts;
+    };
     
-    void Move(CRigidBody& rigidBody, const Vector3& currentLocation, const Vector3& newLocation, double deltaTime);
-    void Move(CRigidBody& rigidBody, const BoundingBox& current, const BoundingBox& next);
-
-    void BroadPhase(Body& body, Cell& cell);
+private:
+    void CreateBroadPhase();
+    void SortAwakeBodies();
+
+    template <typename FuncType>
+    void RunStage(EPhysicsStage stage, FuncType&& func);
+    void CollectStepStats();
+    void AddToStat(std::atomic<uint64>& stat, uint32 value) const;
+    void ForEachBodyAt(const BoundingBox& aabb, uint32 layerMask, const std::function<bool(Body& body)>& func) const;
+
+    /**
+     * Casts a ray if radius is 0, otherwise sweeps a sphere along line.
+     */
+    Hit Cast(const Line& line, float radius, const QueryFilter& filter, CastScratch& scratch) const;
+
+    void Integrate(double deltaTime);
+    void ContinuousCollision();
+    float FindTimeOfImpact(const AwakeBody& awakeBody, DArray<OrientedBox>& targets, DArray<RayContact>& contacts) const;
+    void BroadPhase();
+    void BroadPhase(const AwakeBody& awakeBody, DArray<CollisionPair>& outPairs) const;
     void NarrowPhase();
+    void UpdateManifolds();
+    void Solve();
+    void WriteBack();
+
+    CollisionPair MakeCollisionPair(Body& awakeBody, Body& otherBody) const;
+    static uint64 MakeManifoldKey(const Body& bodyA, const Body& bodyB);
+
+    void UpdateSleepState(Body& body);
+    void BuildIslands();
+    void UpdateIslands();
+    uint32 FindIslandRoot(uint32 index);
+    bool IsAwakeInCurrentStep(const Body& body) const;
+    void WakeBody(Body& body);
     
-    void ProcessHit(const Body& bodyA, const Hit& hit);
-
-    Vector3 Support(const Body& body, const Vector3& directionNormalized) const;
-    Vector3 Support(const Line& line, const Vector3& directionNormalized) const;
+    void PrepareContacts(ContactManifold& manifold) const;
+    void WarmStartContacts(ContactManifold& manifold) const;
+    void SolveContactVelocities(ContactManifold& manifold) const;
+    void SolveContactPositions(ContactManifold& manifold) const;
+    void ApplyContactImpulse(const ContactManifold& manifold, const ContactPoint& point, const Vector3& impulse) const;
+    Vector3 GetContactVelocity(const ContactManifold& manifold, const ContactPoint& point) const;
+
+    void MoveBody(Body& body, const Vector3& offset) const;
+    void UpdateBodyTransform(Body& body) const;
+
+    Vector3 Support(const Body& body, const Vector3& directionNormalized, uint32& vertexHint) const;
+    Vector3 Support(const Line& line, const Vector3& directionNormalized, uint32& vertexHint) const;
     
-    Vector3 MinkowskiDifference(const Body& bodyA, const Body& bodyB, const Vector3& direction) const;
-    Vector3 MinkowskiDifference(const Line& line, const Body& bodyB, const Vector3& direction) const;
     bool GJKSimplexContainsOrigin(DArray<GJKVertex, 4>& simplex, Vector3& direction) const;
     bool GJKLine(DArray<GJKVertex, 4>& simplex, Vector3& direction) const;
     bool GJKTriangle(DArray<GJKVertex, 4>& simplex, Vector3& direction) const;
@@ -203,7 +398,7 @@ private:
     bool TetrahedronContainsOrigin(const EPAVertexArray& polytopeVertices) const;
 
     template <typename ShapeProxyType>
-    Hit ExpandingPolytopeAlgorithm(const ShapeProxyType& shape, const Body& bodyB, DArray<GJKVertex, 4>& simplex) const;
+    Hit ExpandingPolytopeAlgorithm(const ShapeProxyType& shape, const Body& bodyB, DArray<GJKVertex, 4>& simplex, SupportHints& hints) const;
 
     template <typename ShapeProxyType>
     Hit GilbertJohnsonKeerthi(const ShapeProxyType& shape, const Body& bodyB) const;
@@ -214,5 +409,5 @@ private:
     void EPASilhouette(EPATriangle& triangle, uint8 adjIndex, const Vector3& w, EPASilhouetteArray& silhouetteSet) const;
 
     void ForEachOverlappingEntityInternal(Entity& entity, const std::function<bool(const Entity& overlapped)>& func) const;
-    void ForEachEntityInSphereInternal(const Vector3& location, float radius, const std::function<bool(const Entity& overlapped)>& func) const;
+    void ForEachEntityInSphereInternal(const Vector3& location, float radius, uint32 layerMask, const std::function<bool(const Entity& overlapped)>& func) const;
 };
@@ -2,6 +2,8 @@
 
 #include "HealthSystem.h"
 #include "ECS/Systems/PhysicsSystem.h"
+#include "Math/Float4.h"
+#include <bit>
 
 ProjectileSystem::ProjectileSystem(const ProjectileSystem& other) : System(other)
 {
@@ -20,11 +22,12 @@ void ProjectileSystem::OnEntityCreated(const Archetype& archetype, Entity& entit
 
     CacheArchetype(archetype);
 
-    const CProjectile& projectile = Get<const CProjectile>(entity);
+    CProjectile& projectile = Get<CProjectile>(entity);
     CRigidBody& rigidBody = Get<CRigidBody>(entity);
     const CTransform& transform = Get<const CTransform>(entity);
 
-    rigidBody.Velocity = transform.ComponentTransform.GetForwardVector() * projectile.Speed;
+    projectile.Velocity = transform.ComponentTransform.GetForwardVector() * projectile.Speed;
+    rigidBody.Velocity = projectile.Velocity;
 }
 
 void ProjectileSystem::Tick(double deltaTime)
@@ -55,7 +58,7 @@ void ProjectileSystem::Tick(double deltaTime)
                     }
                 }
 
-                GetWorld().DestroyEntityAsync(*eventData.Entity);
+                GetWorld().ReleaseEntityAsync(*eventData.Entity);
             }
         }
     }
@@ -65,25 +68,58 @@ void ProjectileSystem::ProcessEntityList(EntityList& entityList, double deltaTim
 {
     System::ProcessEntityList(entityList, deltaTime);
 
-    entityList.ForEach([this, deltaTime](Entity& entity)
+    _columns.Entities.Clear();
+    _columns.LocationX.Clear();
+    _columns.LocationY.Clear();
+    _columns.LocationZ.Clear();
+    _columns.VelocityX.Clear();
+    _columns.VelocityY.Clear();
+    _columns.VelocityZ.Clear();
+    _columns.TimeAlive.Clear();
+    _columns.Lifetime.Clear();
+    _expiredIndices.Clear();
+
+    entityList.ForEach([this](Entity& entity)
     {
-        CProjectile& projectile = Get<CProjectile>(entity);
-        CTransform& transform = Get<CTransform>(entity);
+        const CProjectile& projectile = Get<const CProjectile>(entity);
+        const Vector3 location = Get<const CTransform>(entity).ComponentTransform.GetWorldLocation();
+
+        _columns.Entities.Add(&entity);
+        _columns.LocationX.Add(location.x);
+        _columns.LocationY.Add(location.y);
+        _columns.LocationZ.Add(location.z);
+        _columns.VelocityX.Add(projectile.Velocity.x);
+        _columns.VelocityY.Add(projectile.Velocity.y);
+        _columns.VelocityZ.Add(projectile.Velocity.z);
+        _columns.TimeAlive.Add(projectile.TimeAlive);
+        _columns.Lifetime.Add(projectile.Lifetime);
 
-        projectile.TimeAlive += static_cast<float>(deltaTime);
-        if (projectile.TimeAlive >= projectile.Lifetime)
+        return true;
+    });
+
+    Integrate(_columns, static_cast<float>(deltaTime), _expiredIndices);
+
+    // Expired projectiles don't move, so only the rest are written back and fire transform changes
+    uint32 nextExpired = 0;
+    for (uint32 i = 0; i < _columns.Entities.Count(); ++i)
+    {
+        if (nextExpired < _expiredIndices.Count() && _expiredIndices[nextExpired] == i)
         {
-            GetWorld().DestroyEntityAsync(entity);
-            return true;
+            ++nextExpired;
+            continue;
         }
-        
-        const Vector3 velocity = transform.ComponentTransform.GetForwardVector() * projectile.Speed;
-        transform.ComponentTransform.SetWorldLocation(
-            transform.ComponentTransform.GetWorldLocation() + velocity * static_cast<float>(deltaTime)
+
+        Entity& entity = *_columns.Entities[i];
+        Get<CProjectile>(entity).TimeAlive = _columns.TimeAlive[i];
+        Get<CTransform>(entity).ComponentTransform.SetWorldLocation(
+            Vector3(_columns.LocationX[i], _columns.LocationY[i], _columns.LocationZ[i])
         );
+    }
 
-        return true;
-    });
+    for (const uint32 index : _expiredIndices)
+    {
+        GetWorld().ReleaseEntityAsync(*_columns.Entities[index]);
+    }
 }
 
 void ProjectileSystem::Shutdown()
@@ -92,3 +128,46 @@ void ProjectileSystem::Shutdown()
 
     //GetWorld().FindSystem<PhysicsSystem>()->OnHit.UnregisterListener(_onHitHandle);
 }
+
+void ProjectileSystem::Integrate(ProjectileColumns& columns, float deltaTime, DArray<uint32>& outExpiredIndices)
+{
+    const uint32 count = static_cast<uint32>(columns.Entities.Count());
+    float* locations[3] = {columns.LocationX.GetData(), columns.LocationY.GetData(), columns.LocationZ.GetData()};
+    const float* velocities[3] = {columns.VelocityX.GetData(), columns.VelocityY.GetData(), columns.VelocityZ.GetData()};
+    float* timesAlive = columns.TimeAlive.GetData();
+    const float* lifetimes = columns.Lifetime.GetData();
+
+    const Float4 step(deltaTime);
+
+    uint32 i = 0;
+    for (; i + Float4::LaneCount <= count; i += Float4::LaneCount)
+    {
+        for (uint32 axis = 0; axis < 3; ++axis)
+        {
+            const Float4 location = Float4::Load(locations[axis] + i) + Float4::Load(velocities[axis] + i) * step;
+            location.Store(locations[axis] + i);
+        }
+
+        const Float4 timeAlive = Float4::Load(timesAlive + i) + step;
+        timeAlive.Store(timesAlive + i);
+
+        for (uint32 expired = static_cast<uint32>(Float4::MoveMask(timeAlive >= Float4::Load(lifetimes + i))); expired != 0; expired &= expired - 1)
+        {
+            outExpiredIndices.Add(i + static_cast<uint32>(std::countr_zero(expired)));
+        }
+    }
+
+    for (; i < count; ++i)
+    {
+        for (uint32 axis = 0; axis < 3; ++axis)
+        {
+            locations[axis][i] += velocities[axis][i] * deltaTime;
+        }
+
+        timesAlive[i] += deltaTime;
+        if (timesAlive[i] >= lifetimes[i])
+        {
+            outExpiredIndices.Add(i);
+        }
+    }
+}
@@ -23,8 +23,34 @@ public:
     virtual void ProcessEntityList(EntityList& entityList, double deltaTime) override;
     virtual void Shutdown() override;
 
+private:
+    // Projectiles of the entity list being processed laid out in columns, so movement and lifetimes are advanced
+    // by one SIMD pass instead of per entity
+    struct ProjectileColumns
+    {
+        DArray<Entity*> Entities;
+        DArray<float> LocationX;
+        DArray<float> LocationY;
+        DArray<float> LocationZ;
+        DArray<float> VelocityX;
+        DArray<float> VelocityY;
+        DArray<float> VelocityZ;
+        DArray<float> TimeAlive;
+        DArray<float> Lifetime;
+    };
+
 private:
     PROPERTY()
     PhysicsSystem::EventHit _onHit;
     EventHandle _onHitHandle;
+
+    ProjectileColumns _columns;
+    DArray<uint32> _expiredIndices;
+
+private:
+    /**
+     * Advances locations and lifetimes of all projectiles in columns, adds indices of expired ones to outExpiredIndices
+     * in ascending order.
+     */
+    static void Integrate(ProjectileColumns& columns, float deltaTime, DArray<uint32>& outExpiredIndices);
 };
@@ -2,6 +2,7 @@
 #include "ECS/EntityTemplate.h"
 #include "ECS/Components/CTeamMember.h"
 #include "ECS/Components/CTransform.h"
+#include "Math/Math.h"
 
 SpawnerSystem::SpawnerSystem(const SpawnerSystem& other) : System(other)
 {
@@ -17,6 +18,13 @@ void SpawnerSystem::OnEntityCreated(const Archetype& archetype, Entity& entity)
     spawner.SpawnTransform.SetParent(&transform.ComponentTransform);
 }
 
+void SpawnerSystem::Tick(double deltaTime)
+{
+    System::Tick(deltaTime);
+
+    IssueSpawns();
+}
+
 void SpawnerSystem::ProcessEntityList(EntityList& entityList, double deltaTime)
 {
     System::ProcessEntityList(entityList, deltaTime);
@@ -36,29 +44,14 @@ void SpawnerSystem::ProcessEntityList(EntityList& entityList, double deltaTime)
         {
             spawner.SpawnTimer = 0.0;
 
-            AssetPtr<EntityTemplate> spawnTemplate = spawner.SpawnTemplate;
-            const Transform& spawnTransform = spawner.SpawnTransform;
-            const uint32 teamID = Get<const CTeamMember>(entity).TeamID;
-            
-            GetWorld().CreateEntityAsync(
-                spawner.SpawnTemplate,
-                [spawnTransform, teamID, spawnTemplate](Entity& newEntity, const Archetype& archetype)
-                {
-                    CTransform& transform = newEntity.Get<CTransform>(archetype);
-                    transform.ComponentTransform.SetWorldLocation(spawnTransform.GetWorldLocation());
-
-                    CTeamMember* teamMember = newEntity.GetChecked<CTeamMember>(archetype);
-                    if (teamMember != nullptr)
-                    {
-                        teamMember->TeamID = teamID;
-                    }
-
-                    return &newEntity;
-                },
-                [](Entity& entity, const Archetype& archetype)
-                {
-                }
-            );
+            const SharedObjectPtr<EntityTemplate> spawnTemplate = spawner.SpawnTemplate;
+            const auto [it, isNew] = _spawnBatchIndices.emplace(spawnTemplate.get(), static_cast<uint32>(_spawnBatches.Count()));
+            if (isNew)
+            {
+                _spawnBatches.Add({spawnTemplate, {}});
+            }
+
+            _spawnBatches[it->second].Requests.Add({spawner.SpawnTransform.GetWorldLocation(), Get<const CTeamMember>(entity).TeamID});
 
             ++spawner.SpawnCount;
         }
@@ -66,3 +59,61 @@ void SpawnerSystem::ProcessEntityList(EntityList& entityList, double deltaTime)
         return true;
     });
 }
+
+void SpawnerSystem::IssueSpawns()
+{
+    uint32 remainingBudget = _spawnBudget;
+
+    const uint32 batchCount = static_cast<uint32>(_spawnBatches.Count());
+    for (uint32 i = 0; i < batchCount && remainingBudget > 0; ++i)
+    {
+        SpawnBatch& batch = _spawnBatches[(_nextSpawnBatch + i) % batchCount];
+        if (batch.Requests.IsEmpty())
+        {
+            continue;
+        }
+
+        const uint32 requestCount = static_cast<uint32>(batch.Requests.Count());
+        const uint32 spawnCount = Math::Min(requestCount, remainingBudget);
+        remainingBudget -= spawnCount;
+
+        // Oldest requests are spawned first
+        DArray<SpawnRequest> requests;
+        requests.Reserve(spawnCount);
+        for (uint32 request = 0; request < spawnCount; ++request)
+        {
+            requests.Add(batch.Requests[request]);
+        }
+
+        for (uint32 request = spawnCount; request < requestCount; ++request)
+        {
+            batch.Requests[request - spawnCount] = batch.Requests[request];
+        }
+
+        for (uint32 request = 0; request < spawnCount; ++request)
+        {
+            batch.Requests.PopBack();
+        }
+
+        GetWorld().CreateEntitiesAsync(
+            batch.Template,
+            spawnCount,
+            [requests](Entity& newEntity, const Archetype& archetype, uint32 index)
+            {
+                CTransform& transform = newEntity.Get<CTransform>(archetype);
+                transform.ComponentTransform.SetWorldLocation(requests[index].Location);
+
+                CTeamMember* teamMember = newEntity.GetChecked<CTeamMember>(archetype);
+                if (teamMember != nullptr)
+                {
+                    teamMember->TeamID = requests[index].TeamID;
+                }
+            }
+        );
+    }
+
+    if (batchCount > 0)
+    {
+        _nextSpawnBatch = (_nextSpawnBatch + 1) % batchCount;
+    }
+}
@@ -17,5 +17,32 @@ public:
     // System
 protected:
     virtual void OnEntityCreated(const Archetype& archetype, Entity& entity) override;
+    virtual void Tick(double deltaTime) override;
     virtual void ProcessEntityList(EntityList& entityList, double deltaTime) override;
+
+private:
+    struct SpawnRequest
+    {
+        Vector3 Location;
+        uint32 TeamID = 0;
+    };
+
+    // Spawns of one template waiting for budget, issued to the world as one batch
+    struct SpawnBatch
+    {
+        SharedObjectPtr<EntityTemplate> Template;
+        DArray<SpawnRequest> Requests;
+    };
+
+private:
+    DArray<SpawnBatch> _spawnBatches;
+    std::unordered_map<const EntityTemplate*, uint32> _spawnBatchIndices;
+    // Batch that gets budget first next tick, so one template can't starve the others
+    uint32 _nextSpawnBatch = 0;
+
+    // Spawns issued per tick across all spawners, larger waves are spread over multiple ticks
+    static constexpr uint32 _spawnBudget = 32;
+
+private:
+    void IssueSpawns();
 };
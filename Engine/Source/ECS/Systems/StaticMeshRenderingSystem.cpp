@@ -124,6 +124,11 @@ void StaticMeshRenderingSystem::OnEntityDestroyed(const Archetype& archetype, En
     _instanceBuffer.RemoveAtSwap(staticMesh.InstanceID);
 
     _registeredMeshComponents.Back()->InstanceID = staticMesh.InstanceID;
+    const auto pooledIt = _pooledInstanceIDs.find(_registeredMeshComponents.Back());
+    if (pooledIt != _pooledInstanceIDs.end())
+    {
+        pooledIt->second = staticMesh.InstanceID;
+    }
 
     _registeredMeshComponents.RemoveAtSwap(staticMesh.InstanceID);
 }
@@ -139,6 +144,39 @@ void StaticMeshRenderingSystem::Shutdown()
     RenderingSubsystem::Get().UnregisterStaticMeshRenderingSystem(this);
 }
 
+void StaticMeshRenderingSystem::OnEntityActivated(const Archetype& archetype, Entity& entity)
+{
+    CStaticMesh& staticMesh = entity.Get<CStaticMesh>(archetype);
+
+    const auto it = _pooledInstanceIDs.find(&staticMesh);
+    if (it == _pooledInstanceIDs.end())
+    {
+        OnEntityCreated(archetype, entity);
+        return;
+    }
+
+    staticMesh.InstanceID = it->second;
+    _pooledInstanceIDs.erase(it);
+
+    CTransform& transform = entity.Get<CTransform>(archetype);
+    staticMesh.MeshTransform.SetParent(&transform.ComponentTransform);
+    if (staticMesh.MaterialOverride == nullptr)
+    {
+        staticMesh.MaterialOverride = staticMesh.Mesh->GetMaterial();
+    }
+
+    _instanceBuffer[staticMesh.InstanceID].World = staticMesh.MeshTransform.GetWorldMatrix().Transpose();
+}
+
+void StaticMeshRenderingSystem::OnEntityDeactivated(const Archetype& archetype, Entity& entity)
+{
+    const CStaticMesh& staticMesh = entity.Get<CStaticMesh>(archetype);
+
+    // Zero scale collapses the instance so it isn't visible until the entity is reused
+    _instanceBuffer[staticMesh.InstanceID].World = Matrix::CreateScale(0.0f);
+    _pooledInstanceIDs[&staticMesh] = staticMesh.InstanceID;
+}
+
 DynamicGPUBuffer<MaterialParameter>& StaticMeshRenderingSystem::GetOrCreateMaterialParameterBuffer(
     uint32 materialID, const SharedObjectPtr<Shader>& shader)
 {
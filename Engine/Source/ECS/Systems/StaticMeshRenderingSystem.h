@@ -33,8 +33,14 @@ protected:
 
     virtual void Shutdown() override;
 
+    virtual void OnEntityActivated(const Archetype& archetype, Entity& entity) override;
+    virtual void OnEntityDeactivated(const Archetype& archetype, Entity& entity) override;
+
 private:
     DArray<CStaticMesh*> _registeredMeshComponents;
+
+    // Instances of pooled entities stay registered but hidden, resetting the entity overwrites its InstanceID
+    std::unordered_map<const CStaticMesh*, uint32> _pooledInstanceIDs;
     InstanceBuffer _instanceBuffer{};
     std::unordered_map<uint32, DynamicGPUBuffer<MaterialParameter>> _materialIDToMaterialParameterBuffer;
 
@@ -1,6 +1,7 @@
 ﻿#include "System.h"
 #include "ECS/Event.h"
 #include "ECS/World.h"
+#include "ECS/Components/CSimulationLOD.h"
 
 SystemBase::SystemBase(): _eventQueue(this)
 {
@@ -31,6 +32,16 @@ void SystemBase::CallOnEntityDestroyed(const Archetype& archetype, Entity& entit
     OnEntityDestroyed(archetype, entity);
 }
 
+void SystemBase::CallOnEntityActivated(const Archetype& archetype, Entity& entity, PassKey<World>)
+{
+    OnEntityActivated(archetype, entity);
+}
+
+void SystemBase::CallOnEntityDeactivated(const Archetype& archetype, Entity& entity, PassKey<World>)
+{
+    OnEntityDeactivated(archetype, entity);
+}
+
 void SystemBase::CallShutdown(PassKey<SystemScheduler>)
 {
     Shutdown();
@@ -61,6 +72,47 @@ EventQueue<SystemBase>& SystemBase::GetEventQueue()
     return _eventQueue;
 }
 
+void SystemBase::SetSimulationLODBuckets(uint32 bucketMask)
+{
+    // Bucket 0 is always simulated at full rate
+    _simulationLODBuckets = bucketMask & ~1u;
+}
+
+bool SystemBase::ShouldSimulate(Entity& entity, double deltaTime, double& outDeltaTime) const
+{
+    outDeltaTime = deltaTime;
+
+    const uint8 bucket = GetSimulationLODBucket(entity);
+    if ((_simulationLODBuckets & (1u << bucket)) == 0)
+    {
+        return true;
+    }
+
+    const SimulationLOD& simulationLOD = GetWorld().GetSimulationLOD();
+    if (!simulationLOD.IsSimulatedThisFrame(bucket, entity.GetID()))
+    {
+        return false;
+    }
+
+    outDeltaTime = entity.Get<CSimulationLOD>(_simulationLODIndex).DeltaTime;
+    return true;
+}
+
+uint8 SystemBase::GetSimulationLODBucket(Entity& entity) const
+{
+    if (_simulationLODIndex == std::numeric_limits<uint16>::max())
+    {
+        return 0;
+    }
+
+    return entity.Get<CSimulationLOD>(_simulationLODIndex).Bucket;
+}
+
+void SystemBase::CacheSimulationLOD(const Archetype& archetype)
+{
+    _simulationLODIndex = archetype.GetComponentIndexChecked<CSimulationLOD>();
+}
+
 void SystemBase::Initialize()
 {
     std::ignore = GetType()->ForEachProperty([this](PropertyBase* propertyBase)
@@ -98,6 +150,16 @@ void SystemBase::Shutdown()
 {
 }
 
+void SystemBase::OnEntityActivated(const Archetype& archetype, Entity& entity)
+{
+    OnEntityCreated(archetype, entity);
+}
+
+void SystemBase::OnEntityDeactivated(const Archetype& archetype, Entity& entity)
+{
+    OnEntityDestroyed(archetype, entity);
+}
+
 const ECSQuery& SystemBase::GetQuery() const
 {
     return _persistentQuery;
@@ -33,6 +33,8 @@ public:
     void CallOnEntityCreated(const Archetype& archetype, Entity& entity, PassKey<World>);
     void CallTick(double deltaTime, PassKey<SystemScheduler>);
     void CallOnEntityDestroyed(const Archetype& archetype, Entity& entity, PassKey<World>);
+    void CallOnEntityActivated(const Archetype& archetype, Entity& entity, PassKey<World>);
+    void CallOnEntityDeactivated(const Archetype& archetype, Entity& entity, PassKey<World>);
     void CallShutdown(PassKey<SystemScheduler>);
 
     void SetWorld(World* world, PassKey<World>);
@@ -57,14 +59,39 @@ protected:
     virtual void OnEntityDestroyed(const Archetype& archetype, Entity& entity);
     virtual void Shutdown();
 
+    /**
+     * Called when a pooled entity is reused and when it's returned to its pool. By default these behave as if the
+     * entity was created and destroyed, systems can override them to keep their registrations while it's pooled.
+     */
+    virtual void OnEntityActivated(const Archetype& archetype, Entity& entity);
+    virtual void OnEntityDeactivated(const Archetype& archetype, Entity& entity);
+
     const ECSQuery& GetQuery() const;
 
+    /**
+     * Opts this system in to reduced rate simulation of entities in buckets of bucketMask, see SimulationLOD.
+     */
+    void SetSimulationLODBuckets(uint32 bucketMask);
+
+    /**
+     * Returns false if this system skips entity in the current frame, otherwise sets outDeltaTime to the time
+     * entity should be simulated for. Entities without CSimulationLOD are simulated every frame.
+     */
+    bool ShouldSimulate(Entity& entity, double deltaTime, double& outDeltaTime) const;
+    uint8 GetSimulationLODBucket(Entity& entity) const;
+
+    void CacheSimulationLOD(const Archetype& archetype);
+
 private:
     Archetype _archetype;
     ECSQuery _persistentQuery;
     World* _world = nullptr;
 
     EventQueue<SystemBase> _eventQueue;
+
+    uint32 _simulationLODBuckets = 0;
+    // Index of CSimulationLOD in the entity list being processed
+    uint16 _simulationLODIndex = std::numeric_limits<uint16>::max();
 };
 
 template <typename T>
@@ -110,6 +137,7 @@ protected:
     void CacheArchetype(const Archetype& archetype)
     {
         (UpdateBinding<ComponentTypes>(archetype), ...);
+        CacheSimulationLOD(archetype);
     }
 
     // SystemBase
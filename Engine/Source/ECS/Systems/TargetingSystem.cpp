@@ -1,5 +1,6 @@
 ﻿#include "ECS/Systems/TargetingSystem.h"
 #include "ECS/Systems/HealthSystem.h"
+#include "Engine/Engine.h"
 #include "Math/Math.h"
 
 void TargetingSystem::OnEntityCreated(const Archetype& archetype, Entity& entity)
@@ -12,12 +13,36 @@ void TargetingSystem::OnEntityCreated(const Archetype& archetype, Entity& entity
     targeting.ProjectileSpawnOffset.SetParent(&transform.ComponentTransform);
 }
 
+void TargetingSystem::Initialize()
+{
+    System::Initialize();
+
+    SetSimulationLODBuckets(std::numeric_limits<uint32>::max());
+}
+
+void TargetingSystem::Tick(double deltaTime)
+{
+    BuildTeamIndices();
+
+    // Entity lists only gather units looking for a target, all of them are matched against the team indices at once
+    System::Tick(deltaTime);
+
+    AcquireTargets();
+}
+
 void TargetingSystem::ProcessEntityList(EntityList& entityList, double deltaTime)
 {
     System::ProcessEntityList(entityList, deltaTime);
 
     entityList.ForEach([this, deltaTime](Entity& entity)
     {
+        // Far units aim, shoot and look for targets less often, timers advance by the time since they were last simulated
+        double entityDeltaTime = 0.0;
+        if (!ShouldSimulate(entity, deltaTime, entityDeltaTime))
+        {
+            return true;
+        }
+
         CTargeting& targeting = Get<CTargeting>(entity);
         if (targeting.Target != nullptr && targeting.Target->IsValid() && targeting.Target->GetID() == targeting.TargetID)
         {
@@ -35,15 +60,13 @@ void TargetingSystem::ProcessEntityList(EntityList& entityList, double deltaTime
                 if (targeting.TimeSinceLastShot > 1.0f / targeting.RateOfFire)
                 {
                     GetWorld().FindSystem<HealthSystem>()->DamageEntity(*targeting.Target, *targeting.TargetArchetype, 10.0f);
-                    GetWorld().CreateEntityAsync(
+                    GetWorld().AcquireEntityAsync(
                         targeting.ProjectileTemplate,
                         [location, rotation](Entity& entity, const Archetype& archetype)
                         {
                             CTransform& transform = entity.Get<CTransform>(archetype);
                             transform.ComponentTransform.SetWorldLocation(location);
                             transform.ComponentTransform.SetWorldRotation(rotation);
-
-                            return &entity;
                         },
                         [](Entity& entity, const Archetype& archetype)
                         {
@@ -52,7 +75,7 @@ void TargetingSystem::ProcessEntityList(EntityList& entityList, double deltaTime
                 }
                 else
                 {
-                    targeting.TimeSinceLastShot += static_cast<float>(deltaTime);
+                    targeting.TimeSinceLastShot += static_cast<float>(entityDeltaTime);
                 }
             }
         }
@@ -60,42 +83,134 @@ void TargetingSystem::ProcessEntityList(EntityList& entityList, double deltaTime
         {
             if (targeting.TargetingDelayTimer < targeting.TargetingDelay)
             {
-                targeting.TargetingDelayTimer += static_cast<float>(deltaTime);
+                targeting.TargetingDelayTimer += static_cast<float>(entityDeltaTime);
                 return true;
             }
 
-            const uint32 myTeam = Get<const CTeamMember>(entity).TeamID;
+            const Vector3 location = Get<const CTransform>(entity).ComponentTransform.GetWorldLocation();
 
             CPathfinding& pathfinding = Get<CPathfinding>(entity);
-            pathfinding.Destination = Get<const CTransform>(entity).ComponentTransform.GetWorldLocation();
+            pathfinding.Destination = location;
 
-            for (EntityList* entityList : GetQuery().GetEntityLists())
-            {
-                entityList->ForEach([&entityList, this, myTeam, &entity, &targeting](Entity& otherEntity)
-                {
-                    const CTeamMember teamMember = otherEntity.Get<const CTeamMember>(entityList->GetArchetype());
-                    if (teamMember.TeamID != myTeam)
-                    {
-                        if (Math::Random(0.0f, 1.0f) > 0.75f || myTeam == 1)
-                        {
-                            targeting.Target = &otherEntity;
-                            targeting.TargetID = otherEntity.GetID();
-                            targeting.TargetArchetype = &entityList->GetArchetype();
+            targeting.Target = nullptr;
+            _seekers.Add({&targeting, location, Get<const CTeamMember>(entity).TeamID});
+        }
 
-                            return false;
-                        }
-                    }
+        return true;
+    });
+}
+
+void TargetingSystem::BuildTeamIndices()
+{
+    for (TeamIndex& teamIndex : _teamIndices)
+    {
+        teamIndex.Candidates.Clear();
+    }
+
+    // Entities are grouped by team in their entity lists, so a whole group is added to its team without reading
+    // CTeamMember of each member
+    for (EntityList* entityList : GetQuery().GetEntityLists())
+    {
+        const Archetype& archetype = entityList->GetArchetype();
+        const uint16 transformIndex = archetype.GetComponentIndex<CTransform>();
 
-                    return true;
-                });
-                
-                if (targeting.Target != nullptr)
+        entityList->ForEachGroup([this, &archetype, transformIndex](uint32 teamID, std::span<Entity* const> members)
+        {
+            TeamIndex* teamIndex = nullptr;
+            for (TeamIndex& index : _teamIndices)
+            {
+                if (index.TeamID == teamID)
                 {
+                    teamIndex = &index;
                     break;
                 }
             }
+
+            if (teamIndex == nullptr)
+            {
+                teamIndex = &_teamIndices.AddDefault();
+                teamIndex->TeamID = teamID;
+                teamIndex->Grid.Initialize(World::WorldBounds, _cellCountPerAxis);
+            }
+
+            for (Entity* entity : members)
+            {
+                const Vector3 location = entity->Get<const CTransform>(transformIndex).ComponentTransform.GetWorldLocation();
+                teamIndex->Candidates.Add({entity, &archetype, location});
+            }
+
+            return true;
+        });
+    }
+
+    // Teams are independent, each grid is built by one job
+    Engine::Get().GetThreadPool().ParallelFor(static_cast<uint32>(_teamIndices.Count()), 1, [this](uint32 begin, uint32 end)
+    {
+        for (uint32 i = begin; i < end; ++i)
+        {
+            TeamIndex& teamIndex = _teamIndices[i];
+            teamIndex.Grid.Build(static_cast<uint32>(teamIndex.Candidates.Count()), [&teamIndex](uint32 item, BoundingBox& outBounds)
+            {
+                const Vector3& location = teamIndex.Candidates[item].Location;
+                outBounds = BoundingBox(location, location);
+                return true;
+            });
         }
+    });
+}
 
-        return true;
+void TargetingSystem::AcquireTargets()
+{
+    Engine::Get().GetThreadPool().ParallelFor(static_cast<uint32>(_seekers.Count()), _seekersPerBatch, [this](uint32 begin, uint32 end)
+    {
+        for (uint32 i = begin; i < end; ++i)
+        {
+            _seekers[i].Target = FindNearestEnemy(_seekers[i]);
+        }
     });
+
+    for (const Seeker& seeker : _seekers)
+    {
+        if (seeker.Target != nullptr)
+        {
+            CTargeting& targeting = *seeker.Targeting;
+            targeting.Target = seeker.Target->TargetEntity;
+            targeting.TargetID = seeker.Target->TargetEntity->GetID();
+            targeting.TargetArchetype = seeker.Target->TargetArchetype;
+        }
+    }
+
+    _seekers.Clear();
+}
+
+const TargetingSystem::TargetCandidate* TargetingSystem::FindNearestEnemy(const Seeker& seeker) const
+{
+    const TargetCandidate* nearest = nullptr;
+    float nearestDistanceSquared = std::numeric_limits<float>::max();
+
+    for (const TeamIndex& teamIndex : _teamIndices)
+    {
+        if (teamIndex.TeamID == seeker.TeamID)
+        {
+            continue;
+        }
+
+        // Search of each team starts from the nearest enemy found so far, so far teams are rejected after few rings
+        teamIndex.Grid.ForEachItemNear(seeker.Location, nearestDistanceSquared, [&seeker, &teamIndex, &nearest, &nearestDistanceSquared](uint32 item)
+        {
+            const TargetCandidate& candidate = teamIndex.Candidates[item];
+            const float distanceSquared = Vector3::DistanceSquared(candidate.Location, seeker.Location);
+
+            // Equally distant candidates are ordered by entity ID, so the result doesn't depend on cell order
+            if (distanceSquared < nearestDistanceSquared ||
+                (distanceSquared == nearestDistanceSquared && nearest != nullptr &&
+                    candidate.TargetEntity->GetID() < nearest->TargetEntity->GetID()))
+            {
+                nearest = &candidate;
+                nearestDistanceSquared = distanceSquared;
+            }
+        });
+    }
+
+    return nearest;
 }
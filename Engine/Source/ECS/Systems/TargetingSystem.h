@@ -1,6 +1,8 @@
 ﻿#pragma once
 
 #include "System.h"
+#include "Containers/DArray.h"
+#include "Containers/Spatialization/SpatialHashGrid3D.h"
 #include "ECS/Components/CTargeting.h"
 #include "ECS/Components/CTeamMember.h"
 #include "ECS/Components/CPathfinding.h"
@@ -14,6 +16,45 @@ class TargetingSystem : public System<const CTransform, CPathfinding, CTargeting
 
     // System
 public:
+    virtual void Initialize() override;
     virtual void OnEntityCreated(const Archetype& archetype, Entity& entity) override;
+    virtual void Tick(double deltaTime) override;
     virtual void ProcessEntityList(EntityList& entityList, double deltaTime) override;
+
+private:
+    struct TargetCandidate
+    {
+        Entity* TargetEntity;
+        const Archetype* TargetArchetype;
+        Vector3 Location;
+    };
+
+    // Members of one team, rebuilt every tick, items of the grid are indices into Candidates
+    struct TeamIndex
+    {
+        uint32 TeamID = 0;
+        DArray<TargetCandidate> Candidates;
+        SpatialHashGrid3D Grid;
+    };
+
+    struct Seeker
+    {
+        CTargeting* Targeting;
+        Vector3 Location;
+        uint32 TeamID;
+        const TargetCandidate* Target = nullptr;
+    };
+
+    // Coarse cells keep the rings of nearest enemy search small when enemies are far apart
+    static constexpr uint32 _cellCountPerAxis = 64;
+    static constexpr uint32 _seekersPerBatch = 64;
+
+    DArray<TeamIndex> _teamIndices;
+    // Units without a valid target in current tick, queried in parallel after all entity lists are processed
+    DArray<Seeker> _seekers;
+
+private:
+    void BuildTeamIndices();
+    void AcquireTargets();
+    const TargetCandidate* FindNearestEnemy(const Seeker& seeker) const;
 };
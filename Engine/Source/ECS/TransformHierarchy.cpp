@@ -0,0 +1,72 @@
+﻿#include "TransformHierarchy.h"
+#include "ECS/World.h"
+#include "ECS/Components/CCollider.h"
+#include "ECS/Components/CPointLight.h"
+#include "ECS/Components/CSpawner.h"
+#include "ECS/Components/CStaticMesh.h"
+#include "ECS/Components/CTargeting.h"
+#include "ECS/Components/CTransform.h"
+#include "Engine/Engine.h"
+
+void TransformHierarchy::Update(World& world)
+{
+    if (_isDirty)
+    {
+        Gather(world);
+        _isDirty = false;
+    }
+
+    UpdateTransforms(_entityTransforms);
+    UpdateTransforms(_componentTransforms);
+}
+
+void TransformHierarchy::Invalidate()
+{
+    _isDirty = true;
+}
+
+uint32 TransformHierarchy::GetTransformCount() const
+{
+    return static_cast<uint32>(_entityTransforms.Count() + _componentTransforms.Count());
+}
+
+void TransformHierarchy::Gather(World& world)
+{
+    _entityTransforms.Clear();
+    _componentTransforms.Clear();
+
+    GatherTransforms<CTransform>(world, &CTransform::ComponentTransform, _entityTransforms);
+    GatherTransforms<CStaticMesh>(world, &CStaticMesh::MeshTransform, _componentTransforms);
+    GatherTransforms<CCollider>(world, &CCollider::ColliderTransform, _componentTransforms);
+    GatherTransforms<CPointLight>(world, &CPointLight::LightTransform, _componentTransforms);
+    GatherTransforms<CTargeting>(world, &CTargeting::ProjectileSpawnOffset, _componentTransforms);
+    GatherTransforms<CSpawner>(world, &CSpawner::SpawnTransform, _componentTransforms);
+}
+
+template <typename ComponentType>
+void TransformHierarchy::GatherTransforms(World& world, Transform ComponentType::* member, DArray<const Transform*>& transforms)
+{
+    world.Query<ComponentType>(_query);
+    for (EntityList* entityList : _query.GetEntityLists())
+    {
+        const uint16 componentIndex = entityList->GetArchetype().GetComponentIndex<ComponentType>();
+
+        entityList->ForEach([componentIndex, member, &transforms](Entity& entity)
+        {
+            transforms.Add(&(entity.Get<ComponentType>(componentIndex).*member));
+            return true;
+        });
+    }
+}
+
+void TransformHierarchy::UpdateTransforms(const DArray<const Transform*>& transforms)
+{
+    Engine::Get().GetThreadPool().ParallelFor(static_cast<uint32>(transforms.Count()), _transformsPerBatch,
+        [&transforms](uint32 begin, uint32 end)
+        {
+            for (uint32 i = begin; i < end; ++i)
+            {
+                transforms[i]->UpdateWorldMatrix({});
+            }
+        });
+}
@@ -0,0 +1,45 @@
+﻿#pragma once
+
+#include "Core.h"
+#include "Containers/DArray.h"
+#include "ECS/ECSQuery.h"
+
+class Transform;
+class World;
+
+/**
+ * Updates world matrices of entity transforms and the transforms of components parented onto them in one explicit
+ * pass, instead of each reader recomputing them lazily through parent pointers. Entity transforms are updated in
+ * parallel first and component transforms after them, as components are only parented onto their entity transform.
+ * Transforms changed later in the frame are still recomputed on read.
+ */
+class TransformHierarchy
+{
+public:
+    void Update(World& world);
+
+    /**
+     * Transforms are gathered again on the next update. Called by World whenever entities are created, destroyed,
+     * activated, deactivated or change archetype, the only places where transforms move or get parented.
+     */
+    void Invalidate();
+
+    uint32 GetTransformCount() const;
+
+private:
+    static constexpr uint32 _transformsPerBatch = 256;
+
+    ECSQuery _query;
+    bool _isDirty = true;
+
+    DArray<const Transform*> _entityTransforms;
+    DArray<const Transform*> _componentTransforms;
+
+private:
+    void Gather(World& world);
+
+    template <typename ComponentType>
+    void GatherTransforms(World& world, Transform ComponentType::* member, DArray<const Transform*>& transforms);
+
+    static void UpdateTransforms(const DArray<const Transform*>& transforms);
+};
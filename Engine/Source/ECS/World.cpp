@@ -1,5 +1,6 @@
 ﻿#include "World.h"
 #include "EntityTemplate.h"
+#include "ECS/Components/CTeamMember.h"
 
 BoundingBox World::WorldBounds = BoundingBox(Vector3(-100.0f), Vector3(100.0f));
 
@@ -43,6 +44,39 @@ void World::DestroyEntityAsync(Entity& entity)
     });
 }
 
+void World::ReleaseEntityAsync(Entity& entity)
+{
+    if (!entity.IsValid() || !entity.IsActive())
+    {
+        return;
+    }
+
+    // Entity may be released more than once in a frame, only the first release applies
+    _eventQueue.Enqueue([this, &entity, id = entity.GetID()](World* world)
+    {
+        if (entity.IsValid() && entity.IsActive() && entity.GetID() == id)
+        {
+            ReleaseEntity(entity);
+        }
+    });
+}
+
+void World::DestroyEntitiesAsync(const DArray<Entity*>& entities)
+{
+    if (entities.IsEmpty())
+    {
+        return;
+    }
+
+    _eventQueue.Enqueue([this, entities](World* world)
+    {
+        for (Entity* entity : entities)
+        {
+            DestroyEntity(*entity);
+        }
+    });
+}
+
 Entity& World::CreateEntity(const SharedObjectPtr<EntityTemplate>& entityTemplate)
 {
     assert(entityTemplate != nullptr);
@@ -89,6 +123,19 @@ void World::DestroyEntity(Entity& entity)
     const EntityListGraph::EntityListResult result = _entityListGraph.GetOrCreateEntityListFor(archetype);
     EntityList& entityList = *result.List;
 
+    const auto pooledIt = _pooledEntityTemplates.find(&entity);
+    if (pooledIt != _pooledEntityTemplates.end())
+    {
+        // Systems only see destruction of active entities, so pooled entities are activated first
+        if (!entity.IsActive())
+        {
+            _entityPools[pooledIt->second.get()].RemoveSwap(&entity);
+            ActivateEntity(entity, archetype);
+        }
+
+        _pooledEntityTemplates.erase(pooledIt);
+    }
+
     for (const std::unique_ptr<SystemBase>& system : _systemScheduler.GetSystems())
     {
         if (system->GetArchetype().IsSubsetOf(archetype))
@@ -98,7 +145,9 @@ void World::DestroyEntity(Entity& entity)
     }
 
     --_entityCount;
+    entityList.RemoveFromGroup(entity, {});
     entityList.Remove(entity);
+    _transformHierarchy.Invalidate();
 }
 
 World::AddComponentResult<Component> World::AddComponent(Entity& entity, Type& componentType, Name name)
@@ -111,7 +160,11 @@ World::AddComponentResult<Component> World::AddComponent(Entity& entity, Type& c
     EntityList& entityListAfter = GetEntityList(archetypeAfter);
 
     Entity* newEntity = entityListAfter.Add(entity);
+    entityListBefore.RemoveFromGroup(entity, {});
     entityListBefore.Remove(entity);
+    UpdateEntityGroup(*newEntity, archetypeAfter);
+    MovePooledEntity(entity, *newEntity, archetypeAfter);
+    _transformHierarchy.Invalidate();
 
     OnArchetypeChanged.Add(entity, archetypeBefore, newEntity, archetypeAfter, {});
 
@@ -127,8 +180,28 @@ void World::RemoveComponent(Entity& entity, uint16 index)
     EntityList& entityListBefore = GetEntityList(archetypeBefore);
     EntityList& entityListAfter = GetEntityList(archetypeAfter);
 
-    entityListAfter.Add(entity);
+    Entity* newEntity = entityListAfter.Add(entity);
+    entityListBefore.RemoveFromGroup(entity, {});
     entityListBefore.Remove(entity);
+    UpdateEntityGroup(*newEntity, archetypeAfter);
+    MovePooledEntity(entity, *newEntity, archetypeAfter);
+    _transformHierarchy.Invalidate();
+}
+
+void World::SetTeamID(Entity& entity, uint32 teamID)
+{
+    const Archetype archetype = Archetype(entity);
+    CTeamMember* teamMember = entity.GetChecked<CTeamMember>(archetype);
+    if (teamMember == nullptr)
+    {
+        return;
+    }
+
+    teamMember->TeamID = teamID;
+    if (entity.IsActive())
+    {
+        GetEntityList(archetype).SetGroup(entity, teamID, {});
+    }
 }
 
 void World::Query(ECSQuery& query, const Archetype& archetype) const
@@ -155,8 +228,19 @@ void World::Initialize(PassKey<GameplaySubsystem>)
 
 void World::Tick(double deltaTime, PassKey<GameplaySubsystem>)
 {
+    // No system runs between frames, so nothing can be signalling the dispatchers
+    OnTransformChanged.ReclaimRetiredListeners();
+    OnArchetypeChanged.ReclaimRetiredListeners();
+
     _eventQueue.ProcessEvents();
 
+    // Buckets are assigned before any system runs, so they don't change while systems read them
+    _simulationLOD.Update(*this, deltaTime);
+
+    // Matrices changed since the last frame are brought up to date in one pass, so systems mostly read them without
+    // recomputing parent chains
+    _transformHierarchy.Update(*this);
+
     _systemScheduler.Tick(deltaTime);
 
     _eventQueue.ProcessEvents();
@@ -172,6 +256,16 @@ EventQueue<World>& World::GetEventQueue()
     return _eventQueue;
 }
 
+SimulationLOD& World::GetSimulationLOD()
+{
+    return _simulationLOD;
+}
+
+const SimulationLOD& World::GetSimulationLOD() const
+{
+    return _simulationLOD;
+}
+
 EventManager& World::GetEventManager()
 {
     return _eventManager;
@@ -183,6 +277,7 @@ Entity& World::CreateEntityInternal(const Archetype& archetype)
 
     Entity& entity = *entityList.AddDefault();
     entity.SetID(_entityIDGenerator.GenerateID(), {});
+    _transformHierarchy.Invalidate();
     for (const Archetype::QualifiedComponentType& qualifiedType : archetype.GetComponentTypes())
     {
         AddComponentInternal(entity, *qualifiedType.Type, qualifiedType.Name);
@@ -204,6 +299,7 @@ Entity& World::CreateEntityInternal(const SharedObjectPtr<EntityTemplate>& entit
 void World::OnEntityCreated(Entity& entity, const Archetype& archetype) const
 {
     ++const_cast<World*>(this)->_entityCount;
+    const_cast<World*>(this)->UpdateEntityGroup(entity, archetype);
 
     for (const std::unique_ptr<SystemBase>& system : _systemScheduler.GetSystems())
     {
@@ -219,6 +315,118 @@ void World::OnEntityCreated(Entity& entity, const SharedObjectPtr<EntityTemplate
     OnEntityCreated(entity, archetype->GetArchetype());
 }
 
+Entity* World::TakePooledEntity(const SharedObjectPtr<EntityTemplate>& entityTemplate)
+{
+    const auto it = _entityPools.find(entityTemplate.get());
+    if (it == _entityPools.end() || it->second.IsEmpty())
+    {
+        return nullptr;
+    }
+
+    Entity* entity = it->second.Back();
+    it->second.PopBack();
+
+    // Entities that changed archetype are taken out of their pool, so the template still matches their layout
+    entityTemplate->InitializeEntity(*entity);
+
+    return entity;
+}
+
+Entity& World::CreatePooledEntity(const SharedObjectPtr<EntityTemplate>& entityTemplate)
+{
+    Entity& entity = CreateEntityInternal(entityTemplate);
+    _pooledEntityTemplates.emplace(&entity, entityTemplate);
+
+    return entity;
+}
+
+void World::ReleaseEntity(Entity& entity)
+{
+    const auto it = _pooledEntityTemplates.find(&entity);
+    if (it == _pooledEntityTemplates.end())
+    {
+        DestroyEntity(entity);
+        return;
+    }
+
+    DeactivateEntity(entity, Archetype(entity));
+
+    // References to the released entity compare IDs, so it can't keep its old one
+    entity.SetID(_entityIDGenerator.GenerateID(), {});
+    _entityPools[it->second.get()].Add(&entity);
+}
+
+void World::MovePooledEntity(const Entity& entity, Entity& newEntity, const Archetype& archetype)
+{
+    const auto it = _pooledEntityTemplates.find(&entity);
+    if (it == _pooledEntityTemplates.end())
+    {
+        return;
+    }
+
+    const SharedObjectPtr<EntityTemplate> entityTemplate = it->second;
+    _pooledEntityTemplates.erase(it);
+
+    DArray<Entity*>& pool = _entityPools[entityTemplate.get()];
+    if (!newEntity.IsActive())
+    {
+        pool.RemoveSwap(const_cast<Entity*>(&entity));
+    }
+
+    // Template can't reset an entity with a different layout, it stops being pooled and is destroyed on release
+    if (archetype != entityTemplate->GetArchetype())
+    {
+        if (!newEntity.IsActive())
+        {
+            ActivateEntity(newEntity, archetype);
+        }
+
+        return;
+    }
+
+    _pooledEntityTemplates.emplace(&newEntity, entityTemplate);
+    if (!newEntity.IsActive())
+    {
+        pool.Add(&newEntity);
+    }
+}
+
+void World::ActivateEntity(Entity& entity, const Archetype& archetype)
+{
+    ++_entityCount;
+    entity.SetActive(true, {});
+    UpdateEntityGroup(entity, archetype);
+    _transformHierarchy.Invalidate();
+
+    for (const std::unique_ptr<SystemBase>& system : _systemScheduler.GetSystems())
+    {
+        if (archetype.IsSubsetOf(system->GetArchetype()))
+        {
+            system->CallOnEntityActivated(archetype, entity, {});
+        }
+    }
+}
+
+void World::DeactivateEntity(Entity& entity, const Archetype& archetype)
+{
+    for (const std::unique_ptr<SystemBase>& system : _systemScheduler.GetSystems())
+    {
+        if (system->GetArchetype().IsSubsetOf(archetype))
+        {
+            system->CallOnEntityDeactivated(archetype, entity, {});
+        }
+    }
+
+    if (archetype.HasComponent<CTeamMember>())
+    {
+        GetEntityList(archetype).RemoveFromGroup(entity, {});
+    }
+
+    entity.SetActive(false, {});
+    --_entityCount;
+    _transformHierarchy.Invalidate();
+}
+
 SharedObjectPtr<Component> World::AddComponentInternal(Entity& entity, Type& componentType, Name name)
 {
     const SharedObjectPtr<Component> newComponent = _componentTypeMap.NewObject<Component>(componentType);
@@ -228,6 +436,17 @@ SharedObjectPtr<Component> World::AddComponentInternal(Entity& entity, Type& com
     return newComponent;
 }
 
+void World::UpdateEntityGroup(Entity& entity, const Archetype& archetype)
+{
+    const uint16 teamMemberIndex = archetype.GetComponentIndexChecked<CTeamMember>();
+    if (teamMemberIndex == std::numeric_limits<uint16>::max())
+    {
+        return;
+    }
+
+    GetEntityList(archetype).SetGroup(entity, entity.Get<const CTeamMember>(teamMemberIndex).TeamID, {});
+}
+
 EntityList& World::GetEntityList(const Archetype& archetype)
 {
     const EntityListGraph::EntityListResult result = _entityListGraph.GetOrCreateEntityListFor(archetype);
@@ -4,12 +4,16 @@
 #include "EntityTemplate.h"
 #include "Event.h"
 #include "EventManager.h"
+#include "IDGenerator.h"
 #include "Containers/EventQueue.h"
 #include "Containers/ObjectTypeMap.h"
 #include "ECS/EntityListGraph.h"
+#include "ECS/SimulationLOD.h"
 #include "ECS/SystemScheduler.h"
+#include "ECS/TransformHierarchy.h"
 #include "ECS/World.reflection.h"
 #include "ECS/Components/Component.h"
+#include <unordered_map>
 
 class GameplaySubsystem;
 class Type;
@@ -71,6 +75,11 @@ public:
 
     void DestroyEntityAsync(Entity& entity);
 
+    /**
+     * Destroys all entities in a single queued event.
+     */
+    void DestroyEntitiesAsync(const DArray<Entity*>& entities);
+
     template <typename Func>
     void DestroyEntityAsync(Entity& entity, Func onDestroyed)
     {
@@ -111,6 +120,59 @@ public:
         });
     }
     
+    /**
+     * Creates count entities from entityTemplate in a single queued event. initialize(entity, archetype, index) is
+     * called on each of them before systems are notified.
+     */
+    template <typename FuncInit>
+    void CreateEntitiesAsync(const SharedObjectPtr<EntityTemplate>& entityTemplate, uint32 count, FuncInit initialize)
+    {
+        _eventQueue.Enqueue([entityTemplate, count, initialize](World* world)
+        {
+            const Archetype& archetype = entityTemplate->GetArchetype();
+
+            for (uint32 i = 0; i < count; ++i)
+            {
+                Entity& entity = world->CreateEntityInternal(entityTemplate);
+                initialize(entity, archetype, i);
+                world->OnEntityCreated(entity, archetype);
+            }
+        });
+    }
+
+    /**
+     * Same as CreateEntityAsync, but reuses an entity released to the pool of entityTemplate if there is one.
+     * Reused entities are reset from the template before preInitialize, which must not change their archetype.
+     */
+    template <typename FuncInit, typename FuncOnAcquired>
+    void AcquireEntityAsync(const SharedObjectPtr<EntityTemplate>& entityTemplate, FuncInit preInitialize, FuncOnAcquired onAcquired)
+    {
+        _eventQueue.Enqueue([entityTemplate, preInitialize, onAcquired](World* world)
+        {
+            Entity* pooledEntity = world->TakePooledEntity(entityTemplate);
+            Entity& entity = pooledEntity != nullptr ? *pooledEntity : world->CreatePooledEntity(entityTemplate);
+
+            const Archetype archetype = Archetype(entity);
+            preInitialize(entity, archetype);
+
+            if (pooledEntity != nullptr)
+            {
+                world->ActivateEntity(entity, archetype);
+            }
+            else
+            {
+                world->OnEntityCreated(entity, archetype);
+            }
+
+            onAcquired(entity, archetype);
+        });
+    }
+
+    /**
+     * Returns entity acquired by AcquireEntityAsync to its pool, other entities are destroyed.
+     */
+    void ReleaseEntityAsync(Entity& entity);
+
     template <typename Func>
     void CreateEntityAsync(const SharedObjectPtr<EntityTemplate>& entityTemplate, uint32 count, Func onCreated)
     {
@@ -198,6 +260,13 @@ public:
         return nullptr;
     }
 
+    /**
+     * Changes team of entity and moves it to the matching group of its entity list, see EntityList::ForEachGroup.
+     * Entities are grouped by CTeamMember::TeamID when they are created, later changes have to go through here.
+     * Not thread safe, systems should call it from the world's event queue.
+     */
+    void SetTeamID(Entity& entity, uint32 teamID);
+
     void Query(ECSQuery& query, const Archetype& archetype) const;
 
     template <typename... ComponentType> requires (IsA<ComponentType, Component> && ...)
@@ -215,6 +284,9 @@ public:
 
     EventManager& GetEventManager();
 
+    SimulationLOD& GetSimulationLOD();
+    const SimulationLOD& GetSimulationLOD() const;
+
 private:
     ObjectTypeMap _componentTypeMap;
     EntityListGraph _entityListGraph;
@@ -224,15 +296,31 @@ private:
 
     EventManager _eventManager;
 
+    SimulationLOD _simulationLOD;
+    TransformHierarchy _transformHierarchy;
+
     IDGenerator<uint64> _entityIDGenerator;
     uint64 _entityCount = 0;
 
+    // Inactive entities of each template waiting to be reused, and the template of every entity created for a pool
+    std::unordered_map<const EntityTemplate*, DArray<Entity*>> _entityPools;
+    std::unordered_map<const Entity*, SharedObjectPtr<EntityTemplate>> _pooledEntityTemplates;
+
 private:
     Entity& CreateEntityInternal(const Archetype& archetype);
     Entity& CreateEntityInternal(const SharedObjectPtr<EntityTemplate>& entityTemplate);
     
     void OnEntityCreated(Entity& entity, const Archetype& archetype) const;
     void OnEntityCreated(Entity& entity, const SharedObjectPtr<EntityTemplate>& archetype) const;
+
+    Entity* TakePooledEntity(const SharedObjectPtr<EntityTemplate>& entityTemplate);
+    Entity& CreatePooledEntity(const SharedObjectPtr<EntityTemplate>& entityTemplate);
+    void ReleaseEntity(Entity& entity);
+    // Entities changing archetype move to another entity list, so pooling bookkeeping has to follow their address
+    void MovePooledEntity(const Entity& entity, Entity& newEntity, const Archetype& archetype);
+    void ActivateEntity(Entity& entity, const Archetype& archetype);
+    void DeactivateEntity(Entity& entity, const Archetype& archetype);
+    void UpdateEntityGroup(Entity& entity, const Archetype& archetype);
     SharedObjectPtr<Component> AddComponentInternal(Entity& entity, Type& componentType, Name name);
 
     EntityList& GetEntityList(const Archetype& archetype);
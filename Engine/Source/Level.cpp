@@ -343,9 +343,9 @@ SharedObjectPtr<Widget> Level::CreateEditWidget()
 Index3D Level::GetChunkIndex(const Vector3& location)
 {
     Index3D index;
-    index.X = static_cast<int32>(location.x / _chunkDimension);
-    index.Y = static_cast<int32>(location.y / _chunkDimension);
-    index.Z = static_cast<int32>(location.z / _chunkDimension);
+    index.X = static_cast<int32>(location.x / ChunkDimension);
+    index.Y = static_cast<int32>(location.y / ChunkDimension);
+    index.Z = static_cast<int32>(location.z / ChunkDimension);
 
     return index;
 }
@@ -1,6 +1,7 @@
 ﻿#pragma once
 
 #include "Asset.h"
+#include "IDGenerator.h"
 #include "Containers/SparseUniformGrid3D.h"
 #include "Math/Transform.h"
 #include "Rendering/Widgets/AssetBrowser.h"
@@ -45,6 +46,10 @@ public:
         uint64 ByteSize = 0;
     };
 
+public:
+    // Edge length of cubic chunks the level is streamed in
+    static constexpr float ChunkDimension = 20.0f;
+
 public:
     Level() = default;
 
@@ -80,9 +85,7 @@ private:
         Chunk* Chunk;
         uint64 EntityIndex = 0;
     };
-    
-    static constexpr float _chunkDimension = 20.0f;
-    
+
     SparseUniformGrid3D<Chunk> _grid;
 
     std::unordered_map<uint64, EntityElementRef> _entityElementRefs;
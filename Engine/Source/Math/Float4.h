@@ -0,0 +1,151 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include <emmintrin.h>
+
+/**
+ * Four floats processed at once with SSE2. Used by kernels that lay out independent work items in lanes, e.g. four
+ * collision pairs per instruction. Comparisons return lane masks for Select and MoveMask.
+ */
+struct Float4
+{
+public:
+    static constexpr uint32 LaneCount = 4;
+
+    __m128 Value;
+
+public:
+    Float4() = default;
+
+    Float4(__m128 value) : Value(value)
+    {
+    }
+
+    explicit Float4(float value) : Value(_mm_set1_ps(value))
+    {
+    }
+
+    Float4(float lane0, float lane1, float lane2, float lane3) : Value(_mm_setr_ps(lane0, lane1, lane2, lane3))
+    {
+    }
+
+    static Float4 Load(const float* data)
+    {
+        return _mm_loadu_ps(data);
+    }
+
+    void Store(float* data) const
+    {
+        _mm_storeu_ps(data, Value);
+    }
+
+    float operator[](uint32 lane) const
+    {
+        alignas(16) float lanes[LaneCount];
+        _mm_store_ps(lanes, Value);
+
+        return lanes[lane];
+    }
+
+    Float4 operator+(const Float4& other) const
+    {
+        return _mm_add_ps(Value, other.Value);
+    }
+
+    Float4 operator-(const Float4& other) const
+    {
+        return _mm_sub_ps(Value, other.Value);
+    }
+
+    Float4 operator*(const Float4& other) const
+    {
+        return _mm_mul_ps(Value, other.Value);
+    }
+
+    Float4 operator/(const Float4& other) const
+    {
+        return _mm_div_ps(Value, other.Value);
+    }
+
+    Float4 operator-() const
+    {
+        return _mm_xor_ps(Value, _mm_set1_ps(-0.0f));
+    }
+
+    Float4& operator+=(const Float4& other)
+    {
+        Value = _mm_add_ps(Value, other.Value);
+        return *this;
+    }
+
+    Float4 operator<(const Float4& other) const
+    {
+        return _mm_cmplt_ps(Value, other.Value);
+    }
+
+    Float4 operator<=(const Float4& other) const
+    {
+        return _mm_cmple_ps(Value, other.Value);
+    }
+
+    Float4 operator>(const Float4& other) const
+    {
+        return _mm_cmpgt_ps(Value, other.Value);
+    }
+
+    Float4 operator>=(const Float4& other) const
+    {
+        return _mm_cmpge_ps(Value, other.Value);
+    }
+
+    Float4 operator&(const Float4& other) const
+    {
+        return _mm_and_ps(Value, other.Value);
+    }
+
+    Float4 operator|(const Float4& other) const
+    {
+        return _mm_or_ps(Value, other.Value);
+    }
+
+    static Float4 Min(const Float4& a, const Float4& b)
+    {
+        return _mm_min_ps(a.Value, b.Value);
+    }
+
+    static Float4 Max(const Float4& a, const Float4& b)
+    {
+        return _mm_max_ps(a.Value, b.Value);
+    }
+
+    static Float4 Abs(const Float4& value)
+    {
+        return _mm_andnot_ps(_mm_set1_ps(-0.0f), value.Value);
+    }
+
+    static Float4 Sqrt(const Float4& value)
+    {
+        return _mm_sqrt_ps(value.Value);
+    }
+
+    static Float4 Clamp(const Float4& value, const Float4& min, const Float4& max)
+    {
+        return Min(Max(value, min), max);
+    }
+
+    /**
+     * Per lane mask ? a : b, mask lanes must be all ones or all zeros.
+     */
+    static Float4 Select(const Float4& mask, const Float4& a, const Float4& b)
+    {
+        return _mm_or_ps(_mm_and_ps(mask.Value, a.Value), _mm_andnot_ps(mask.Value, b.Value));
+    }
+
+    /**
+     * Bit i is set if lane i of mask is set.
+     */
+    static int32 MoveMask(const Float4& mask)
+    {
+        return _mm_movemask_ps(mask.Value);
+    }
+};
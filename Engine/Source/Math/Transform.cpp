@@ -280,10 +280,7 @@ const Matrix& Transform::GetWorldMatrix() const
 
     Transform* mutableThis = const_cast<Transform*>(this);
 
-    mutableThis->_worldMatrix =
-        Matrix::CreateScale(_scale) *
-        Matrix::CreateFromQuaternion(_rotation) *
-        Matrix::CreateTranslation(_location);
+    mutableThis->_worldMatrix = ComputeRelativeMatrix();
 
     if (_parent != nullptr)
     {
@@ -296,6 +293,27 @@ const Matrix& Transform::GetWorldMatrix() const
     return _worldMatrix;
 }
 
+void Transform::UpdateWorldMatrix(PassKey<TransformHierarchy>) const
+{
+    const bool isParentChanged = _parent != nullptr && _parentVersion != _parent->_version;
+    if (!_isWorldMatrixDirty && !isParentChanged)
+    {
+        return;
+    }
+
+    Transform* mutableThis = const_cast<Transform*>(this);
+
+    mutableThis->_worldMatrix = ComputeRelativeMatrix();
+
+    if (_parent != nullptr)
+    {
+        mutableThis->_worldMatrix *= _parent->_worldMatrix;
+        mutableThis->_parentVersion = _parent->_version;
+    }
+
+    mutableThis->_isWorldMatrixDirty = false;
+}
+
 bool Transform::IsWorldMatrixDirty() const
 {
     if (_parent != nullptr)
@@ -338,6 +356,11 @@ void Transform::MarkDirty()
     ++_version;
 }
 
+Matrix Transform::ComputeRelativeMatrix() const
+{
+    return Matrix::CreateScale(_scale) * Matrix::CreateFromQuaternion(_rotation) * Matrix::CreateTranslation(_location);
+}
+
 MemoryWriter& operator<<(MemoryWriter& writer, const Transform& transform)
 {
     writer << transform._location;
@@ -2,10 +2,12 @@
 
 #include "CoreMinimal.h"
 #include "MathFwd.h"
+#include "PassKey.h"
 
 class MemoryWriter;
 class MemoryReader;
 class BoundingBox;
+class TransformHierarchy;
 
 class Transform
 {
@@ -58,6 +60,12 @@ public:
     const Matrix& GetWorldMatrix() const;
     bool IsWorldMatrixDirty() const;
 
+    /**
+     * Recomputes world matrix if needed from the cached world matrix of parent, without walking up the hierarchy.
+     * Parent has to be up to date, TransformHierarchy guarantees that by updating transforms parents first.
+     */
+    void UpdateWorldMatrix(PassKey<TransformHierarchy>) const;
+
     Vector3 TransformDirection(const Vector3& direction) const;
 
     Vector3 operator*(const Vector3& vector) const;
@@ -83,6 +91,7 @@ private:
 
 private:
     void MarkDirty();
+    Matrix ComputeRelativeMatrix() const;
 };
 
 MemoryWriter& operator<<(MemoryWriter& writer, const Transform& transform);
@@ -1,29 +1,19 @@
 ﻿#include "MeshCollision.h"
 
 Vector3 MeshCollision::FurthestPointInDirection(const Vector3& direction) const
+{
+    uint32 vertexHint = 0;
+    return FurthestPointInDirection(direction, vertexHint);
+}
+
+Vector3 MeshCollision::FurthestPointInDirection(const Vector3& direction, uint32& vertexHint) const
 {
     if (Mesh == nullptr)
     {
         return {};
     }
 
-    Vector3 furthestPoint;
-    float maxDistance = -std::numeric_limits<float>::max();
-
-    const DArray<Vertex>& vertices = Mesh->GetLOD(0).Vertices;
-    for (uint32 i = 0; i < vertices.Count(); ++i)
-    {
-        const Vertex& vertex = vertices[i];
-
-        float distance = vertex.Position.Dot(direction);
-        if (distance > maxDistance)
-        {
-            maxDistance = distance;
-            furthestPoint = vertex.Position;
-        }
-    }
-
-    return furthestPoint;
+    return Mesh->GetCollisionHull().Support(direction, vertexHint);
 }
 
 MemoryWriter& operator<<(MemoryWriter& writer, const MeshCollision& meshCollision)
@@ -8,6 +8,10 @@ public:
     AssetPtr<StaticMesh> Mesh;
 
     Vector3 FurthestPointInDirection(const Vector3& direction) const;
+    /**
+     * Hill climbs the cooked hull of Mesh from vertexHint, which receives the found vertex.
+     */
+    Vector3 FurthestPointInDirection(const Vector3& direction, uint32& vertexHint) const;
 };
 
 MemoryWriter& operator<<(MemoryWriter& writer, const MeshCollision& meshCollision);
@@ -1,10 +1,8 @@
 ﻿#pragma once
 
 #include "Core.h"
-#include "IDGenerator.h"
+#include "Containers/SnapshotSlotArray.h"
 #include <functional>
-#include <map>
-#include <vector>
 
 struct DelegateHandle
 {
@@ -18,65 +16,63 @@ public:
     }
 };
 
+/**
+ * Multicast delegate with stable handles.
+ * Listeners can be added and removed from any thread, including from within a listener. Broadcast iterates the
+ * snapshot of listeners that was current when it started without taking the lock used by Add and Remove. Delegates
+ * without listeners return after a single atomic load, without loading the snapshot.
+ */
 template <typename... Args>
 class MulticastDelegate
 {
 public:
-    [[nodiscard]] DelegateHandle Add(std::function<void(Args...)>&& function)
-    {
-        const uint64 id = _idGenerator.GenerateID();
-        _functions.push_back({function, id});
+    using FunctionType = std::function<void(Args...)>;
 
-        _handleIDToIndex[id] = _functions.size() - 1;
+public:
+    [[nodiscard]] DelegateHandle Add(FunctionType&& function)
+    {
+        const DelegateHandle handle = {_functions.Add(std::move(function))};
+        _functions.ReclaimRetiredSnapshots();
 
-        return {id};
+        return handle;
     }
 
     void Remove(const DelegateHandle& handle)
     {
-        const auto it = _handleIDToIndex.find(handle.ID);
-        if (it == _handleIDToIndex.end())
-        {
-            return;
-        }
-
-        size_t index = it->second;
-        _handleIDToIndex.erase(handle.ID);
+        _functions.Remove(handle.ID);
+        _functions.ReclaimRetiredSnapshots();
+    }
 
-        if (index == _functions.size() - 1)
+    /**
+     * Calls every listener with given arguments. Arguments are taken by reference and handed to every listener as
+     * lvalues, so they are never copied into Broadcast or moved-from by an earlier listener.
+     */
+    void Broadcast(const std::remove_cvref_t<Args>&... args) const
+    {
+        if (_functions.IsEmpty())
         {
-            _functions.pop_back();
             return;
         }
-        
-        _functions[index] = _functions.back();
-        _functions.pop_back();
-
-        _handleIDToIndex[_functions[index].ID] = index;
-    }
 
-    void Broadcast(Args... args)
-    {
-        for (auto& function : _functions)
+        const auto snapshot = _functions.GetSnapshot();
+        for (const FunctionType& function : *snapshot)
         {
-            function.Function(std::forward<Args>(args)...);
+            function(args...);
         }
     }
 
     void Clear()
     {
-        _functions.clear();
+        _functions.Clear();
+        _functions.ReclaimRetiredSnapshots();
     }
 
-private:
-    struct FunctionWrapper
+    [[nodiscard]] bool IsBound() const
     {
-        std::function<void(Args...)> Function;
-        uint64 ID = 0;
-    };
-
-    std::vector<FunctionWrapper> _functions;
-    std::map<uint64, size_t> _handleIDToIndex;
+        return !_functions.IsEmpty();
+    }
 
-    IDGenerator<uint64> _idGenerator;
+private:
+    // Broadcast holds shared ownership of its snapshot, so replaced snapshots are reclaimed right away
+    SnapshotSlotArray<FunctionType> _functions;
 };
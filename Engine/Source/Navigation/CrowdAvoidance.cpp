@@ -0,0 +1,349 @@
+﻿#include "CrowdAvoidance.h"
+#include "Engine/Engine.h"
+#include "Math/Math.h"
+
+namespace CrowdAvoidanceMath
+{
+    constexpr float Epsilon = 0.00001f;
+
+    float Determinant(const Vector2& a, const Vector2& b)
+    {
+        return a.x * b.y - a.y * b.x;
+    }
+}
+
+void CrowdAvoidance::Initialize(const BoundingBox& bounds, float neighborDistance)
+{
+    _neighborDistance = neighborDistance;
+
+    const Vector3 size = bounds.GetMax() - bounds.GetMin();
+    _grid.Initialize(bounds, static_cast<uint32>(Math::Max(1.0f, Math::Max(size.x, size.y) / neighborDistance)));
+}
+
+void CrowdAvoidance::Clear()
+{
+    _positionsX.Clear();
+    _positionsY.Clear();
+    _velocitiesX.Clear();
+    _velocitiesY.Clear();
+    _preferredVelocitiesX.Clear();
+    _preferredVelocitiesY.Clear();
+    _radii.Clear();
+    _maxSpeeds.Clear();
+    _newVelocities.Clear();
+}
+
+uint32 CrowdAvoidance::AddAgent(const Vector2& position, const Vector2& velocity, const Vector2& preferredVelocity, float radius, float maxSpeed)
+{
+    _positionsX.Add(position.x);
+    _positionsY.Add(position.y);
+    _velocitiesX.Add(velocity.x);
+    _velocitiesY.Add(velocity.y);
+    _preferredVelocitiesX.Add(preferredVelocity.x);
+    _preferredVelocitiesY.Add(preferredVelocity.y);
+    _radii.Add(radius);
+    _maxSpeeds.Add(maxSpeed);
+    _newVelocities.Add(preferredVelocity);
+
+    return static_cast<uint32>(_positionsX.Count()) - 1;
+}
+
+void CrowdAvoidance::Solve(float deltaTime)
+{
+    const uint32 agentCount = GetAgentCount();
+    if (agentCount == 0 || deltaTime <= 0.0f)
+    {
+        return;
+    }
+
+    // Agents are points in the grid, neighbors are found by querying a box of neighbor distance around each agent
+    _grid.Build(agentCount, [this](uint32 agent, BoundingBox& outBounds)
+    {
+        const Vector3 location(_positionsX[agent], _positionsY[agent], 0.0f);
+        outBounds = BoundingBox(location, location);
+        return true;
+    });
+
+    Engine::Get().GetThreadPool().ParallelFor(agentCount, _agentsPerBatch, [this, deltaTime](uint32 begin, uint32 end)
+    {
+        for (uint32 agent = begin; agent < end; ++agent)
+        {
+            _newVelocities[agent] = SolveAgent(agent, deltaTime);
+        }
+    });
+}
+
+Vector2 CrowdAvoidance::GetVelocity(uint32 agent) const
+{
+    return _newVelocities[agent];
+}
+
+uint32 CrowdAvoidance::GetAgentCount() const
+{
+    return static_cast<uint32>(_positionsX.Count());
+}
+
+Vector2 CrowdAvoidance::SolveAgent(uint32 agent, float deltaTime) const
+{
+    const float positionX = _positionsX[agent];
+    const float positionY = _positionsY[agent];
+    const float radius = _radii[agent];
+
+    // Nearest neighbors sorted by distance, gathered into local arrays so constraints are built from contiguous data
+    float neighborDistancesSquared[MaxNeighbors];
+    uint32 neighbors[MaxNeighbors];
+    uint32 neighborCount = 0;
+
+    const float neighborDistanceSquared = _neighborDistance * _neighborDistance;
+    const Vector3 extent(_neighborDistance, _neighborDistance, 0.0f);
+    const Vector3 location(positionX, positionY, 0.0f);
+    _grid.ForEachItemAt(BoundingBox(location - extent, location + extent), [this, agent, positionX, positionY, neighborDistanceSquared, &neighborDistancesSquared, &neighbors, &neighborCount](uint32 other)
+    {
+        const float distanceX = _positionsX[other] - positionX;
+        const float distanceY = _positionsY[other] - positionY;
+        const float distanceSquared = distanceX * distanceX + distanceY * distanceY;
+        if (other == agent || distanceSquared >= neighborDistanceSquared)
+        {
+            return true;
+        }
+
+        if (neighborCount == MaxNeighbors && distanceSquared >= neighborDistancesSquared[MaxNeighbors - 1])
+        {
+            return true;
+        }
+
+        uint32 i = Math::Min(neighborCount, MaxNeighbors - 1);
+        for (; i > 0 && neighborDistancesSquared[i - 1] > distanceSquared; --i)
+        {
+            neighborDistancesSquared[i] = neighborDistancesSquared[i - 1];
+            neighbors[i] = neighbors[i - 1];
+        }
+
+        neighborDistancesSquared[i] = distanceSquared;
+        neighbors[i] = other;
+        neighborCount = Math::Min(neighborCount + 1, MaxNeighbors);
+
+        return true;
+    });
+
+    const Vector2 velocity(_velocitiesX[agent], _velocitiesY[agent]);
+    const Vector2 preferredVelocity(_preferredVelocitiesX[agent], _preferredVelocitiesY[agent]);
+    const float inverseTimeHorizon = 1.0f / _timeHorizon;
+    const float inverseDeltaTime = 1.0f / deltaTime;
+
+    Line lines[MaxNeighbors];
+    for (uint32 i = 0; i < neighborCount; ++i)
+    {
+        const uint32 other = neighbors[i];
+        const Vector2 relativePosition(_positionsX[other] - positionX, _positionsY[other] - positionY);
+        const Vector2 relativeVelocity = velocity - Vector2(_velocitiesX[other], _velocitiesY[other]);
+        const float distanceSquared = neighborDistancesSquared[i];
+        const float combinedRadius = radius + _radii[other];
+        const float combinedRadiusSquared = combinedRadius * combinedRadius;
+
+        Line& line = lines[i];
+        Vector2 u;
+
+        if (distanceSquared > combinedRadiusSquared)
+        {
+            // Vector from the cutoff center of the velocity obstacle to the relative velocity
+            const Vector2 w = relativeVelocity - relativePosition * inverseTimeHorizon;
+            const float wLengthSquared = w.LengthSquared();
+            const float dotProduct = w.Dot(relativePosition);
+
+            if (dotProduct < 0.0f && dotProduct * dotProduct > combinedRadiusSquared * wLengthSquared)
+            {
+                // Project on the cutoff circle
+                const float wLength = std::sqrt(wLengthSquared);
+                const Vector2 unitW = w / wLength;
+
+                line.Direction = Vector2(unitW.y, -unitW.x);
+                u = unitW * (combinedRadius * inverseTimeHorizon - wLength);
+            }
+            else
+            {
+                // Project on the closer leg of the cone
+                const float leg = std::sqrt(distanceSquared - combinedRadiusSquared);
+                if (CrowdAvoidanceMath::Determinant(relativePosition, w) > 0.0f)
+                {
+                    line.Direction = Vector2(relativePosition.x * leg - relativePosition.y * combinedRadius, relativePosition.x * combinedRadius + relativePosition.y * leg) / distanceSquared;
+                }
+                else
+                {
+                    line.Direction = -Vector2(relativePosition.x * leg + relativePosition.y * combinedRadius, -relativePosition.x * combinedRadius + relativePosition.y * leg) / distanceSquared;
+                }
+
+                u = line.Direction * relativeVelocity.Dot(line.Direction) - relativeVelocity;
+            }
+        }
+        else
+        {
+            // Agents already overlap, velocity obstacle is cut off at this tick to push them apart
+            const Vector2 w = relativeVelocity - relativePosition * inverseDeltaTime;
+            const float wLength = Math::Max(w.Length(), CrowdAvoidanceMath::Epsilon);
+            const Vector2 unitW = w / wLength;
+
+            line.Direction = Vector2(unitW.y, -unitW.x);
+            u = unitW * (combinedRadius * inverseDeltaTime - wLength);
+        }
+
+        line.Point = velocity + u * 0.5f;
+    }
+
+    const float maxSpeed = _maxSpeeds[agent];
+    Vector2 result;
+    const uint32 failedLine = Solve2(lines, neighborCount, maxSpeed, preferredVelocity, false, result);
+    if (failedLine < neighborCount)
+    {
+        Solve3(lines, neighborCount, failedLine, maxSpeed, result);
+    }
+
+    return result;
+}
+
+bool CrowdAvoidance::SolveLine(const Line* lines, uint32 lineIndex, float radius, const Vector2& optimalVelocity, bool isDirectionOptimal, Vector2& result)
+{
+    const Line& line = lines[lineIndex];
+    const float dotProduct = line.Point.Dot(line.Direction);
+    const float discriminant = dotProduct * dotProduct + radius * radius - line.Point.LengthSquared();
+    if (discriminant < 0.0f)
+    {
+        // Max speed circle doesn't reach the line
+        return false;
+    }
+
+    const float discriminantRoot = std::sqrt(discriminant);
+    float left = -dotProduct - discriminantRoot;
+    float right = -dotProduct + discriminantRoot;
+
+    for (uint32 i = 0; i < lineIndex; ++i)
+    {
+        const float denominator = CrowdAvoidanceMath::Determinant(line.Direction, lines[i].Direction);
+        const float numerator = CrowdAvoidanceMath::Determinant(lines[i].Direction, line.Point - lines[i].Point);
+
+        if (std::abs(denominator) <= CrowdAvoidanceMath::Epsilon)
+        {
+            // Lines are parallel
+            if (numerator < 0.0f)
+            {
+                return false;
+            }
+
+            continue;
+        }
+
+        const float t = numerator / denominator;
+        if (denominator >= 0.0f)
+        {
+            right = Math::Min(right, t);
+        }
+        else
+        {
+            left = Math::Max(left, t);
+        }
+
+        if (left > right)
+        {
+            return false;
+        }
+    }
+
+    if (isDirectionOptimal)
+    {
+        result = line.Point + line.Direction * (optimalVelocity.Dot(line.Direction) > 0.0f ? right : left);
+    }
+    else
+    {
+        const float t = line.Direction.Dot(optimalVelocity - line.Point);
+        result = line.Point + line.Direction * Math::Clamp(t, left, right);
+    }
+
+    return true;
+}
+
+uint32 CrowdAvoidance::Solve2(const Line* lines, uint32 lineCount, float radius, const Vector2& optimalVelocity, bool isDirectionOptimal, Vector2& result)
+{
+    if (isDirectionOptimal)
+    {
+        // Optimal velocity is a unit direction here
+        result = optimalVelocity * radius;
+    }
+    else if (optimalVelocity.LengthSquared() > radius * radius)
+    {
+        Vector2 direction = optimalVelocity;
+        direction.Normalize();
+        result = direction * radius;
+    }
+    else
+    {
+        result = optimalVelocity;
+    }
+
+    for (uint32 i = 0; i < lineCount; ++i)
+    {
+        if (CrowdAvoidanceMath::Determinant(lines[i].Direction, lines[i].Point - result) > 0.0f)
+        {
+            // Result violates constraint of line i, move it onto the line
+            const Vector2 previousResult = result;
+            if (!SolveLine(lines, i, radius, optimalVelocity, isDirectionOptimal, result))
+            {
+                result = previousResult;
+                return i;
+            }
+        }
+    }
+
+    return lineCount;
+}
+
+void CrowdAvoidance::Solve3(const Line* lines, uint32 lineCount, uint32 beginLine, float radius, Vector2& result)
+{
+    // No velocity satisfies all constraints, minimize the largest violation instead
+    float distance = 0.0f;
+
+    for (uint32 i = beginLine; i < lineCount; ++i)
+    {
+        if (CrowdAvoidanceMath::Determinant(lines[i].Direction, lines[i].Point - result) <= distance)
+        {
+            continue;
+        }
+
+        Line projectedLines[MaxNeighbors];
+        uint32 projectedLineCount = 0;
+
+        for (uint32 j = 0; j < i; ++j)
+        {
+            Line& projectedLine = projectedLines[projectedLineCount];
+            const float determinant = CrowdAvoidanceMath::Determinant(lines[i].Direction, lines[j].Direction);
+
+            if (std::abs(determinant) <= CrowdAvoidanceMath::Epsilon)
+            {
+                if (lines[i].Direction.Dot(lines[j].Direction) > 0.0f)
+                {
+                    // Lines point the same way
+                    continue;
+                }
+
+                projectedLine.Point = (lines[i].Point + lines[j].Point) * 0.5f;
+            }
+            else
+            {
+                const float t = CrowdAvoidanceMath::Determinant(lines[j].Direction, lines[i].Point - lines[j].Point) / determinant;
+                projectedLine.Point = lines[i].Point + lines[i].Direction * t;
+            }
+
+            projectedLine.Direction = lines[j].Direction - lines[i].Direction;
+            projectedLine.Direction.Normalize();
+            ++projectedLineCount;
+        }
+
+        const Vector2 previousResult = result;
+        if (Solve2(projectedLines, projectedLineCount, radius, Vector2(-lines[i].Direction.y, lines[i].Direction.x), true, result) < projectedLineCount)
+        {
+            // Can only happen because of floating point error, result is kept as it was
+            result = previousResult;
+        }
+
+        distance = CrowdAvoidanceMath::Determinant(lines[i].Direction, lines[i].Point - result);
+    }
+}
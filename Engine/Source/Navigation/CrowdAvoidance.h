@@ -0,0 +1,65 @@
+﻿#pragma once
+
+#include "Core.h"
+#include "BoundingBox.h"
+#include "Containers/DArray.h"
+#include "Containers/Spatialization/SpatialHashGrid3D.h"
+
+/**
+ * Reciprocal collision avoidance (ORCA) for agents moving in the XY plane.
+ * Every agent picks the velocity closest to its preferred one that keeps it from colliding with its nearest
+ * neighbors within the time horizon, assuming each neighbor takes half of the responsibility for avoiding it.
+ * Agents are added every tick, solved in parallel and read back by index.
+ */
+class CrowdAvoidance
+{
+public:
+    static constexpr uint32 MaxNeighbors = 10;
+
+public:
+    void Initialize(const BoundingBox& bounds, float neighborDistance);
+
+    void Clear();
+    uint32 AddAgent(const Vector2& position, const Vector2& velocity, const Vector2& preferredVelocity, float radius, float maxSpeed);
+
+    void Solve(float deltaTime);
+
+    Vector2 GetVelocity(uint32 agent) const;
+    uint32 GetAgentCount() const;
+
+private:
+    struct Line
+    {
+        Vector2 Point;
+        Vector2 Direction;
+    };
+
+    // Collisions further in the future than this don't constrain velocities
+    static constexpr float _timeHorizon = 2.0f;
+    static constexpr uint32 _agentsPerBatch = 64;
+
+    float _neighborDistance = 0.0f;
+    SpatialHashGrid3D _grid;
+
+    // Agent data is kept in separate arrays, so neighbor scans only touch what they read
+    DArray<float> _positionsX;
+    DArray<float> _positionsY;
+    DArray<float> _velocitiesX;
+    DArray<float> _velocitiesY;
+    DArray<float> _preferredVelocitiesX;
+    DArray<float> _preferredVelocitiesY;
+    DArray<float> _radii;
+    DArray<float> _maxSpeeds;
+    DArray<Vector2> _newVelocities;
+
+private:
+    Vector2 SolveAgent(uint32 agent, float deltaTime) const;
+
+    /**
+     * Linear programs over half-planes left of each line, as described in the ORCA paper. Solve2 returns the index of
+     * the line it failed on, or lineCount if the result satisfies all lines.
+     */
+    static bool SolveLine(const Line* lines, uint32 lineIndex, float radius, const Vector2& optimalVelocity, bool isDirectionOptimal, Vector2& result);
+    static uint32 Solve2(const Line* lines, uint32 lineCount, float radius, const Vector2& optimalVelocity, bool isDirectionOptimal, Vector2& result);
+    static void Solve3(const Line* lines, uint32 lineCount, uint32 beginLine, float radius, Vector2& result);
+};
@@ -0,0 +1,99 @@
+﻿#include "FlowField.h"
+#include "NavigationGrid.h"
+#include <queue>
+
+void FlowField::Build(const NavigationGrid& grid, uint32 goalCell)
+{
+    const uint32 cellCount = grid.GetCellCount();
+    _goalCell = goalCell;
+
+    _integration.Clear();
+    _directions.Clear();
+    _integration.Reserve(cellCount);
+    _directions.Reserve(cellCount);
+    for (uint32 i = 0; i < cellCount; ++i)
+    {
+        _integration.Add(Unreachable);
+        _directions.Add(NoDirection);
+    }
+
+    if (grid.IsBlocked(goalCell))
+    {
+        return;
+    }
+
+    // Dijkstra from the goal over cell costs
+    using QueueEntry = std::pair<float, uint32>;
+    std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> queue;
+
+    _integration[goalCell] = 0.0f;
+    queue.push({0.0f, goalCell});
+
+    while (!queue.empty())
+    {
+        const auto [cost, cell] = queue.top();
+        queue.pop();
+
+        if (cost > _integration[cell])
+        {
+            continue;
+        }
+
+        grid.ForEachNeighbor(cell, [this, &grid, &queue, cost](uint32 neighbor, float stepLength, uint8 direction)
+        {
+            const float neighborCost = cost + stepLength * static_cast<float>(grid.GetCost(neighbor));
+            if (neighborCost < _integration[neighbor])
+            {
+                _integration[neighbor] = neighborCost;
+                queue.push({neighborCost, neighbor});
+            }
+        });
+    }
+
+    for (uint32 cell = 0; cell < cellCount; ++cell)
+    {
+        if (cell == goalCell || _integration[cell] == Unreachable)
+        {
+            continue;
+        }
+
+        float lowestCost = _integration[cell];
+        grid.ForEachNeighbor(cell, [this, cell, &lowestCost](uint32 neighbor, float stepLength, uint8 direction)
+        {
+            if (_integration[neighbor] < lowestCost)
+            {
+                lowestCost = _integration[neighbor];
+                _directions[cell] = direction;
+            }
+        });
+    }
+}
+
+Vector2 FlowField::GetDirection(uint32 cell) const
+{
+    const uint8 direction = _directions[cell];
+    if (direction == NoDirection)
+    {
+        return Vector2::Zero;
+    }
+
+    Vector2 result(static_cast<float>(NavigationGrid::NeighborOffsetsX[direction]), static_cast<float>(NavigationGrid::NeighborOffsetsY[direction]));
+    result.Normalize();
+
+    return result;
+}
+
+bool FlowField::IsReachable(uint32 cell) const
+{
+    return _integration[cell] != Unreachable;
+}
+
+float FlowField::GetIntegratedCost(uint32 cell) const
+{
+    return _integration[cell];
+}
+
+uint32 FlowField::GetGoalCell() const
+{
+    return _goalCell;
+}
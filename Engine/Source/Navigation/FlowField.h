@@ -0,0 +1,36 @@
+﻿#pragma once
+
+#include "Core.h"
+#include "Containers/DArray.h"
+#include "Math/MathFwd.h"
+
+class NavigationGrid;
+
+/**
+ * Direction towards one goal cell for every cell of a navigation grid.
+ * Built from an integration field holding the cheapest travel cost from each cell to the goal, any number of agents
+ * heading to the same goal share one field and only sample it.
+ */
+class FlowField
+{
+public:
+    void Build(const NavigationGrid& grid, uint32 goalCell);
+
+    /**
+     * Unit direction in the XY plane, zero in the goal cell and in cells from which the goal can't be reached.
+     */
+    Vector2 GetDirection(uint32 cell) const;
+    bool IsReachable(uint32 cell) const;
+    float GetIntegratedCost(uint32 cell) const;
+
+    uint32 GetGoalCell() const;
+
+private:
+    static constexpr uint8 NoDirection = std::numeric_limits<uint8>::max();
+    static constexpr float Unreachable = std::numeric_limits<float>::max();
+
+    uint32 _goalCell = 0;
+    DArray<float> _integration;
+    // Index of the neighbor to move to from each cell, NoDirection in the goal and in unreachable cells
+    DArray<uint8> _directions;
+};
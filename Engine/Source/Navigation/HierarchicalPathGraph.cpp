@@ -0,0 +1,470 @@
+﻿#include "HierarchicalPathGraph.h"
+#include "NavigationGrid.h"
+#include "Math/Math.h"
+#include <queue>
+#include <unordered_map>
+
+void HierarchicalPathGraph::Build(const NavigationGrid& grid, uint32 clusterSize)
+{
+    _grid = &grid;
+    _clusterSize = Math::Max(clusterSize, 1u);
+    _clusterCountX = (grid.GetWidth() + _clusterSize - 1) / _clusterSize;
+    _clusterCountY = (grid.GetHeight() + _clusterSize - 1) / _clusterSize;
+
+    _nodes.Clear();
+    _edges.Clear();
+    _clusterNodeOffsets.Clear();
+    _clusterNodes.Clear();
+
+    DArray<DArray<Edge>> adjacency;
+    std::unordered_map<uint32, uint32> cellNodes;
+
+    const auto addNode = [this, &adjacency, &cellNodes](uint32 cell)
+    {
+        const auto [it, isInserted] = cellNodes.try_emplace(cell, static_cast<uint32>(_nodes.Count()));
+        if (isInserted)
+        {
+            Node& node = _nodes.AddDefault();
+            node.Cell = cell;
+            node.Cluster = GetCluster(cell);
+            adjacency.AddDefault();
+        }
+
+        return it->second;
+    };
+
+    const auto addPortal = [&grid, &adjacency, &addNode](uint32 cellA, uint32 cellB)
+    {
+        const uint32 nodeA = addNode(cellA);
+        const uint32 nodeB = addNode(cellB);
+        const float cost = (static_cast<float>(grid.GetCost(cellA)) + static_cast<float>(grid.GetCost(cellB))) * 0.5f;
+
+        adjacency[nodeA].Add({nodeB, cost});
+        adjacency[nodeB].Add({nodeA, cost});
+    };
+
+    // getCells(i, cellA, cellB) returns the pair of cells facing each other at position i along one cluster border
+    const auto addEntrances = [&grid, &addPortal](uint32 length, const auto& getCells)
+    {
+        uint32 cellA = 0;
+        uint32 cellB = 0;
+        uint32 runStart = 0;
+        bool isInRun = false;
+
+        for (uint32 i = 0; i <= length; ++i)
+        {
+            bool isOpen = false;
+            if (i < length)
+            {
+                getCells(i, cellA, cellB);
+                isOpen = !grid.IsBlocked(cellA) && !grid.IsBlocked(cellB);
+            }
+
+            if (isOpen && !isInRun)
+            {
+                runStart = i;
+                isInRun = true;
+            }
+            else if (!isOpen && isInRun)
+            {
+                isInRun = false;
+
+                const uint32 runLength = i - runStart;
+                if (runLength > _longEntranceLength)
+                {
+                    getCells(runStart, cellA, cellB);
+                    addPortal(cellA, cellB);
+                    getCells(i - 1, cellA, cellB);
+                    addPortal(cellA, cellB);
+                }
+                else
+                {
+                    getCells(runStart + runLength / 2, cellA, cellB);
+                    addPortal(cellA, cellB);
+                }
+            }
+        }
+    };
+
+    for (uint32 clusterY = 0; clusterY < _clusterCountY; ++clusterY)
+    {
+        for (uint32 clusterX = 0; clusterX < _clusterCountX; ++clusterX)
+        {
+            const CellRect rect = GetClusterRect(clusterY * _clusterCountX + clusterX);
+
+            // Border with the next cluster along X
+            if (rect.MaxX < grid.GetWidth())
+            {
+                addEntrances(rect.MaxY - rect.MinY, [&grid, &rect](uint32 i, uint32& outCellA, uint32& outCellB)
+                {
+                    outCellA = grid.GetCell(rect.MaxX - 1, rect.MinY + i);
+                    outCellB = grid.GetCell(rect.MaxX, rect.MinY + i);
+                });
+            }
+
+            // Border with the next cluster along Y
+            if (rect.MaxY < grid.GetHeight())
+            {
+                addEntrances(rect.MaxX - rect.MinX, [&grid, &rect](uint32 i, uint32& outCellA, uint32& outCellB)
+                {
+                    outCellA = grid.GetCell(rect.MinX + i, rect.MaxY - 1);
+                    outCellB = grid.GetCell(rect.MinX + i, rect.MaxY);
+                });
+            }
+        }
+    }
+
+    const uint32 clusterCount = GetClusterCount();
+    for (uint32 cluster = 0; cluster < clusterCount; ++cluster)
+    {
+        _clusterNodeOffsets.Add(static_cast<uint32>(_clusterNodes.Count()));
+        for (uint32 node = 0; node < _nodes.Count(); ++node)
+        {
+            if (_nodes[node].Cluster == cluster)
+            {
+                _clusterNodes.Add(node);
+            }
+        }
+    }
+    _clusterNodeOffsets.Add(static_cast<uint32>(_clusterNodes.Count()));
+
+    // Portals of one cluster are connected by the cost of the cheapest path between them that stays in the cluster
+    DArray<float> costs;
+    DArray<uint32> parents;
+    for (uint32 cluster = 0; cluster < clusterCount; ++cluster)
+    {
+        const CellRect rect = GetClusterRect(cluster);
+        for (uint32 i = _clusterNodeOffsets[cluster]; i < _clusterNodeOffsets[cluster + 1]; ++i)
+        {
+            const uint32 node = _clusterNodes[i];
+            SearchRect(rect, _nodes[node].Cell, NoCell, costs, parents);
+
+            for (uint32 j = _clusterNodeOffsets[cluster]; j < _clusterNodeOffsets[cluster + 1]; ++j)
+            {
+                const uint32 otherNode = _clusterNodes[j];
+                const float cost = costs[GetLocalIndex(rect, _nodes[otherNode].Cell)];
+                if (otherNode != node && cost != Unreachable)
+                {
+                    adjacency[node].Add({otherNode, cost});
+                }
+            }
+        }
+    }
+
+    for (uint32 i = 0; i < _nodes.Count(); ++i)
+    {
+        Node& node = _nodes[i];
+        node.FirstEdge = static_cast<uint32>(_edges.Count());
+        node.EdgeCount = static_cast<uint32>(adjacency[i].Count());
+
+        for (const Edge& edge : adjacency[i])
+        {
+            _edges.Add(edge);
+        }
+    }
+}
+
+bool HierarchicalPathGraph::FindPath(uint32 startCell, uint32 goalCell, DArray<uint32>& outCells) const
+{
+    if (_grid == nullptr || _grid->IsBlocked(startCell) || _grid->IsBlocked(goalCell))
+    {
+        return false;
+    }
+
+    if (startCell == goalCell)
+    {
+        outCells.Add(startCell);
+        return true;
+    }
+
+    const uint32 startCluster = GetCluster(startCell);
+    const uint32 goalCluster = GetCluster(goalCell);
+    const CellRect startRect = GetClusterRect(startCluster);
+    const CellRect goalRect = GetClusterRect(goalCluster);
+
+    // Path may have to leave the cluster even if both cells are in it, portals are searched if it does
+    if (startCluster == goalCluster && FindLocalPath(startRect, startCell, goalCell, outCells))
+    {
+        return true;
+    }
+
+    // Start and goal are joined to portals of their clusters as two extra nodes that only exist in this search,
+    // so the graph itself is never modified by a query
+    DArray<float> startCosts;
+    DArray<float> goalCosts;
+    DArray<uint32> parents;
+    SearchRect(startRect, startCell, NoCell, startCosts, parents);
+    SearchRect(goalRect, goalCell, NoCell, goalCosts, parents);
+
+    const uint32 nodeCount = static_cast<uint32>(_nodes.Count());
+    const uint32 startNode = nodeCount;
+    const uint32 goalNode = nodeCount + 1;
+
+    const auto getNodeCell = [this, startNode, goalNode, startCell, goalCell](uint32 node)
+    {
+        return node == startNode ? startCell : node == goalNode ? goalCell : _nodes[node].Cell;
+    };
+
+    DArray<float> costs;
+    DArray<uint32> nodeParents;
+    DArray<bool> isClosed;
+    costs.Reserve(nodeCount + 2);
+    nodeParents.Reserve(nodeCount + 2);
+    isClosed.Reserve(nodeCount + 2);
+    for (uint32 i = 0; i < nodeCount + 2; ++i)
+    {
+        costs.Add(Unreachable);
+        nodeParents.Add(NoCell);
+        isClosed.Add(false);
+    }
+
+    using QueueEntry = std::pair<float, uint32>;
+    std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> queue;
+
+    const auto relax = [this, &costs, &nodeParents, &queue, &getNodeCell, goalCell](uint32 from, uint32 to, float edgeCost)
+    {
+        const float cost = costs[from] + edgeCost;
+        if (cost < costs[to])
+        {
+            costs[to] = cost;
+            nodeParents[to] = from;
+            queue.push({cost + GetHeuristic(getNodeCell(to), goalCell), to});
+        }
+    };
+
+    costs[startNode] = 0.0f;
+    queue.push({GetHeuristic(startCell, goalCell), startNode});
+
+    while (!queue.empty())
+    {
+        const uint32 node = queue.top().second;
+        queue.pop();
+
+        if (isClosed[node])
+        {
+            continue;
+        }
+
+        isClosed[node] = true;
+        if (node == goalNode)
+        {
+            break;
+        }
+
+        if (node == startNode)
+        {
+            for (uint32 i = _clusterNodeOffsets[startCluster]; i < _clusterNodeOffsets[startCluster + 1]; ++i)
+            {
+                const float cost = startCosts[GetLocalIndex(startRect, _nodes[_clusterNodes[i]].Cell)];
+                if (cost != Unreachable)
+                {
+                    relax(startNode, _clusterNodes[i], cost);
+                }
+            }
+
+            continue;
+        }
+
+        const Node& current = _nodes[node];
+        for (uint32 i = current.FirstEdge; i < current.FirstEdge + current.EdgeCount; ++i)
+        {
+            relax(node, _edges[i].Target, _edges[i].Cost);
+        }
+
+        if (current.Cluster == goalCluster)
+        {
+            const float cost = goalCosts[GetLocalIndex(goalRect, current.Cell)];
+            if (cost != Unreachable)
+            {
+                relax(node, goalNode, cost);
+            }
+        }
+    }
+
+    if (costs[goalNode] == Unreachable)
+    {
+        return false;
+    }
+
+    DArray<uint32> nodePath;
+    for (uint32 node = goalNode; node != NoCell; node = nodeParents[node])
+    {
+        nodePath.Add(node);
+    }
+
+    // Consecutive nodes in one cluster are refined by a local search, nodes in different clusters are portal pairs
+    // whose cells are neighbors
+    DArray<uint32> cells;
+    cells.Add(startCell);
+    for (uint32 i = static_cast<uint32>(nodePath.Count()) - 1; i > 0; --i)
+    {
+        const uint32 fromCell = getNodeCell(nodePath[i]);
+        const uint32 toCell = getNodeCell(nodePath[i - 1]);
+        if (fromCell == toCell)
+        {
+            continue;
+        }
+
+        const uint32 cluster = GetCluster(fromCell);
+        if (cluster != GetCluster(toCell))
+        {
+            cells.Add(toCell);
+            continue;
+        }
+
+        DArray<uint32> segment;
+        if (!FindLocalPath(GetClusterRect(cluster), fromCell, toCell, segment))
+        {
+            return false;
+        }
+
+        for (uint32 j = 1; j < segment.Count(); ++j)
+        {
+            cells.Add(segment[j]);
+        }
+    }
+
+    for (const uint32 cell : cells)
+    {
+        outCells.Add(cell);
+    }
+
+    return true;
+}
+
+uint32 HierarchicalPathGraph::GetNodeCount() const
+{
+    return static_cast<uint32>(_nodes.Count());
+}
+
+uint32 HierarchicalPathGraph::GetClusterCount() const
+{
+    return _clusterCountX * _clusterCountY;
+}
+
+uint32 HierarchicalPathGraph::GetCluster(uint32 cell) const
+{
+    const uint32 x = cell % _grid->GetWidth();
+    const uint32 y = cell / _grid->GetWidth();
+
+    return y / _clusterSize * _clusterCountX + x / _clusterSize;
+}
+
+HierarchicalPathGraph::CellRect HierarchicalPathGraph::GetClusterRect(uint32 cluster) const
+{
+    CellRect rect;
+    rect.MinX = cluster % _clusterCountX * _clusterSize;
+    rect.MinY = cluster / _clusterCountX * _clusterSize;
+    rect.MaxX = Math::Min(rect.MinX + _clusterSize, _grid->GetWidth());
+    rect.MaxY = Math::Min(rect.MinY + _clusterSize, _grid->GetHeight());
+
+    return rect;
+}
+
+uint32 HierarchicalPathGraph::GetLocalIndex(const CellRect& rect, uint32 cell) const
+{
+    const uint32 x = cell % _grid->GetWidth();
+    const uint32 y = cell / _grid->GetWidth();
+
+    return (y - rect.MinY) * (rect.MaxX - rect.MinX) + x - rect.MinX;
+}
+
+float HierarchicalPathGraph::GetHeuristic(uint32 fromCell, uint32 toCell) const
+{
+    // Octile distance, every cell costs at least NavigationGrid::DefaultCost so it never overestimates
+    constexpr float diagonalLength = 1.41421356f;
+
+    const int32 width = static_cast<int32>(_grid->GetWidth());
+    const int32 distanceX = std::abs(static_cast<int32>(fromCell) % width - static_cast<int32>(toCell) % width);
+    const int32 distanceY = std::abs(static_cast<int32>(fromCell) / width - static_cast<int32>(toCell) / width);
+    const float diagonal = static_cast<float>(Math::Min(distanceX, distanceY));
+    const float straight = static_cast<float>(Math::Max(distanceX, distanceY)) - diagonal;
+
+    return (straight + diagonal * diagonalLength) * static_cast<float>(NavigationGrid::DefaultCost);
+}
+
+void HierarchicalPathGraph::SearchRect(const CellRect& rect, uint32 startCell, uint32 goalCell, DArray<float>& outCosts, DArray<uint32>& outParents) const
+{
+    const uint32 cellCount = (rect.MaxX - rect.MinX) * (rect.MaxY - rect.MinY);
+
+    outCosts.Clear();
+    outParents.Clear();
+    DArray<bool> isClosed;
+    isClosed.Reserve(cellCount);
+    for (uint32 i = 0; i < cellCount; ++i)
+    {
+        outCosts.Add(Unreachable);
+        outParents.Add(NoCell);
+        isClosed.Add(false);
+    }
+
+    using QueueEntry = std::pair<float, uint32>;
+    std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> queue;
+
+    outCosts[GetLocalIndex(rect, startCell)] = 0.0f;
+    queue.push({goalCell != NoCell ? GetHeuristic(startCell, goalCell) : 0.0f, startCell});
+
+    const uint32 width = _grid->GetWidth();
+    while (!queue.empty())
+    {
+        const uint32 cell = queue.top().second;
+        queue.pop();
+
+        const uint32 index = GetLocalIndex(rect, cell);
+        if (isClosed[index])
+        {
+            continue;
+        }
+
+        isClosed[index] = true;
+        if (cell == goalCell)
+        {
+            break;
+        }
+
+        const float cost = outCosts[index];
+        _grid->ForEachNeighbor(cell, [this, &rect, &outCosts, &outParents, &queue, goalCell, width, cell, cost](uint32 neighbor, float stepLength, uint8 direction)
+        {
+            const uint32 x = neighbor % width;
+            const uint32 y = neighbor / width;
+            if (x < rect.MinX || x >= rect.MaxX || y < rect.MinY || y >= rect.MaxY)
+            {
+                return;
+            }
+
+            const uint32 neighborIndex = GetLocalIndex(rect, neighbor);
+            const float neighborCost = cost + stepLength * static_cast<float>(_grid->GetCost(neighbor));
+            if (neighborCost < outCosts[neighborIndex])
+            {
+                outCosts[neighborIndex] = neighborCost;
+                outParents[neighborIndex] = cell;
+                queue.push({neighborCost + (goalCell != NoCell ? GetHeuristic(neighbor, goalCell) : 0.0f), neighbor});
+            }
+        });
+    }
+}
+
+bool HierarchicalPathGraph::FindLocalPath(const CellRect& rect, uint32 startCell, uint32 goalCell, DArray<uint32>& outCells) const
+{
+    DArray<float> costs;
+    DArray<uint32> parents;
+    SearchRect(rect, startCell, goalCell, costs, parents);
+
+    if (costs[GetLocalIndex(rect, goalCell)] == Unreachable)
+    {
+        return false;
+    }
+
+    DArray<uint32> reversedCells;
+    for (uint32 cell = goalCell; cell != NoCell; cell = parents[GetLocalIndex(rect, cell)])
+    {
+        reversedCells.Add(cell);
+    }
+
+    for (uint32 i = static_cast<uint32>(reversedCells.Count()); i > 0; --i)
+    {
+        outCells.Add(reversedCells[i - 1]);
+    }
+
+    return true;
+}
@@ -0,0 +1,83 @@
+﻿#pragma once
+
+#include "Core.h"
+#include "Containers/DArray.h"
+
+class NavigationGrid;
+
+/**
+ * Abstract graph for hierarchical A* over a navigation grid.
+ * The grid is split into square clusters and every open stretch of a border between two clusters gets a pair of
+ * portal nodes, one on each side. Portals of one cluster are connected by the cost of the cheapest path between them
+ * inside the cluster, so a path is searched over portals first and only refined cell by cell in clusters it crosses.
+ */
+class HierarchicalPathGraph
+{
+public:
+    void Build(const NavigationGrid& grid, uint32 clusterSize);
+
+    /**
+     * Appends cells of a path from startCell to goalCell to outCells, including both of them.
+     * Returns false and leaves outCells as it is if goal can't be reached. Safe to call from multiple threads
+     * between builds.
+     */
+    bool FindPath(uint32 startCell, uint32 goalCell, DArray<uint32>& outCells) const;
+
+    uint32 GetNodeCount() const;
+    uint32 GetClusterCount() const;
+
+private:
+    struct Node
+    {
+        uint32 Cell = 0;
+        uint32 Cluster = 0;
+        uint32 FirstEdge = 0;
+        uint32 EdgeCount = 0;
+    };
+
+    struct Edge
+    {
+        uint32 Target = 0;
+        float Cost = 0.0f;
+    };
+
+    // Rectangle of cells a local search is limited to, max coordinates are exclusive
+    struct CellRect
+    {
+        uint32 MinX = 0;
+        uint32 MinY = 0;
+        uint32 MaxX = 0;
+        uint32 MaxY = 0;
+    };
+
+    static constexpr uint32 NoCell = std::numeric_limits<uint32>::max();
+    static constexpr float Unreachable = std::numeric_limits<float>::max();
+
+    // Open border stretches longer than this get portals at both ends instead of one in the middle
+    static constexpr uint32 _longEntranceLength = 6;
+
+    const NavigationGrid* _grid = nullptr;
+    uint32 _clusterSize = 0;
+    uint32 _clusterCountX = 0;
+    uint32 _clusterCountY = 0;
+
+    DArray<Node> _nodes;
+    DArray<Edge> _edges;
+
+    // Nodes of cluster i are _clusterNodes[_clusterNodeOffsets[i]] up to _clusterNodes[_clusterNodeOffsets[i + 1]]
+    DArray<uint32> _clusterNodeOffsets;
+    DArray<uint32> _clusterNodes;
+
+private:
+    uint32 GetCluster(uint32 cell) const;
+    CellRect GetClusterRect(uint32 cluster) const;
+    uint32 GetLocalIndex(const CellRect& rect, uint32 cell) const;
+    float GetHeuristic(uint32 fromCell, uint32 toCell) const;
+
+    /**
+     * Searches cells of rect from startCell, stops once goalCell is reached or runs until all reachable cells are
+     * visited if goalCell is NoCell. Costs and parents are indexed by GetLocalIndex.
+     */
+    void SearchRect(const CellRect& rect, uint32 startCell, uint32 goalCell, DArray<float>& outCosts, DArray<uint32>& outParents) const;
+    bool FindLocalPath(const CellRect& rect, uint32 startCell, uint32 goalCell, DArray<uint32>& outCells) const;
+};
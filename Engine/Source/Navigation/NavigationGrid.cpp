@@ -0,0 +1,98 @@
+﻿#include "NavigationGrid.h"
+#include "Math/Math.h"
+
+void NavigationGrid::Initialize(const BoundingBox& bounds, float cellSize)
+{
+    const Vector3 size = bounds.GetMax() - bounds.GetMin();
+
+    _origin = Vector2(bounds.GetMin().x, bounds.GetMin().y);
+    _cellSize = cellSize;
+    _width = static_cast<uint32>(Math::Max(1.0f, std::ceil(size.x / cellSize)));
+    _height = static_cast<uint32>(Math::Max(1.0f, std::ceil(size.y / cellSize)));
+
+    _costs.Clear();
+    _costs.Reserve(_width * _height);
+    for (uint32 i = 0; i < _width * _height; ++i)
+    {
+        _costs.Add(DefaultCost);
+    }
+
+    ++_version;
+}
+
+void NavigationGrid::SetCost(const BoundingBox& area, uint8 cost)
+{
+    const uint32 minX = GetCoordinate(area.GetMin().x, _origin.x, _width);
+    const uint32 minY = GetCoordinate(area.GetMin().y, _origin.y, _height);
+    const uint32 maxX = GetCoordinate(area.GetMax().x, _origin.x, _width);
+    const uint32 maxY = GetCoordinate(area.GetMax().y, _origin.y, _height);
+
+    for (uint32 y = minY; y <= maxY; ++y)
+    {
+        for (uint32 x = minX; x <= maxX; ++x)
+        {
+            _costs[GetCell(x, y)] = Math::Max(cost, DefaultCost);
+        }
+    }
+
+    ++_version;
+}
+
+uint8 NavigationGrid::GetCost(uint32 cell) const
+{
+    return _costs[cell];
+}
+
+bool NavigationGrid::IsBlocked(uint32 cell) const
+{
+    return _costs[cell] == BlockedCost;
+}
+
+uint32 NavigationGrid::GetCell(const Vector3& location) const
+{
+    return GetCell(GetCoordinate(location.x, _origin.x, _width), GetCoordinate(location.y, _origin.y, _height));
+}
+
+uint32 NavigationGrid::GetCell(uint32 x, uint32 y) const
+{
+    return y * _width + x;
+}
+
+Vector3 NavigationGrid::GetCellCenter(uint32 cell, float z) const
+{
+    const float x = _origin.x + (static_cast<float>(cell % _width) + 0.5f) * _cellSize;
+    const float y = _origin.y + (static_cast<float>(cell / _width) + 0.5f) * _cellSize;
+
+    return Vector3(x, y, z);
+}
+
+uint32 NavigationGrid::GetWidth() const
+{
+    return _width;
+}
+
+uint32 NavigationGrid::GetHeight() const
+{
+    return _height;
+}
+
+uint32 NavigationGrid::GetCellCount() const
+{
+    return _width * _height;
+}
+
+float NavigationGrid::GetCellSize() const
+{
+    return _cellSize;
+}
+
+uint32 NavigationGrid::GetVersion() const
+{
+    return _version;
+}
+
+uint32 NavigationGrid::GetCoordinate(float value, float origin, uint32 count) const
+{
+    const int64 coordinate = Math::FloorToInt((value - origin) / _cellSize);
+    return static_cast<uint32>(Math::Clamp(coordinate, static_cast<int64>(0), static_cast<int64>(count) - 1));
+}
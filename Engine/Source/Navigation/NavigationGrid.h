@@ -0,0 +1,98 @@
+﻿#pragma once
+
+#include "Core.h"
+#include "BoundingBox.h"
+#include "Containers/DArray.h"
+
+/**
+ * Uniform grid of traversal costs over the XY plane of the world, cells are indexed row by row.
+ */
+class NavigationGrid
+{
+public:
+    static constexpr uint8 DefaultCost = 1;
+    static constexpr uint8 BlockedCost = std::numeric_limits<uint8>::max();
+
+    static constexpr uint8 NeighborCount = 8;
+    static constexpr int32 NeighborOffsetsX[NeighborCount] = {1, -1, 0, 0, 1, 1, -1, -1};
+    static constexpr int32 NeighborOffsetsY[NeighborCount] = {0, 0, 1, -1, 1, -1, 1, -1};
+
+public:
+    void Initialize(const BoundingBox& bounds, float cellSize);
+
+    /**
+     * Sets cost of all cells overlapped by area in the XY plane, BlockedCost makes the cells impassable.
+     */
+    void SetCost(const BoundingBox& area, uint8 cost);
+    uint8 GetCost(uint32 cell) const;
+    bool IsBlocked(uint32 cell) const;
+
+    /**
+     * Returns the cell containing location, locations outside of the grid are clamped to the nearest cell.
+     */
+    uint32 GetCell(const Vector3& location) const;
+    uint32 GetCell(uint32 x, uint32 y) const;
+    Vector3 GetCellCenter(uint32 cell, float z = 0.0f) const;
+
+    /**
+     * Calls func(neighborCell, stepLength, direction) for neighbors that can be entered from cell, diagonal moves
+     * are only allowed if they don't cut the corner of a blocked cell.
+     */
+    template <typename FuncType>
+    void ForEachNeighbor(uint32 cell, FuncType&& func) const;
+
+    uint32 GetWidth() const;
+    uint32 GetHeight() const;
+    uint32 GetCellCount() const;
+    float GetCellSize() const;
+
+    /**
+     * Incremented whenever costs change, anything computed from older costs is stale.
+     */
+    uint32 GetVersion() const;
+
+private:
+    Vector2 _origin = Vector2::Zero;
+    float _cellSize = 1.0f;
+    uint32 _width = 0;
+    uint32 _height = 0;
+    uint32 _version = 0;
+
+    DArray<uint8> _costs;
+
+private:
+    uint32 GetCoordinate(float value, float origin, uint32 count) const;
+};
+
+template <typename FuncType>
+void NavigationGrid::ForEachNeighbor(uint32 cell, FuncType&& func) const
+{
+    constexpr float diagonalLength = 1.41421356f;
+
+    const int32 x = static_cast<int32>(cell % _width);
+    const int32 y = static_cast<int32>(cell / _width);
+
+    const auto isOpen = [this](int32 neighborX, int32 neighborY)
+    {
+        return neighborX >= 0 && neighborX < static_cast<int32>(_width) && neighborY >= 0 && neighborY < static_cast<int32>(_height) &&
+            !IsBlocked(GetCell(static_cast<uint32>(neighborX), static_cast<uint32>(neighborY)));
+    };
+
+    for (uint8 i = 0; i < NeighborCount; ++i)
+    {
+        const int32 offsetX = NeighborOffsetsX[i];
+        const int32 offsetY = NeighborOffsetsY[i];
+        if (!isOpen(x + offsetX, y + offsetY))
+        {
+            continue;
+        }
+
+        const bool isDiagonal = offsetX != 0 && offsetY != 0;
+        if (isDiagonal && (!isOpen(x + offsetX, y) || !isOpen(x, y + offsetY)))
+        {
+            continue;
+        }
+
+        func(GetCell(static_cast<uint32>(x + offsetX), static_cast<uint32>(y + offsetY)), isDiagonal ? diagonalLength : 1.0f, i);
+    }
+}
@@ -0,0 +1,155 @@
+﻿#include "PathService.h"
+#include "NavigationGrid.h"
+#include "Engine/Engine.h"
+#include "Math/Math.h"
+#include <chrono>
+
+void PathService::Initialize(const NavigationGrid& grid, uint32 clusterSize)
+{
+    _grid = &grid;
+    _clusterSize = clusterSize;
+
+    Rebuild();
+}
+
+void PathService::Rebuild()
+{
+    _graph.Build(*_grid, _clusterSize);
+}
+
+void PathService::Submit(uint64 entityID, const Vector3& start, const Vector3& goal)
+{
+    const auto [it, isInserted] = _requestIndices.try_emplace(entityID, static_cast<uint32>(_requests.Count()));
+    if (isInserted)
+    {
+        _requests.AddDefault();
+    }
+
+    PathRequest& request = _requests[it->second];
+    request.EntityID = entityID;
+    request.Start = start;
+    request.Goal = goal;
+}
+
+void PathService::Cancel(uint64 entityID)
+{
+    const auto it = _requestIndices.find(entityID);
+    if (it != _requestIndices.end())
+    {
+        // Cancelled requests keep their place in the queue and are skipped when processed
+        _requests[it->second].EntityID = 0;
+        _requestIndices.erase(it);
+    }
+
+    _results.erase(entityID);
+}
+
+void PathService::Process(double budgetMilliseconds)
+{
+    const uint32 requestCount = static_cast<uint32>(_requests.Count());
+    if (requestCount == 0)
+    {
+        return;
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double, std::milli>(budgetMilliseconds);
+
+    DArray<PathResult> results;
+    results.Reserve(requestCount);
+    for (uint32 i = 0; i < requestCount; ++i)
+    {
+        results.AddDefault();
+    }
+
+    // Workers take requests in order until the budget runs out, so processed requests always form a prefix of the
+    // queue. A request that was started is finished even if that goes over the budget.
+    std::atomic<uint32> nextRequest = 0;
+    ThreadPool& threadPool = Engine::Get().GetThreadPool();
+    threadPool.ParallelFor(threadPool.GetThreadCount() + 1, 1, [this, &results, &nextRequest, requestCount, deadline](uint32 begin, uint32 end)
+    {
+        while (std::chrono::steady_clock::now() < deadline)
+        {
+            const uint32 index = nextRequest.fetch_add(1);
+            if (index >= requestCount)
+            {
+                break;
+            }
+
+            if (_requests[index].EntityID != 0)
+            {
+                SolveRequest(_requests[index], results[index]);
+            }
+        }
+    });
+
+    const uint32 processedCount = Math::Min(nextRequest.load(), requestCount);
+    for (uint32 i = 0; i < processedCount; ++i)
+    {
+        const uint64 entityID = _requests[i].EntityID;
+        if (entityID != 0)
+        {
+            _results[entityID] = std::move(results[i]);
+            _requestIndices.erase(entityID);
+        }
+    }
+
+    DArray<PathRequest> remainingRequests;
+    for (uint32 i = processedCount; i < requestCount; ++i)
+    {
+        if (_requests[i].EntityID != 0)
+        {
+            _requestIndices[_requests[i].EntityID] = static_cast<uint32>(remainingRequests.Count());
+            remainingRequests.Add(_requests[i]);
+        }
+    }
+
+    _requests = std::move(remainingRequests);
+}
+
+bool PathService::TakeResult(uint64 entityID, PathResult& outResult)
+{
+    const auto it = _results.find(entityID);
+    if (it == _results.end())
+    {
+        return false;
+    }
+
+    outResult = std::move(it->second);
+    _results.erase(it);
+
+    return true;
+}
+
+uint32 PathService::GetQueuedRequestCount() const
+{
+    return static_cast<uint32>(_requestIndices.size());
+}
+
+void PathService::SolveRequest(const PathRequest& request, PathResult& outResult) const
+{
+    outResult.Goal = request.Goal;
+
+    DArray<uint32> cells;
+    outResult.IsFound = _graph.FindPath(_grid->GetCell(request.Start), _grid->GetCell(request.Goal), cells);
+    if (!outResult.IsFound)
+    {
+        return;
+    }
+
+    // Only cells where the path turns are kept, the agent walks straight between them
+    const uint32 width = _grid->GetWidth();
+    for (uint32 i = 1; i + 1 < cells.Count(); ++i)
+    {
+        const int32 previousX = static_cast<int32>(cells[i] % width) - static_cast<int32>(cells[i - 1] % width);
+        const int32 previousY = static_cast<int32>(cells[i] / width) - static_cast<int32>(cells[i - 1] / width);
+        const int32 nextX = static_cast<int32>(cells[i + 1] % width) - static_cast<int32>(cells[i] % width);
+        const int32 nextY = static_cast<int32>(cells[i + 1] / width) - static_cast<int32>(cells[i] / width);
+
+        if (previousX != nextX || previousY != nextY)
+        {
+            outResult.Waypoints.Add(_grid->GetCellCenter(cells[i], request.Start.z));
+        }
+    }
+
+    outResult.Waypoints.Add(request.Goal);
+}
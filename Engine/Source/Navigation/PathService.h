@@ -0,0 +1,68 @@
+﻿#pragma once
+
+#include "Core.h"
+#include "Containers/DArray.h"
+#include "Math/MathFwd.h"
+#include "Navigation/HierarchicalPathGraph.h"
+#include <unordered_map>
+
+class NavigationGrid;
+
+struct PathResult
+{
+    Vector3 Goal;
+    // Points where the path changes direction, the last one is the goal
+    DArray<Vector3> Waypoints;
+    bool IsFound = false;
+};
+
+/**
+ * Queue of path requests answered by hierarchical A* on worker threads.
+ * Requests are processed in submission order under a time budget, requests that weren't started before the budget ran
+ * out stay queued for the next call. Each entity has at most one queued request and one unclaimed result.
+ */
+class PathService
+{
+public:
+    void Initialize(const NavigationGrid& grid, uint32 clusterSize);
+
+    /**
+     * Rebuilds the abstract graph from current costs of the grid, paths found before are not updated.
+     */
+    void Rebuild();
+
+    /**
+     * Queues a path request, replaces a request of the same entity that is still queued.
+     */
+    void Submit(uint64 entityID, const Vector3& start, const Vector3& goal);
+    void Cancel(uint64 entityID);
+
+    void Process(double budgetMilliseconds);
+
+    /**
+     * Moves result of entity's last processed request to outResult, returns false if there is none.
+     */
+    bool TakeResult(uint64 entityID, PathResult& outResult);
+
+    uint32 GetQueuedRequestCount() const;
+
+private:
+    struct PathRequest
+    {
+        uint64 EntityID = 0;
+        Vector3 Start;
+        Vector3 Goal;
+    };
+
+    const NavigationGrid* _grid = nullptr;
+    uint32 _clusterSize = 0;
+    HierarchicalPathGraph _graph;
+
+    DArray<PathRequest> _requests;
+    // Index of the queued request of each entity
+    std::unordered_map<uint64, uint32> _requestIndices;
+    std::unordered_map<uint64, PathResult> _results;
+
+private:
+    void SolveRequest(const PathRequest& request, PathResult& outResult) const;
+};
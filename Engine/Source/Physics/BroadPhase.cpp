@@ -0,0 +1,181 @@
+﻿#include "BroadPhase.h"
+#include "Math/Math.h"
+#include <bit>
+
+GridBroadPhase::GridBroadPhase(const BoundingBox& bounds, uint32 cellCountPerAxis)
+{
+    for (SpatialHashGrid3D& grid : _grids)
+    {
+        grid.Initialize(bounds, cellCountPerAxis);
+    }
+}
+
+void GridBroadPhase::Add(uint32 item, const BoundingBox& bounds, uint32 layer)
+{
+    Reserve(item);
+
+    _itemBounds[item] = bounds;
+    _itemLayers[item] = layer;
+    _isItemValid[item] = true;
+    _dirtyLayers |= 1u << layer;
+}
+
+void GridBroadPhase::Remove(uint32 item)
+{
+    _isItemValid[item] = false;
+    _dirtyLayers |= 1u << _itemLayers[item];
+}
+
+void GridBroadPhase::Move(uint32 item, const BoundingBox& bounds)
+{
+    _itemBounds[item] = bounds;
+    _dirtyLayers |= 1u << _itemLayers[item];
+}
+
+void GridBroadPhase::Commit()
+{
+    // Only layers that changed are rebuilt, static geometry in its own layer is left alone while units move
+    for (uint32 layers = _dirtyLayers; layers != 0; layers &= layers - 1)
+    {
+        const uint32 layer = static_cast<uint32>(std::countr_zero(layers));
+
+        _grids[layer].Build(static_cast<uint32>(_itemBounds.Count()), [this, layer](uint32 item, BoundingBox& outBounds)
+        {
+            if (!_isItemValid[item] || _itemLayers[item] != layer)
+            {
+                return false;
+            }
+
+            outBounds = _itemBounds[item];
+            return true;
+        });
+    }
+
+    _usedLayers |= _dirtyLayers;
+    _dirtyLayers = 0;
+}
+
+void GridBroadPhase::ForEachItemAt(const BoundingBox& aabb, uint32 layerMask, const std::function<bool(uint32 item)>& func) const
+{
+    bool isStopped = false;
+    const auto visit = [&func, &isStopped](uint32 item)
+    {
+        isStopped = !func(item);
+        return !isStopped;
+    };
+
+    for (uint32 layers = _usedLayers & layerMask; layers != 0 && !isStopped; layers &= layers - 1)
+    {
+        _grids[std::countr_zero(layers)].ForEachItemAt(aabb, visit);
+    }
+}
+
+void GridBroadPhase::ForEachItemAlongLine(const Line& line, uint32 layerMask, const std::function<bool(uint32 item)>& func) const
+{
+    bool isStopped = false;
+    const auto visitCell = [&func, &isStopped](const SpatialHashGrid3D::CellIndex& index, std::span<const uint32> items)
+    {
+        for (const uint32 item : items)
+        {
+            if (!func(item))
+            {
+                isStopped = true;
+                return false;
+            }
+        }
+
+        return true;
+    };
+
+    for (uint32 layers = _usedLayers & layerMask; layers != 0 && !isStopped; layers &= layers - 1)
+    {
+        _grids[std::countr_zero(layers)].ForEachCellAlongLine(line, visitCell);
+    }
+}
+
+void GridBroadPhase::AddCellOccupancy(std::span<uint32> histogram) const
+{
+    if (histogram.empty())
+    {
+        return;
+    }
+
+    const uint32 lastBucket = static_cast<uint32>(histogram.size()) - 1;
+    for (uint32 layers = _usedLayers; layers != 0; layers &= layers - 1)
+    {
+        _grids[std::countr_zero(layers)].ForEachOccupiedCell([&histogram, lastBucket](const SpatialHashGrid3D::CellIndex& index, std::span<const uint32> items)
+        {
+            const uint32 bucket = static_cast<uint32>(std::bit_width(static_cast<uint32>(items.size()) - 1));
+            ++histogram[Math::Min(bucket, lastBucket)];
+        });
+    }
+}
+
+void GridBroadPhase::Reserve(uint32 item)
+{
+    while (_itemBounds.Count() <= item)
+    {
+        _itemBounds.AddDefault();
+        _itemLayers.Add(0);
+        _isItemValid.Add(false);
+    }
+}
+
+void TreeBroadPhase::Add(uint32 item, const BoundingBox& bounds, uint32 layer)
+{
+    while (_proxies.Count() <= item)
+    {
+        _proxies.Add(DynamicAABBTree::NullNode);
+        _itemLayers.Add(0);
+    }
+
+    _proxies[item] = _trees[layer].Insert(item, bounds);
+    _itemLayers[item] = layer;
+    _usedLayers |= 1u << layer;
+}
+
+void TreeBroadPhase::Remove(uint32 item)
+{
+    _trees[_itemLayers[item]].Remove(_proxies[item]);
+    _proxies[item] = DynamicAABBTree::NullNode;
+}
+
+void TreeBroadPhase::Move(uint32 item, const BoundingBox& bounds)
+{
+    _trees[_itemLayers[item]].Move(_proxies[item], bounds);
+}
+
+void TreeBroadPhase::Commit()
+{
+    // Trees are updated in place
+}
+
+void TreeBroadPhase::ForEachItemAt(const BoundingBox& aabb, uint32 layerMask, const std::function<bool(uint32 item)>& func) const
+{
+    bool isStopped = false;
+    const auto visit = [&func, &isStopped](uint32 item)
+    {
+        isStopped = !func(item);
+        return !isStopped;
+    };
+
+    for (uint32 layers = _usedLayers & layerMask; layers != 0 && !isStopped; layers &= layers - 1)
+    {
+        _trees[std::countr_zero(layers)].Query(aabb, visit);
+    }
+}
+
+void TreeBroadPhase::ForEachItemAlongLine(const Line& line, uint32 layerMask, const std::function<bool(uint32 item)>& func) const
+{
+    bool isStopped = false;
+    const auto visit = [&func, &isStopped](uint32 item)
+    {
+        isStopped = !func(item);
+        return !isStopped;
+    };
+
+    for (uint32 layers = _usedLayers & layerMask; layers != 0 && !isStopped; layers &= layers - 1)
+    {
+        _trees[std::countr_zero(layers)].Query(line, visit);
+    }
+}
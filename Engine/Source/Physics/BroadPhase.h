@@ -0,0 +1,112 @@
+﻿#pragma once
+
+#include "BoundingBox.h"
+#include "Containers/DArray.h"
+#include "Containers/Spatialization/DynamicAABBTree.h"
+#include "Containers/Spatialization/SpatialHashGrid3D.h"
+#include <functional>
+#include <span>
+
+struct Line;
+
+enum class EBroadPhaseType : uint8
+{
+    // Uniform grid rebuilt on commit, cheap for many similarly sized items
+    UniformGrid,
+    // Incrementally updated AABB tree, handles items of very different sizes
+    DynamicTree
+};
+
+/**
+ * Acceleration structure finding candidate items for overlap and ray queries.
+ * Items are identified by index and may be reported even if their exact bounds don't overlap the query.
+ * Each item belongs to one layer and items of each layer are kept in a separate structure, so queries skip layers
+ * outside of their mask without visiting any of their items.
+ * Adding, removing and moving items is not thread safe, queries are safe to run in parallel between commits.
+ */
+class BroadPhase
+{
+public:
+    static constexpr uint32 MaxLayerCount = 32;
+    static constexpr uint32 AllLayers = std::numeric_limits<uint32>::max();
+
+public:
+    virtual ~BroadPhase() = default;
+
+    virtual void Add(uint32 item, const BoundingBox& bounds, uint32 layer) = 0;
+    virtual void Remove(uint32 item) = 0;
+    virtual void Move(uint32 item, const BoundingBox& bounds) = 0;
+
+    /**
+     * Applies changes made since the last commit, queries may not see them before that.
+     */
+    virtual void Commit() = 0;
+
+    /**
+     * Calls func once for each item in layerMask whose bounds may overlap aabb.
+     */
+    virtual void ForEachItemAt(const BoundingBox& aabb, uint32 layerMask, const std::function<bool(uint32 item)>& func) const = 0;
+
+    /**
+     * Calls func for items in layerMask whose bounds may be crossed by line, an item may be reported more than once.
+     */
+    virtual void ForEachItemAlongLine(const Line& line, uint32 layerMask, const std::function<bool(uint32 item)>& func) const = 0;
+
+    /**
+     * Adds occupied cells to histogram by item count, bucket i counts cells with up to 2^i items and the last bucket
+     * counts the rest. Structures without cells leave the histogram as it is.
+     */
+    virtual void AddCellOccupancy(std::span<uint32> histogram) const
+    {
+    }
+};
+
+class GridBroadPhase final : public BroadPhase
+{
+public:
+    GridBroadPhase(const BoundingBox& bounds, uint32 cellCountPerAxis);
+
+    virtual void Add(uint32 item, const BoundingBox& bounds, uint32 layer) override;
+    virtual void Remove(uint32 item) override;
+    virtual void Move(uint32 item, const BoundingBox& bounds) override;
+    virtual void Commit() override;
+
+    virtual void ForEachItemAt(const BoundingBox& aabb, uint32 layerMask, const std::function<bool(uint32 item)>& func) const override;
+    virtual void ForEachItemAlongLine(const Line& line, uint32 layerMask, const std::function<bool(uint32 item)>& func) const override;
+
+    virtual void AddCellOccupancy(std::span<uint32> histogram) const override;
+
+private:
+    SpatialHashGrid3D _grids[MaxLayerCount];
+
+    DArray<BoundingBox> _itemBounds;
+    DArray<uint32> _itemLayers;
+    DArray<bool> _isItemValid;
+
+    // Layers that have at least one item, and layers that have to be rebuilt on commit
+    uint32 _usedLayers = 0;
+    uint32 _dirtyLayers = 0;
+
+private:
+    void Reserve(uint32 item);
+};
+
+class TreeBroadPhase final : public BroadPhase
+{
+public:
+    virtual void Add(uint32 item, const BoundingBox& bounds, uint32 layer) override;
+    virtual void Remove(uint32 item) override;
+    virtual void Move(uint32 item, const BoundingBox& bounds) override;
+    virtual void Commit() override;
+
+    virtual void ForEachItemAt(const BoundingBox& aabb, uint32 layerMask, const std::function<bool(uint32 item)>& func) const override;
+    virtual void ForEachItemAlongLine(const Line& line, uint32 layerMask, const std::function<bool(uint32 item)>& func) const override;
+
+private:
+    DynamicAABBTree _trees[MaxLayerCount];
+    uint32 _usedLayers = 0;
+
+    // Tree proxy of each item, DynamicAABBTree::NullNode if item is not in any tree
+    DArray<uint32> _proxies;
+    DArray<uint32> _itemLayers;
+};
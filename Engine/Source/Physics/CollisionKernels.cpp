@@ -0,0 +1,352 @@
+﻿#include "CollisionKernels.h"
+#include "BoundingBox.h"
+#include "Math/Float4.h"
+#include "Math/Math.h"
+
+OrientedBox::OrientedBox(const BoundingBox& localBox, const Matrix& worldMatrix)
+{
+    Center = Vector3::Transform(localBox.GetCenter(), worldMatrix);
+
+    const Vector3 rows[3] = {
+        Vector3(worldMatrix._11, worldMatrix._12, worldMatrix._13),
+        Vector3(worldMatrix._21, worldMatrix._22, worldMatrix._23),
+        Vector3(worldMatrix._31, worldMatrix._32, worldMatrix._33)
+    };
+    const Vector3 unitAxes[3] = {Vector3::UnitX, Vector3::UnitY, Vector3::UnitZ};
+
+    const Vector3 localExtent = localBox.GetExtent();
+    const float localExtents[3] = {localExtent.x, localExtent.y, localExtent.z};
+    float halfExtents[3];
+
+    for (uint32 i = 0; i < 3; ++i)
+    {
+        const float scale = rows[i].Length();
+
+        Axes[i] = scale > 0.0f ? rows[i] / scale : unitAxes[i];
+        halfExtents[i] = localExtents[i] * scale;
+    }
+
+    HalfExtents = Vector3(halfExtents[0], halfExtents[1], halfExtents[2]);
+}
+
+OrientedBox::OrientedBox(const BoundingBox& worldBox) :
+    Center(worldBox.GetCenter()),
+    Axes{Vector3::UnitX, Vector3::UnitY, Vector3::UnitZ},
+    HalfExtents(worldBox.GetExtent())
+{
+}
+
+Vector3 OrientedBox::FurthestPointInDirection(const Vector3& direction) const
+{
+    const float halfExtents[3] = {HalfExtents.x, HalfExtents.y, HalfExtents.z};
+
+    Vector3 point = Center;
+    for (uint32 i = 0; i < 3; ++i)
+    {
+        point += Axes[i] * (direction.Dot(Axes[i]) > 0.0f ? halfExtents[i] : -halfExtents[i]);
+    }
+
+    return point;
+}
+
+float OrientedBox::GetProjectedRadius(const Vector3& axis) const
+{
+    return HalfExtents.x * std::abs(axis.Dot(Axes[0])) + HalfExtents.y * std::abs(axis.Dot(Axes[1])) + HalfExtents.z * std::abs(axis.Dot(Axes[2]));
+}
+
+namespace CollisionKernels
+{
+    // Boxes with one box per lane
+    struct BoxLanes
+    {
+    public:
+        Float4 Center[3];
+        // Axes[axis][component]
+        Float4 Axes[3][3];
+        Float4 HalfExtents[3];
+    };
+
+    // Lanes past the end of the batch repeat its last box, their results are discarded
+    BoxLanes LoadBoxes(const OrientedBox* boxes, uint32 first, uint32 count)
+    {
+        float values[Float4::LaneCount][15];
+        for (uint32 lane = 0; lane < Float4::LaneCount; ++lane)
+        {
+            const OrientedBox& box = boxes[Math::Min(first + lane, count - 1)];
+            const Vector3* vectors[5] = {&box.Center, &box.Axes[0], &box.Axes[1], &box.Axes[2], &box.HalfExtents};
+
+            for (uint32 i = 0; i < 5; ++i)
+            {
+                values[lane][3 * i] = vectors[i]->x;
+                values[lane][3 * i + 1] = vectors[i]->y;
+                values[lane][3 * i + 2] = vectors[i]->z;
+            }
+        }
+
+        const auto column = [&values](uint32 index)
+        {
+            return Float4(values[0][index], values[1][index], values[2][index], values[3][index]);
+        };
+
+        BoxLanes lanes;
+        for (uint32 i = 0; i < 3; ++i)
+        {
+            lanes.Center[i] = column(i);
+            lanes.Axes[0][i] = column(3 + i);
+            lanes.Axes[1][i] = column(6 + i);
+            lanes.Axes[2][i] = column(9 + i);
+            lanes.HalfExtents[i] = column(12 + i);
+        }
+
+        return lanes;
+    }
+
+    Float4 Dot(const Float4 (&a)[3], const Float4 (&b)[3])
+    {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    }
+
+    void BoxBox(const OrientedBox* boxesA, const OrientedBox* boxesB, uint32 count, BoxContact* outContacts)
+    {
+        const Float4 zero(0.0f);
+        const Float4 one(1.0f);
+        const Float4 epsilon(1e-6f);
+        const Float4 maxValue(std::numeric_limits<float>::max());
+
+        // Edge axes are only picked if they are noticeably better than face axes, face contacts are more stable
+        const Float4 edgeBias(1.05f);
+
+        for (uint32 first = 0; first < count; first += Float4::LaneCount)
+        {
+            const BoxLanes a = LoadBoxes(boxesA, first, count);
+            const BoxLanes b = LoadBoxes(boxesB, first, count);
+
+            // Axes of B in the frame of A
+            Float4 r[3][3];
+            Float4 absR[3][3];
+            for (uint32 i = 0; i < 3; ++i)
+            {
+                for (uint32 j = 0; j < 3; ++j)
+                {
+                    r[i][j] = Dot(a.Axes[i], b.Axes[j]);
+                    absR[i][j] = Float4::Abs(r[i][j]) + epsilon;
+                }
+            }
+
+            const Float4 d[3] = {b.Center[0] - a.Center[0], b.Center[1] - a.Center[1], b.Center[2] - a.Center[2]};
+            const Float4 t[3] = {Dot(d, a.Axes[0]), Dot(d, a.Axes[1]), Dot(d, a.Axes[2])};
+
+            Float4 isSeparated = zero;
+            Float4 bestScore = maxValue;
+            Float4 bestDepth = zero;
+            Float4 bestAxis = zero;
+            Float4 bestProjection = zero;
+
+            // projection is the offset between box centers along the axis, axisLength scales overlap to world units
+            const auto testAxis = [&](const Float4& radiusA, const Float4& radiusB, const Float4& projection, const Float4& axisLength, const Float4& isDegenerate, float axisIndex, const Float4& bias)
+            {
+                const Float4 overlap = Float4::Select(isDegenerate, maxValue, (radiusA + radiusB - Float4::Abs(projection)) / axisLength);
+                isSeparated = isSeparated | (overlap < zero);
+
+                const Float4 score = overlap * bias;
+                const Float4 isBetter = score < bestScore;
+
+                bestScore = Float4::Select(isBetter, score, bestScore);
+                bestDepth = Float4::Select(isBetter, overlap, bestDepth);
+                bestAxis = Float4::Select(isBetter, Float4(axisIndex), bestAxis);
+                bestProjection = Float4::Select(isBetter, projection, bestProjection);
+            };
+
+            const Float4 isNotDegenerate = zero;
+
+            // Face axes of A
+            for (uint32 i = 0; i < 3; ++i)
+            {
+                const Float4 radiusB = b.HalfExtents[0] * absR[i][0] + b.HalfExtents[1] * absR[i][1] + b.HalfExtents[2] * absR[i][2];
+                testAxis(a.HalfExtents[i], radiusB, t[i], one, isNotDegenerate, static_cast<float>(i), one);
+            }
+
+            // Face axes of B
+            for (uint32 j = 0; j < 3; ++j)
+            {
+                const Float4 radiusA = a.HalfExtents[0] * absR[0][j] + a.HalfExtents[1] * absR[1][j] + a.HalfExtents[2] * absR[2][j];
+                const Float4 projection = t[0] * r[0][j] + t[1] * r[1][j] + t[2] * r[2][j];
+                testAxis(radiusA, b.HalfExtents[j], projection, one, isNotDegenerate, static_cast<float>(3 + j), one);
+            }
+
+            // Cross products of edges, skipped for parallel edges
+            for (uint32 i = 0; i < 3; ++i)
+            {
+                const uint32 i1 = (i + 1) % 3;
+                const uint32 i2 = (i + 2) % 3;
+
+                for (uint32 j = 0; j < 3; ++j)
+                {
+                    const uint32 j1 = (j + 1) % 3;
+                    const uint32 j2 = (j + 2) % 3;
+
+                    const Float4 radiusA = a.HalfExtents[i1] * absR[i2][j] + a.HalfExtents[i2] * absR[i1][j];
+                    const Float4 radiusB = b.HalfExtents[j1] * absR[i][j2] + b.HalfExtents[j2] * absR[i][j1];
+                    const Float4 projection = t[i2] * r[i1][j] - t[i1] * r[i2][j];
+
+                    const Float4 axisLengthSquared = Float4::Max(one - r[i][j] * r[i][j], zero);
+                    const Float4 isDegenerate = axisLengthSquared < epsilon;
+
+                    testAxis(radiusA, radiusB, projection, Float4::Sqrt(axisLengthSquared), isDegenerate, static_cast<float>(6 + 3 * i + j), edgeBias);
+                }
+            }
+
+            const int32 separatedMask = Float4::MoveMask(isSeparated);
+            const uint32 laneCount = Math::Min(Float4::LaneCount, count - first);
+
+            for (uint32 lane = 0; lane < laneCount; ++lane)
+            {
+                BoxContact& contact = outContacts[first + lane];
+                if (separatedMask & 1 << lane)
+                {
+                    contact = {};
+                    continue;
+                }
+
+                const OrientedBox& boxA = boxesA[first + lane];
+                const OrientedBox& boxB = boxesB[first + lane];
+
+                const uint32 axis = static_cast<uint32>(bestAxis[lane]);
+
+                Vector3 normal;
+                if (axis < 3)
+                {
+                    normal = boxA.Axes[axis];
+                }
+                else if (axis < 6)
+                {
+                    normal = boxB.Axes[axis - 3];
+                }
+                else
+                {
+                    normal = boxA.Axes[(axis - 6) / 3].Cross(boxB.Axes[(axis - 6) % 3]);
+                    normal.Normalize();
+                }
+
+                // Projection is measured from A towards B, A is pushed the other way
+                if (bestProjection[lane] > 0.0f)
+                {
+                    normal = -normal;
+                }
+
+                contact.IsValid = true;
+                contact.PenetrationDepth = bestDepth[lane];
+                contact.Normal = normal;
+                contact.Location = boxA.FurthestPointInDirection(-normal) + normal * contact.PenetrationDepth;
+            }
+        }
+    }
+
+    void SphereBox(const Vector3& center, float radius, const OrientedBox* boxes, uint32 count, bool* outOverlaps)
+    {
+        const Float4 sphereCenter[3] = {Float4(center.x), Float4(center.y), Float4(center.z)};
+        const Float4 radiusSquared(radius * radius);
+
+        for (uint32 first = 0; first < count; first += Float4::LaneCount)
+        {
+            const BoxLanes box = LoadBoxes(boxes, first, count);
+            const Float4 d[3] = {sphereCenter[0] - box.Center[0], sphereCenter[1] - box.Center[1], sphereCenter[2] - box.Center[2]};
+
+            // Distance from sphere center to the closest point of the box, computed in the frame of the box
+            Float4 distanceSquared(0.0f);
+            for (uint32 i = 0; i < 3; ++i)
+            {
+                const Float4 local = Dot(d, box.Axes[i]);
+                const Float4 outside = local - Float4::Clamp(local, -box.HalfExtents[i], box.HalfExtents[i]);
+
+                distanceSquared += outside * outside;
+            }
+
+            const int32 overlapMask = Float4::MoveMask(distanceSquared <= radiusSquared);
+            const uint32 laneCount = Math::Min(Float4::LaneCount, count - first);
+
+            for (uint32 lane = 0; lane < laneCount; ++lane)
+            {
+                outOverlaps[first + lane] = (overlapMask & 1 << lane) != 0;
+            }
+        }
+    }
+
+    void RayBox(const Line& line, const OrientedBox* boxes, uint32 count, RayContact* outContacts)
+    {
+        const Vector3 delta = line.End - line.Start;
+        const Float4 start[3] = {Float4(line.Start.x), Float4(line.Start.y), Float4(line.Start.z)};
+        const Float4 direction[3] = {Float4(delta.x), Float4(delta.y), Float4(delta.z)};
+
+        const Float4 zero(0.0f);
+        const Float4 one(1.0f);
+        const Float4 epsilon(1e-8f);
+        const Float4 maxValue(std::numeric_limits<float>::max());
+
+        for (uint32 first = 0; first < count; first += Float4::LaneCount)
+        {
+            const BoxLanes box = LoadBoxes(boxes, first, count);
+            const Float4 d[3] = {start[0] - box.Center[0], start[1] - box.Center[1], start[2] - box.Center[2]};
+
+            Float4 nearFraction = -maxValue;
+            Float4 farFraction = maxValue;
+            Float4 nearAxis = zero;
+            Float4 nearDirection = zero;
+
+            for (uint32 i = 0; i < 3; ++i)
+            {
+                const Float4 origin = Dot(d, box.Axes[i]);
+                const Float4 localDirection = Dot(direction, box.Axes[i]);
+
+                const Float4 inverseDirection = one / localDirection;
+                const Float4 t1 = (-box.HalfExtents[i] - origin) * inverseDirection;
+                const Float4 t2 = (box.HalfExtents[i] - origin) * inverseDirection;
+
+                // Line parallel to the slab is either inside it for its whole length or misses the box
+                const Float4 isParallel = Float4::Abs(localDirection) < epsilon;
+                const Float4 isOutside = Float4::Abs(origin) > box.HalfExtents[i];
+
+                const Float4 slabNear = Float4::Select(isParallel, Float4::Select(isOutside, maxValue, -maxValue), Float4::Min(t1, t2));
+                const Float4 slabFar = Float4::Select(isParallel, Float4::Select(isOutside, -maxValue, maxValue), Float4::Max(t1, t2));
+
+                const Float4 isNearer = slabNear > nearFraction;
+                nearFraction = Float4::Select(isNearer, slabNear, nearFraction);
+                nearAxis = Float4::Select(isNearer, Float4(static_cast<float>(i)), nearAxis);
+                nearDirection = Float4::Select(isNearer, localDirection, nearDirection);
+
+                farFraction = Float4::Min(farFraction, slabFar);
+            }
+
+            const Float4 isHit = (nearFraction <= farFraction) & (farFraction >= zero) & (nearFraction <= one);
+            const int32 hitMask = Float4::MoveMask(isHit);
+            const uint32 laneCount = Math::Min(Float4::LaneCount, count - first);
+
+            for (uint32 lane = 0; lane < laneCount; ++lane)
+            {
+                RayContact& contact = outContacts[first + lane];
+                if ((hitMask & 1 << lane) == 0)
+                {
+                    contact = {};
+                    continue;
+                }
+
+                contact.IsValid = true;
+
+                const float fraction = nearFraction[lane];
+                if (fraction < 0.0f)
+                {
+                    // Line starts inside the box
+                    contact.Fraction = 0.0f;
+                    contact.Normal = -delta;
+                    contact.Normal.Normalize();
+                    continue;
+                }
+
+                const Vector3& axis = boxes[first + lane].Axes[static_cast<uint32>(nearAxis[lane])];
+
+                contact.Fraction = fraction;
+                contact.Normal = nearDirection[lane] > 0.0f ? -axis : axis;
+            }
+        }
+    }
+}
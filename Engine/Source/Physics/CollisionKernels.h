@@ -0,0 +1,70 @@
+﻿#pragma once
+
+#include "Core.h"
+#include "Math/MathFwd.h"
+
+class BoundingBox;
+struct Line;
+
+/**
+ * Box shape of a body in world space.
+ */
+struct OrientedBox
+{
+public:
+    Vector3 Center;
+    // Unit axes of the box, rows of the world matrix without scale
+    Vector3 Axes[3];
+    Vector3 HalfExtents;
+
+public:
+    OrientedBox() = default;
+    OrientedBox(const BoundingBox& localBox, const Matrix& worldMatrix);
+    explicit OrientedBox(const BoundingBox& worldBox);
+
+    Vector3 FurthestPointInDirection(const Vector3& direction) const;
+
+    /**
+     * Half size of the box projected on axis.
+     */
+    float GetProjectedRadius(const Vector3& axis) const;
+};
+
+struct BoxContact
+{
+public:
+    bool IsValid = false;
+    float PenetrationDepth = 0.0f;
+    // Direction in which box A has to move to resolve the penetration
+    Vector3 Normal;
+    // Point on the surface of box B
+    Vector3 Location;
+};
+
+struct RayContact
+{
+public:
+    bool IsValid = false;
+    // Fraction of the line where it enters the box, 0 if the line starts inside
+    float Fraction = 0.0f;
+    Vector3 Normal;
+};
+
+/**
+ * Closed form collision tests for box shapes, used instead of GJK/EPA where both shapes are boxes.
+ * Batches are processed four items at a time, one item per SIMD lane.
+ */
+namespace CollisionKernels
+{
+    /**
+     * Separating axis test between boxesA[i] and boxesB[i].
+     */
+    void BoxBox(const OrientedBox* boxesA, const OrientedBox* boxesB, uint32 count, BoxContact* outContacts);
+
+    void SphereBox(const Vector3& center, float radius, const OrientedBox* boxes, uint32 count, bool* outOverlaps);
+
+    /**
+     * Slab test of line against each box.
+     */
+    void RayBox(const Line& line, const OrientedBox* boxes, uint32 count, RayContact* outContacts);
+}
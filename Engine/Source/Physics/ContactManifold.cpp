@@ -0,0 +1,132 @@
+﻿#include "ContactManifold.h"
+#include "ECS/Entity.h"
+#include "ECS/Components/CRigidBody.h"
+#include "Math/Math.h"
+
+void ContactManifold::Reset(Body& bodyA, Body& bodyB)
+{
+    BodyA = &bodyA;
+    BodyB = &bodyB;
+    EntityIDA = bodyA.Entity->GetID();
+    EntityIDB = bodyB.Entity->GetID();
+    PointCount = 0;
+}
+
+bool ContactManifold::BelongsTo(const Body& bodyA, const Body& bodyB) const
+{
+    return BodyA == &bodyA && BodyB == &bodyB && EntityIDA == bodyA.Entity->GetID() && EntityIDB == bodyB.Entity->GetID();
+}
+
+void ContactManifold::Update(const Vector3& location, const Vector3& normal, float penetrationDepth, float breakingDistance)
+{
+    // Points found along a different normal describe a different contact
+    constexpr float minNormalAlignment = 0.95f;
+    if (PointCount > 0 && Normal.Dot(normal) < minNormalAlignment)
+    {
+        PointCount = 0;
+    }
+
+    Normal = normal;
+
+    Refresh(breakingDistance);
+    AddPoint(location, penetrationDepth, breakingDistance);
+}
+
+void ContactManifold::Refresh(float breakingDistance)
+{
+    for (uint32 i = PointCount; i-- > 0;)
+    {
+        ContactPoint& point = Points[i];
+        point.PointA = Vector3::Transform(point.LocalPointA, BodyA->WorldMatrix);
+        point.PointB = Vector3::Transform(point.LocalPointB, BodyB->WorldMatrix);
+
+        const Vector3 delta = point.PointB - point.PointA;
+        point.PenetrationDepth = delta.Dot(Normal);
+
+        const Vector3 drift = delta - Normal * point.PenetrationDepth;
+        if (point.PenetrationDepth < -breakingDistance || drift.LengthSquared() > Math::Square(breakingDistance))
+        {
+            RemovePoint(i);
+        }
+    }
+}
+
+void ContactManifold::AddPoint(const Vector3& location, float penetrationDepth, float mergeDistance)
+{
+    ContactPoint newPoint;
+    newPoint.PointA = location - Normal * penetrationDepth;
+    newPoint.PointB = location;
+    newPoint.LocalPointA = Vector3::Transform(newPoint.PointA, BodyA->InverseWorldMatrix);
+    newPoint.LocalPointB = Vector3::Transform(newPoint.PointB, BodyB->InverseWorldMatrix);
+    newPoint.PenetrationDepth = penetrationDepth;
+
+    // Point close to an existing one replaces it and inherits its impulses
+    for (uint32 i = 0; i < PointCount; ++i)
+    {
+        ContactPoint& point = Points[i];
+        if ((point.PointA - newPoint.PointA).LengthSquared() < Math::Square(mergeDistance))
+        {
+            newPoint.NormalImpulse = point.NormalImpulse;
+            newPoint.TangentImpulses[0] = point.TangentImpulses[0];
+            newPoint.TangentImpulses[1] = point.TangentImpulses[1];
+
+            point = newPoint;
+            return;
+        }
+    }
+
+    if (PointCount < MaxPointCount)
+    {
+        Points[PointCount++] = newPoint;
+        return;
+    }
+
+    // Manifold is full, the new point replaces the point whose removal leaves the largest contact area, the deepest
+    // point is always kept
+    uint32 deepest = MaxPointCount;
+    float maxDepth = penetrationDepth;
+    for (uint32 i = 0; i < MaxPointCount; ++i)
+    {
+        if (Points[i].PenetrationDepth > maxDepth)
+        {
+            maxDepth = Points[i].PenetrationDepth;
+            deepest = i;
+        }
+    }
+
+    uint32 replaced = 0;
+    float maxArea = -1.0f;
+    for (uint32 i = 0; i < MaxPointCount; ++i)
+    {
+        if (i == deepest)
+        {
+            continue;
+        }
+
+        Vector3 corners[MaxPointCount];
+        for (uint32 j = 0; j < MaxPointCount; ++j)
+        {
+            corners[j] = j == i ? newPoint.PointA : Points[j].PointA;
+        }
+
+        // Corners are in no particular order, the largest product of diagonals over all three orderings is the area
+        const float area = Math::Max(
+            (corners[0] - corners[1]).Cross(corners[2] - corners[3]).LengthSquared(),
+            Math::Max(
+                (corners[0] - corners[2]).Cross(corners[1] - corners[3]).LengthSquared(),
+                (corners[0] - corners[3]).Cross(corners[1] - corners[2]).LengthSquared()));
+
+        if (area > maxArea)
+        {
+            maxArea = area;
+            replaced = i;
+        }
+    }
+
+    Points[replaced] = newPoint;
+}
+
+void ContactManifold::RemovePoint(uint32 index)
+{
+    Points[index] = Points[--PointCount];
+}
@@ -0,0 +1,78 @@
+﻿#pragma once
+
+#include "Core.h"
+#include "Math/MathFwd.h"
+
+struct Body;
+
+struct ContactPoint
+{
+public:
+    // Points in local space of each body, so the point follows the bodies in later steps
+    Vector3 LocalPointA;
+    Vector3 LocalPointB;
+    // Deepest point of body A and the matching point on the surface of body B, in world space
+    Vector3 PointA;
+    Vector3 PointB;
+    float PenetrationDepth = 0.0f;
+
+    // Impulses accumulated by the solver, kept between steps to warm start it
+    float NormalImpulse = 0.0f;
+    float TangentImpulses[2] = {0.0f, 0.0f};
+
+    // Solver data of current step
+    Vector3 OffsetA;
+    Vector3 OffsetB;
+    float NormalMass = 0.0f;
+    float TangentMasses[2] = {0.0f, 0.0f};
+    float VelocityBias = 0.0f;
+};
+
+/**
+ * Up to four contact points between a pair of bodies, kept for as long as the bodies stay in contact.
+ * Narrow phase finds a single point per step, the manifold accumulates points over steps, so resting bodies get
+ * a stable contact area instead of one point jumping between corners.
+ */
+struct ContactManifold
+{
+public:
+    static constexpr uint32 MaxPointCount = 4;
+
+public:
+    Body* BodyA = nullptr;
+    Body* BodyB = nullptr;
+    // Body indices are reused, entity IDs tell whether the manifold still belongs to the same bodies
+    uint64 EntityIDA = 0;
+    uint64 EntityIDB = 0;
+
+    // Direction in which body A has to move to resolve the penetration
+    Vector3 Normal;
+    Vector3 Tangents[2];
+
+    ContactPoint Points[MaxPointCount];
+    uint32 PointCount = 0;
+
+    // Solver data of current step
+    float InverseMassA = 0.0f;
+    float InverseMassB = 0.0f;
+    float InverseInertiaA = 0.0f;
+    float InverseInertiaB = 0.0f;
+
+    // Step in which narrow phase last reported the pair
+    uint64 LastStep = 0;
+
+public:
+    void Reset(Body& bodyA, Body& bodyB);
+    bool BelongsTo(const Body& bodyA, const Body& bodyB) const;
+
+    /**
+     * Moves existing points with their bodies, drops points that separated or slid apart by more than
+     * breakingDistance and adds the point found by narrow phase in current step.
+     */
+    void Update(const Vector3& location, const Vector3& normal, float penetrationDepth, float breakingDistance);
+
+private:
+    void Refresh(float breakingDistance);
+    void AddPoint(const Vector3& location, float penetrationDepth, float mergeDistance);
+    void RemovePoint(uint32 index);
+};
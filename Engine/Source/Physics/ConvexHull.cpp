@@ -0,0 +1,409 @@
+﻿#include "ConvexHull.h"
+#include "MemoryReader.h"
+#include "MemoryWriter.h"
+#include "Math/Math.h"
+#include <algorithm>
+#include <numbers>
+
+ConvexHull ConvexHull::Build(const DArray<Vector3>& points, uint32 directionCount)
+{
+    ConvexHull hull;
+    if (points.IsEmpty() || directionCount == 0)
+    {
+        return hull;
+    }
+
+    // Extreme points in directions evenly spread over the sphere, duplicates removed
+    const float goldenAngle = std::numbers::pi_v<float> * (3.0f - std::sqrt(5.0f));
+
+    DArray<uint32> extremeIndices;
+    extremeIndices.Reserve(directionCount);
+    for (uint32 i = 0; i < directionCount; ++i)
+    {
+        const float y = 1.0f - 2.0f * (static_cast<float>(i) + 0.5f) / static_cast<float>(directionCount);
+        const float radius = std::sqrt(Math::Max(0.0f, 1.0f - y * y));
+        const float angle = goldenAngle * static_cast<float>(i);
+        const Vector3 direction = Vector3(std::cos(angle) * radius, y, std::sin(angle) * radius);
+
+        uint32 extremeIndex = 0;
+        float maxDistance = -std::numeric_limits<float>::max();
+        for (uint32 j = 0; j < points.Count(); ++j)
+        {
+            const float distance = points[j].Dot(direction);
+            if (distance > maxDistance)
+            {
+                maxDistance = distance;
+                extremeIndex = j;
+            }
+        }
+
+        extremeIndices.Add(extremeIndex);
+    }
+
+    uint32* indices = extremeIndices.GetData();
+    std::sort(indices, indices + extremeIndices.Count());
+    const uint32 uniqueCount = static_cast<uint32>(std::unique(indices, indices + extremeIndices.Count()) - indices);
+
+    DArray<Vector3> candidates;
+    candidates.Reserve(uniqueCount);
+
+    Vector3 candidatesMin = points[indices[0]];
+    Vector3 candidatesMax = points[indices[0]];
+    for (uint32 i = 0; i < uniqueCount; ++i)
+    {
+        const Vector3& point = points[indices[i]];
+        candidates.Add(point);
+
+        candidatesMin = Vector3::Min(candidatesMin, point);
+        candidatesMax = Vector3::Max(candidatesMax, point);
+    }
+
+    const Vector3 size = candidatesMax - candidatesMin;
+    const float epsilon = Math::Max(1e-6f, 1e-5f * Math::Max(size.x, Math::Max(size.y, size.z)));
+
+    DArray<Face> faces;
+    if (!BuildFaces(candidates, epsilon, faces))
+    {
+        for (const Vector3& point : candidates)
+        {
+            hull._x.Add(point.x);
+            hull._y.Add(point.y);
+            hull._z.Add(point.z);
+        }
+
+        return hull;
+    }
+
+    // Keep only vertices referenced by hull faces
+    DArray<uint32> remap;
+    remap.Reserve(candidates.Count());
+    for (uint32 i = 0; i < candidates.Count(); ++i)
+    {
+        remap.Add(std::numeric_limits<uint32>::max());
+    }
+
+    DArray<Edge> edges;
+    for (const Face& face : faces)
+    {
+        if (!face.IsAlive)
+        {
+            continue;
+        }
+
+        for (const uint32 vertex : face.Vertices)
+        {
+            if (remap[vertex] != std::numeric_limits<uint32>::max())
+            {
+                continue;
+            }
+
+            remap[vertex] = hull.GetVertexCount();
+            hull._x.Add(candidates[vertex].x);
+            hull._y.Add(candidates[vertex].y);
+            hull._z.Add(candidates[vertex].z);
+        }
+
+        for (uint32 i = 0; i < 3; ++i)
+        {
+            const uint32 a = remap[face.Vertices[i]];
+            const uint32 b = remap[face.Vertices[(i + 1) % 3]];
+            edges.Add({Math::Min(a, b), Math::Max(a, b)});
+        }
+    }
+
+    Edge* edgeData = edges.GetData();
+    std::sort(edgeData, edgeData + edges.Count());
+    const uint32 edgeCount = static_cast<uint32>(std::unique(edgeData, edgeData + edges.Count()) - edgeData);
+
+    // Both directions of each edge, grouped by vertex
+    const uint32 vertexCount = hull.GetVertexCount();
+    hull._adjacencyOffsets.Reserve(vertexCount + 1);
+    for (uint32 i = 0; i <= vertexCount; ++i)
+    {
+        hull._adjacencyOffsets.Add(0);
+    }
+
+    for (uint32 i = 0; i < edgeCount; ++i)
+    {
+        ++hull._adjacencyOffsets[edgeData[i].From + 1];
+        ++hull._adjacencyOffsets[edgeData[i].To + 1];
+    }
+
+    for (uint32 i = 0; i < vertexCount; ++i)
+    {
+        hull._adjacencyOffsets[i + 1] += hull._adjacencyOffsets[i];
+    }
+
+    DArray<uint32> cursors;
+    cursors.Reserve(vertexCount);
+    for (uint32 i = 0; i < vertexCount; ++i)
+    {
+        cursors.Add(hull._adjacencyOffsets[i]);
+    }
+
+    hull._adjacency.Reserve(2 * edgeCount);
+    for (uint32 i = 0; i < 2 * edgeCount; ++i)
+    {
+        hull._adjacency.Add(0);
+    }
+
+    for (uint32 i = 0; i < edgeCount; ++i)
+    {
+        const Edge& edge = edgeData[i];
+        hull._adjacency[cursors[edge.From]++] = edge.To;
+        hull._adjacency[cursors[edge.To]++] = edge.From;
+    }
+
+    return hull;
+}
+
+Vector3 ConvexHull::Support(const Vector3& direction, uint32& inOutVertex) const
+{
+    const uint32 vertexCount = GetVertexCount();
+    if (vertexCount == 0)
+    {
+        return Vector3::Zero;
+    }
+
+    uint32 current = inOutVertex < vertexCount ? inOutVertex : 0;
+    float currentDistance = Distance(current, direction);
+
+    if (!HasAdjacency())
+    {
+        for (uint32 i = 0; i < vertexCount; ++i)
+        {
+            const float distance = Distance(i, direction);
+            if (distance > currentDistance)
+            {
+                currentDistance = distance;
+                current = i;
+            }
+        }
+
+        inOutVertex = current;
+        return GetVertex(current);
+    }
+
+    // On a convex hull any vertex without a better neighbor is the global maximum
+    while (true)
+    {
+        uint32 best = current;
+        float bestDistance = currentDistance;
+
+        for (uint32 i = _adjacencyOffsets[current]; i < _adjacencyOffsets[current + 1]; ++i)
+        {
+            const uint32 neighbor = _adjacency[i];
+            const float distance = Distance(neighbor, direction);
+            if (distance > bestDistance)
+            {
+                bestDistance = distance;
+                best = neighbor;
+            }
+        }
+
+        if (best == current)
+        {
+            break;
+        }
+
+        current = best;
+        currentDistance = bestDistance;
+    }
+
+    inOutVertex = current;
+    return GetVertex(current);
+}
+
+Vector3 ConvexHull::GetVertex(uint32 index) const
+{
+    return Vector3(_x[index], _y[index], _z[index]);
+}
+
+uint32 ConvexHull::GetVertexCount() const
+{
+    return static_cast<uint32>(_x.Count());
+}
+
+bool ConvexHull::IsEmpty() const
+{
+    return _x.IsEmpty();
+}
+
+bool ConvexHull::HasAdjacency() const
+{
+    return !_adjacency.IsEmpty();
+}
+
+float ConvexHull::Distance(uint32 index, const Vector3& direction) const
+{
+    return _x[index] * direction.x + _y[index] * direction.y + _z[index] * direction.z;
+}
+
+bool ConvexHull::BuildFaces(const DArray<Vector3>& points, float epsilon, DArray<Face>& outFaces)
+{
+    const uint32 pointCount = static_cast<uint32>(points.Count());
+    if (pointCount < 4)
+    {
+        return false;
+    }
+
+    // Initial tetrahedron from the most spread out points
+    uint32 i0 = 0;
+    for (uint32 i = 1; i < pointCount; ++i)
+    {
+        if (points[i].x < points[i0].x)
+        {
+            i0 = i;
+        }
+    }
+
+    uint32 i1 = i0;
+    float maxDistance = 0.0f;
+    for (uint32 i = 0; i < pointCount; ++i)
+    {
+        const float distance = (points[i] - points[i0]).LengthSquared();
+        if (distance > maxDistance)
+        {
+            maxDistance = distance;
+            i1 = i;
+        }
+    }
+
+    if (maxDistance <= epsilon * epsilon)
+    {
+        return false;
+    }
+
+    Vector3 lineDirection = points[i1] - points[i0];
+    lineDirection.Normalize();
+
+    uint32 i2 = i0;
+    maxDistance = 0.0f;
+    for (uint32 i = 0; i < pointCount; ++i)
+    {
+        const float distance = (points[i] - points[i0]).Cross(lineDirection).LengthSquared();
+        if (distance > maxDistance)
+        {
+            maxDistance = distance;
+            i2 = i;
+        }
+    }
+
+    if (maxDistance <= epsilon * epsilon)
+    {
+        return false;
+    }
+
+    Vector3 planeNormal = (points[i1] - points[i0]).Cross(points[i2] - points[i0]);
+    planeNormal.Normalize();
+
+    uint32 i3 = i0;
+    maxDistance = 0.0f;
+    for (uint32 i = 0; i < pointCount; ++i)
+    {
+        const float distance = std::abs((points[i] - points[i0]).Dot(planeNormal));
+        if (distance > maxDistance)
+        {
+            maxDistance = distance;
+            i3 = i;
+        }
+    }
+
+    if (maxDistance <= epsilon)
+    {
+        return false;
+    }
+
+    const Vector3 interiorPoint = (points[i0] + points[i1] + points[i2] + points[i3]) * 0.25f;
+
+    outFaces.Add(MakeFace(points, i0, i1, i2, interiorPoint));
+    outFaces.Add(MakeFace(points, i0, i1, i3, interiorPoint));
+    outFaces.Add(MakeFace(points, i0, i2, i3, interiorPoint));
+    outFaces.Add(MakeFace(points, i1, i2, i3, interiorPoint));
+
+    // Add remaining points one by one, replacing faces they can see with a fan connecting them to the horizon
+    DArray<Edge> visibleEdges;
+    for (uint32 i = 0; i < pointCount; ++i)
+    {
+        if (i == i0 || i == i1 || i == i2 || i == i3)
+        {
+            continue;
+        }
+
+        const Vector3& point = points[i];
+
+        visibleEdges.Clear();
+        for (Face& face : outFaces)
+        {
+            if (!face.IsAlive || face.Normal.Dot(point) - face.Offset <= epsilon)
+            {
+                continue;
+            }
+
+            face.IsAlive = false;
+            visibleEdges.Add({face.Vertices[0], face.Vertices[1]});
+            visibleEdges.Add({face.Vertices[1], face.Vertices[2]});
+            visibleEdges.Add({face.Vertices[2], face.Vertices[0]});
+        }
+
+        // Edges shared by two visible faces appear in both directions, horizon edges only once
+        for (const Edge& edge : visibleEdges)
+        {
+            const bool isShared = visibleEdges.ContainsIf([&edge](const Edge& other)
+            {
+                return other.From == edge.To && other.To == edge.From;
+            });
+
+            if (!isShared)
+            {
+                outFaces.Add(MakeFace(points, edge.From, edge.To, i, interiorPoint));
+            }
+        }
+    }
+
+    return true;
+}
+
+ConvexHull::Face ConvexHull::MakeFace(const DArray<Vector3>& points, uint32 a, uint32 b, uint32 c, const Vector3& interiorPoint)
+{
+    Face face;
+    face.Vertices[0] = a;
+    face.Vertices[1] = b;
+    face.Vertices[2] = c;
+
+    face.Normal = (points[b] - points[a]).Cross(points[c] - points[a]);
+    face.Normal.Normalize();
+    face.Offset = face.Normal.Dot(points[a]);
+
+    // Normals point away from the hull
+    if (face.Normal.Dot(interiorPoint) - face.Offset > 0.0f)
+    {
+        std::swap(face.Vertices[1], face.Vertices[2]);
+        face.Normal = -face.Normal;
+        face.Offset = -face.Offset;
+    }
+
+    return face;
+}
+
+MemoryWriter& operator<<(MemoryWriter& writer, const ConvexHull& hull)
+{
+    writer << hull._x;
+    writer << hull._y;
+    writer << hull._z;
+    writer << hull._adjacencyOffsets;
+    writer << hull._adjacency;
+
+    return writer;
+}
+
+MemoryReader& operator>>(MemoryReader& reader, ConvexHull& hull)
+{
+    reader >> hull._x;
+    reader >> hull._y;
+    reader >> hull._z;
+    reader >> hull._adjacencyOffsets;
+    reader >> hull._adjacency;
+
+    return reader;
+}
@@ -0,0 +1,82 @@
+﻿#pragma once
+
+#include "Core.h"
+#include "Math/MathFwd.h"
+#include "Containers/DArray.h"
+
+class MemoryReader;
+class MemoryWriter;
+
+/**
+ * Reduced convex hull of a point cloud, cooked once and used for support mapping.
+ * Vertices are the extreme points of the cloud in a fixed set of directions, stored as separate coordinate arrays,
+ * with hull edges stored as adjacency lists so support queries can hill climb from a previous result instead of
+ * scanning every vertex.
+ */
+class ConvexHull
+{
+public:
+    static constexpr uint32 DefaultDirectionCount = 256;
+
+public:
+    ConvexHull() = default;
+
+    /**
+     * Builds hull of points, vertex count is limited by directionCount. Flat or degenerate point clouds keep
+     * extreme points without adjacency, their support queries scan all vertices.
+     */
+    static ConvexHull Build(const DArray<Vector3>& points, uint32 directionCount = DefaultDirectionCount);
+
+    /**
+     * Returns the hull vertex furthest in direction. Search starts at inOutVertex, which receives the found vertex,
+     * so queries with slowly changing directions only visit a few vertices.
+     */
+    Vector3 Support(const Vector3& direction, uint32& inOutVertex) const;
+
+    Vector3 GetVertex(uint32 index) const;
+    uint32 GetVertexCount() const;
+
+    bool IsEmpty() const;
+    bool HasAdjacency() const;
+
+    friend MemoryWriter& operator<<(MemoryWriter& writer, const ConvexHull& hull);
+    friend MemoryReader& operator>>(MemoryReader& reader, ConvexHull& hull);
+
+private:
+    struct Face
+    {
+    public:
+        uint32 Vertices[3];
+        Vector3 Normal;
+        float Offset;
+        bool IsAlive = true;
+    };
+
+    struct Edge
+    {
+    public:
+        uint32 From;
+        uint32 To;
+
+    public:
+        auto operator<=>(const Edge& other) const = default;
+    };
+
+private:
+    DArray<float> _x;
+    DArray<float> _y;
+    DArray<float> _z;
+
+    // Neighbors of vertex i are _adjacency[_adjacencyOffsets[i]] .. _adjacency[_adjacencyOffsets[i + 1] - 1]
+    DArray<uint32> _adjacencyOffsets;
+    DArray<uint32> _adjacency;
+
+private:
+    float Distance(uint32 index, const Vector3& direction) const;
+
+    static bool BuildFaces(const DArray<Vector3>& points, float epsilon, DArray<Face>& outFaces);
+    static Face MakeFace(const DArray<Vector3>& points, uint32 a, uint32 b, uint32 c, const Vector3& interiorPoint);
+};
+
+MemoryWriter& operator<<(MemoryWriter& writer, const ConvexHull& hull);
+MemoryReader& operator>>(MemoryReader& reader, ConvexHull& hull);
@@ -0,0 +1,60 @@
+﻿#pragma once
+
+#include "BoundingBox.h"
+#include "IDGenerator.h"
+#include "Containers/DArray.h"
+#include "ECS/Components/CRigidBody.h"
+#include "Physics/ContactManifold.h"
+
+/**
+ * State of a physics system between ticks, one array per field so saving and restoring are linear copies.
+ * A snapshot can only be restored to the system it was saved from, bodies are matched by body index and entity ID.
+ */
+struct PhysicsSnapshot
+{
+public:
+    // Per body, in order of body indices
+    DArray<uint32> BodyIndices;
+    DArray<uint64> EntityIDs;
+    DArray<Vector3> Locations;
+    DArray<Quaternion> Rotations;
+    DArray<Vector3> Velocities;
+    DArray<Vector3> AngularVelocities;
+    DArray<BoundingBox> AABBs;
+    DArray<ERigidBodyState> States;
+    DArray<uint32> StepsAtRest;
+    DArray<uint32> SleepingIslandIDs;
+
+    // Contacts with their accumulated impulses, so the solver continues from the same warm start
+    DArray<uint64> ManifoldKeys;
+    DArray<ContactManifold> Manifolds;
+
+    IDGenerator<uint32> SleepingIslandIDGenerator;
+    uint64 StepCount = 0;
+    double FixedStepRemainder = 0.0;
+
+public:
+    /**
+     * Empties all arrays but keeps their memory, so saving into the same snapshot again doesn't allocate.
+     */
+    void Clear()
+    {
+        BodyIndices.Clear();
+        EntityIDs.Clear();
+        Locations.Clear();
+        Rotations.Clear();
+        Velocities.Clear();
+        AngularVelocities.Clear();
+        AABBs.Clear();
+        States.Clear();
+        StepsAtRest.Clear();
+        SleepingIslandIDs.Clear();
+        ManifoldKeys.Clear();
+        Manifolds.Clear();
+    }
+
+    uint32 GetBodyCount() const
+    {
+        return static_cast<uint32>(BodyIndices.Count());
+    }
+};
@@ -0,0 +1,86 @@
+﻿#include "PhysicsStats.h"
+#include <format>
+#include <fstream>
+
+double PhysicsStepStats::GetTotalMilliseconds() const
+{
+    double total = 0.0;
+    for (const double milliseconds : StageMilliseconds)
+    {
+        total += milliseconds;
+    }
+
+    return total;
+}
+
+const char* PhysicsStepStats::GetStageName(EPhysicsStage stage)
+{
+    switch (stage)
+    {
+        case EPhysicsStage::Integrate:
+            return "Integrate";
+        case EPhysicsStage::ContinuousCollision:
+            return "ContinuousCollision";
+        case EPhysicsStage::BroadPhase:
+            return "BroadPhase";
+        case EPhysicsStage::NarrowPhase:
+            return "NarrowPhase";
+        case EPhysicsStage::Manifolds:
+            return "Manifolds";
+        case EPhysicsStage::Islands:
+            return "Islands";
+        case EPhysicsStage::Solve:
+            return "Solve";
+        case EPhysicsStage::WriteBack:
+            return "WriteBack";
+        default:
+            return "Unknown";
+    }
+}
+
+bool PhysicsStepStats::WriteCSV(const std::filesystem::path& path, std::span<const PhysicsStepStats> steps)
+{
+    std::ofstream file(path);
+    if (!file.is_open())
+    {
+        LOG(L"Failed to open file {} for writing!", path.wstring());
+        return false;
+    }
+
+    file << "Step,TotalMs";
+    for (uint32 i = 0; i < StageCount; ++i)
+    {
+        file << "," << GetStageName(static_cast<EPhysicsStage>(i)) << "Ms";
+    }
+
+    file << ",AwakeBodies,SweptBodies,TimeOfImpacts,BroadPhasePairs,BoxPairs,Contacts,Manifolds,Islands,GJKIterations,EPAExpansions";
+    for (uint32 i = 0; i < OccupancyBucketCount; ++i)
+    {
+        file << (i + 1 < OccupancyBucketCount ? std::format(",CellsUpTo{}", 1u << i) : std::format(",CellsOver{}", 1u << (i - 1)));
+    }
+
+    file << ",MostPairsEntity,MostPairs,DeepestContactEntity,DeepestPenetration\n";
+
+    for (const PhysicsStepStats& stats : steps)
+    {
+        file << std::format("{},{:.4f}", stats.Step, stats.GetTotalMilliseconds());
+        for (const double milliseconds : stats.StageMilliseconds)
+        {
+            file << std::format(",{:.4f}", milliseconds);
+        }
+
+        file << std::format(",{},{},{},{},{},{},{},{},{},{}", stats.AwakeBodyCount, stats.SweptBodyCount, stats.TimeOfImpactCount,
+                            stats.BroadPhasePairCount, stats.BoxPairCount, stats.ContactCount, stats.ManifoldCount, stats.IslandCount,
+                            stats.GJKIterationCount, stats.EPAExpansionCount);
+
+        for (const uint32 cellCount : stats.CellOccupancy)
+        {
+            file << "," << cellCount;
+        }
+
+        file << std::format(",{},{},{},{:.5f}\n", stats.MostPairsEntityID, stats.MostPairsCount, stats.DeepestContactEntityID,
+                            stats.DeepestPenetration);
+    }
+
+    return file.good();
+}
@@ -0,0 +1,66 @@
+﻿#pragma once
+
+#include "Core.h"
+#include <filesystem>
+#include <span>
+
+enum class EPhysicsStage : uint8
+{
+    Integrate,
+    ContinuousCollision,
+    BroadPhase,
+    NarrowPhase,
+    Manifolds,
+    Islands,
+    Solve,
+    WriteBack,
+    Count
+};
+
+/**
+ * Counters and timings of one physics step, only collected while stats are enabled on the physics system.
+ */
+struct PhysicsStepStats
+{
+public:
+    static constexpr uint32 StageCount = static_cast<uint32>(EPhysicsStage::Count);
+    static constexpr uint32 OccupancyBucketCount = 8;
+
+public:
+    uint64 Step = 0;
+    double StageMilliseconds[StageCount] = {};
+
+    uint32 AwakeBodyCount = 0;
+    // Bodies swept for tunneling, and how many of them were moved back to their time of impact
+    uint32 SweptBodyCount = 0;
+    uint32 TimeOfImpactCount = 0;
+
+    uint32 BroadPhasePairCount = 0;
+    uint32 BoxPairCount = 0;
+    uint32 ContactCount = 0;
+    uint32 ManifoldCount = 0;
+    uint32 IslandCount = 0;
+
+    // Summed over all GJK/EPA calls of the step, including queries made from other systems
+    uint64 GJKIterationCount = 0;
+    uint64 EPAExpansionCount = 0;
+
+    // Occupied broad phase cells by item count, bucket i counts cells with up to 2^i items, empty for the tree
+    uint32 CellOccupancy[OccupancyBucketCount] = {};
+
+    // Worst bodies of the step, entity ID 0 if there was none
+    uint64 MostPairsEntityID = 0;
+    uint32 MostPairsCount = 0;
+    uint64 DeepestContactEntityID = 0;
+    float DeepestPenetration = 0.0f;
+
+public:
+    double GetTotalMilliseconds() const;
+
+    static const char* GetStageName(EPhysicsStage stage);
+
+    /**
+     * Writes one row per step with a header row, returns false if the file can't be written.
+     */
+    static bool WriteCSV(const std::filesystem::path& path, std::span<const PhysicsStepStats> steps);
+};
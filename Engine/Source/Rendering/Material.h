@@ -1,6 +1,7 @@
 ﻿#pragma once
 
 #include "Asset.h"
+#include "IDGenerator.h"
 #include "MulticastDelegate.h"
 #include "MaterialParameterMap.h"
 #include "MaterialRenderingData.h"
@@ -32,6 +32,7 @@ StaticMesh::StaticMesh(const StaticMesh& other) : Asset(other)
 {
     _lods = other._lods;
     _material = other._material;
+    _collisionHull = other._collisionHull;
 }
 
 StaticMesh& StaticMesh::operator=(const StaticMesh& other)
@@ -43,6 +44,7 @@ StaticMesh& StaticMesh::operator=(const StaticMesh& other)
 
     _lods = other._lods;
     _material = other._material;
+    _collisionHull = other._collisionHull;
 
     return *this;
 }
@@ -105,6 +107,7 @@ bool StaticMesh::Serialize(MemoryWriter& writer) const
     }
 
     writer << _boundingBox;
+    writer << _collisionHull;
 
     return true;
 }
@@ -124,6 +127,16 @@ bool StaticMesh::Deserialize(MemoryReader& reader)
 
     reader >> _boundingBox;
 
+    // Assets saved before collision hulls were cooked on import end here
+    if (reader.GetNumRemainingBytes() > 0)
+    {
+        reader >> _collisionHull;
+    }
+    else
+    {
+        CookCollisionHull();
+    }
+
     return true;
 }
 
@@ -163,6 +176,11 @@ const BoundingBox& StaticMesh::GetBoundingBox() const
     return _boundingBox;
 }
 
+const ConvexHull& StaticMesh::GetCollisionHull() const
+{
+    return _collisionHull;
+}
+
 DArray<SharedObjectPtr<Asset>> StaticMesh::Import(const SharedObjectPtr<Importer>& importer) const
 {
     const SharedObjectPtr<StaticMeshImporter> smImporter = std::dynamic_pointer_cast<StaticMeshImporter>(importer);
@@ -395,6 +413,11 @@ bool StaticMesh::ImportLOD(const aiMesh* assimpMesh, uint8 lodIndex)
 
     UpdateBoundingBox();
 
+    if (lodIndex == 0)
+    {
+        CookCollisionHull();
+    }
+
     SetIsLoaded(true);
 
     if (!Initialize())
@@ -444,6 +467,26 @@ void StaticMesh::UpdateBoundingBox()
     _boundingBox = BoundingBox(aabbMin, aabbMax);
 }
 
+void StaticMesh::CookCollisionHull()
+{
+    if (_lods.IsEmpty())
+    {
+        _collisionHull = ConvexHull();
+        return;
+    }
+
+    const DArray<Vertex>& vertices = _lods[0].Vertices;
+
+    DArray<Vector3> positions;
+    positions.Reserve(vertices.Count());
+    for (const Vertex& vertex : vertices)
+    {
+        positions.Add(vertex.Position);
+    }
+
+    _collisionHull = ConvexHull::Build(positions);
+}
+
 MemoryWriter& operator<<(MemoryWriter& writer, const StaticMesh::LOD& lod)
 {
     writer << lod.Vertices;
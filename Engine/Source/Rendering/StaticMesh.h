@@ -3,10 +3,12 @@
 #include "Asset.h"
 #include "AssetPtr.h"
 #include "BoundingBox.h"
+#include "IDGenerator.h"
 #include "Importer.h"
 #include "Material.h"
 #include "StaticMeshRenderingData.h"
 #include "Containers/DynamicGPUBuffer2.h"
+#include "Physics/ConvexHull.h"
 #include "StaticMesh.reflection.h"
 
 struct aiMesh;
@@ -101,6 +103,8 @@ public:
 
     const BoundingBox& GetBoundingBox() const;
 
+    const ConvexHull& GetCollisionHull() const;
+
     // Asset
 public:
     virtual DArray<SharedObjectPtr<Asset>> Import(const SharedObjectPtr<Importer>& importer) const override;
@@ -124,9 +128,13 @@ private:
     
     BoundingBox _boundingBox;
 
+    // Cooked from LOD 0 on import, used for collision support queries
+    ConvexHull _collisionHull;
+
 private:
     bool ImportLOD(const aiMesh* assimpMesh, uint8 lodIndex);
     void UpdateBoundingBox();
+    void CookCollisionHull();
 };
 
 MemoryWriter& operator<<(MemoryWriter& writer, const StaticMesh::LOD& lod);
@@ -50,6 +50,74 @@ void ThreadPool::WaitForAll()
     });
 }
 
+void ThreadPool::ParallelFor(uint32_t count, uint32_t batchSize, const std::function<void(uint32_t begin, uint32_t end)>& func)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    batchSize = std::max(batchSize, 1u);
+    const uint32_t batchCount = (count + batchSize - 1) / batchSize;
+
+    if (batchCount == 1 || _workerThreads.empty())
+    {
+        func(0, count);
+        return;
+    }
+
+    struct ParallelForState
+    {
+        std::atomic<uint32_t> NextBatch = 0;
+        std::atomic<uint32_t> CompletedBatches = 0;
+    };
+
+    // Helper tasks may start after all batches are done and this function has returned, so they must not touch
+    // anything on this stack frame unless they managed to claim a batch
+    const std::shared_ptr<ParallelForState> state = std::make_shared<ParallelForState>();
+    const std::function<void(uint32_t, uint32_t)>* funcPtr = &func;
+
+    auto processBatches = [state, funcPtr, count, batchSize, batchCount]()
+    {
+        while (true)
+        {
+            const uint32_t batch = state->NextBatch.fetch_add(1, std::memory_order_relaxed);
+            if (batch >= batchCount)
+            {
+                return;
+            }
+
+            const uint32_t begin = batch * batchSize;
+            (*funcPtr)(begin, std::min(begin + batchSize, count));
+
+            if (state->CompletedBatches.fetch_add(1, std::memory_order_acq_rel) + 1 == batchCount)
+            {
+                state->CompletedBatches.notify_all();
+            }
+        }
+    };
+
+    const uint32_t helperCount = std::min(batchCount - 1, static_cast<uint32_t>(_workerThreads.size()));
+    for (uint32_t i = 0; i < helperCount; ++i)
+    {
+        EnqueueTask(processBatches);
+    }
+
+    processBatches();
+
+    uint32_t completed = state->CompletedBatches.load(std::memory_order_acquire);
+    while (completed != batchCount)
+    {
+        state->CompletedBatches.wait(completed, std::memory_order_acquire);
+        completed = state->CompletedBatches.load(std::memory_order_acquire);
+    }
+}
+
+unsigned int ThreadPool::GetThreadCount() const
+{
+    return static_cast<unsigned int>(_workerThreads.size());
+}
+
 void ThreadPool::ThreadMain()
 {
     while (true)
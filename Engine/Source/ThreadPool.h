@@ -1,7 +1,9 @@
 #pragma once
 
-#include <functional>
+#include <atomic>
 #include <condition_variable>
+#include <cstdint>
+#include <functional>
 #include <queue>
 
 class ThreadPool {
@@ -19,6 +21,15 @@ public:
     void EnqueueTask(std::function<void()> &&task);
     void WaitForAll();
 
+    /**
+     * Splits [0, count) into batches of batchSize and calls func(begin, end) for each batch on worker threads.
+     * Calling thread also processes batches, so this is safe to call from a task running on this pool.
+     * Returns once all batches have been processed.
+     */
+    void ParallelFor(uint32_t count, uint32_t batchSize, const std::function<void(uint32_t begin, uint32_t end)>& func);
+
+    unsigned int GetThreadCount() const;
+
 private:
     std::vector<std::thread> _workerThreads;
     std::queue<std::function<void()>> _taskQueue;